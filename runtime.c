@@ -1,3 +1,3 @@
-int my_func(int a, int b) {
-    return a + b;
+int my_func(int a, double b) {
+    return a + (int)b;
 }
\ No newline at end of file
@@ -1,17 +1,108 @@
 #include "AST.h"
 
-// In C++, it's good practice to provide an out-of-line definition
-// for the virtual destructor of a base class, even if it's empty.
-// This ensures the vtable (virtual function table) is generated correctly
-// in one single place. The `ASTVisitor` also has a virtual destructor.
+AST::AST(std::pmr::memory_resource* memory)
+    : m_kinds(memory), m_ops(memory), m_types(memory), m_lhs(memory), m_rhs(memory),
+      m_positions(memory), m_names(memory), m_lists(memory), m_statements(memory) {}
 
-ASTVisitor::~ASTVisitor() = default;
+void AST::reserve(size_t node_count) {
+    m_kinds.reserve(node_count);
+    m_ops.reserve(node_count);
+    m_types.reserve(node_count);
+    m_lhs.reserve(node_count);
+    m_rhs.reserve(node_count);
+    m_positions.reserve(node_count);
+}
 
+NodeIndex AST::add_node(NodeKind kind, DataType type, NodeIndex lhs, NodeIndex rhs, uint32_t position) {
+    NodeIndex index = (NodeIndex)m_kinds.size();
+    m_kinds.push_back(kind);
+    m_ops.push_back(TokenType::UNKNOWN);
+    m_types.push_back(type);
+    m_lhs.push_back(lhs);
+    m_rhs.push_back(rhs);
+    m_positions.push_back(position);
+    return index;
+}
 
-// Currently, our AST node classes are simple enough that all their
-// logic (constructors, accept methods) is defined directly in the
-// AST.h header file.
+NodeIndex AST::add_bits(NodeKind kind, DataType type, uint64_t bits, uint32_t position) {
+    return add_node(kind, type, (NodeIndex)(bits >> 32), (NodeIndex)bits, position);
+}
 
-// If any of these methods, like a constructor or an accept method,
-// became more complex in the future, their full implementation would go here.
-// For now, this file correctly provides the necessary definitions.
\ No newline at end of file
+// For literals, we know the type at parse time.
+NodeIndex AST::add_integer(long long value, uint32_t position) {
+    return add_bits(NodeKind::INTEGER_LITERAL, DataType::INT, (uint64_t)value, position);
+}
+
+NodeIndex AST::add_float(double value, uint32_t position) {
+    uint64_t raw;
+    std::memcpy(&raw, &value, sizeof(raw));
+    return add_bits(NodeKind::FLOAT_LITERAL, DataType::FLOAT, raw, position);
+}
+
+// Note: The type of an identifier is unknown until semantic analysis.
+NodeIndex AST::add_identifier(std::string_view name, uint32_t position) {
+    NodeIndex name_index = (NodeIndex)m_names.size();
+    m_names.push_back(name);
+    return add_node(NodeKind::IDENTIFIER, DataType::UNKNOWN, name_index, NO_NODE, position);
+}
+
+NodeIndex AST::add_unary(TokenType op, NodeIndex operand, uint32_t position) {
+    NodeIndex index = add_node(NodeKind::UNARY_OP, DataType::UNKNOWN, operand, 0, position);
+    m_ops[index] = op;
+    return index;
+}
+
+NodeIndex AST::add_binary(TokenType op, NodeIndex left, NodeIndex right, uint32_t position) {
+    NodeIndex index = add_node(NodeKind::BINARY_OP, DataType::UNKNOWN, left, right, position);
+    m_ops[index] = op;
+    return index;
+}
+
+// The target type of a cast is stored in the type slot up front, since that
+// is also the type of the whole cast expression.
+NodeIndex AST::add_cast(DataType target, NodeIndex expression, uint32_t position) {
+    return add_node(NodeKind::CAST, target, expression, NO_NODE, position);
+}
+
+NodeIndex AST::add_call(NodeIndex callee, const NodeIndex* arguments, uint32_t count, uint32_t position) {
+    NodeIndex list = (NodeIndex)m_lists.size();
+    m_lists.push_back(count);
+    m_lists.insert(m_lists.end(), arguments, arguments + count);
+    return add_node(NodeKind::FUNCTION_CALL, DataType::UNKNOWN, callee, list, position);
+}
+
+NodeIndex AST::add_let(std::string_view name, NodeIndex initializer, uint32_t position) {
+    NodeIndex name_index = (NodeIndex)m_names.size();
+    m_names.push_back(name);
+    return add_node(NodeKind::LET_STATEMENT, DataType::VOID, name_index, initializer, position);
+}
+
+NodeIndex AST::add_expression_statement(NodeIndex expression, uint32_t position) {
+    return add_node(NodeKind::EXPRESSION_STATEMENT, DataType::VOID, expression, NO_NODE, position);
+}
+
+NodeIndex AST::add_return(NodeIndex value, NodeIndex function, uint32_t position) {
+    return add_node(NodeKind::RETURN_STATEMENT, DataType::VOID, value, function, position);
+}
+
+NodeIndex AST::add_parameter(std::string_view name, DataType type, uint32_t position) {
+    NodeIndex name_index = (NodeIndex)m_names.size();
+    m_names.push_back(name);
+    return add_node(NodeKind::PARAMETER, type, name_index, NO_NODE, position);
+}
+
+// The return type is stored in the type slot, like a cast's target type.
+NodeIndex AST::add_function(std::string_view name, DataType return_type, uint32_t position) {
+    NodeIndex name_index = (NodeIndex)m_names.size();
+    m_names.push_back(name);
+    return add_node(NodeKind::FUNCTION, return_type, name_index, NO_NODE, position);
+}
+
+void AST::set_function_body(NodeIndex function, const NodeIndex* parameters, uint32_t parameter_count,
+                            const NodeIndex* statements, uint32_t statement_count) {
+    m_rhs[function] = (NodeIndex)m_lists.size();
+    m_lists.push_back(parameter_count);
+    m_lists.insert(m_lists.end(), parameters, parameters + parameter_count);
+    m_lists.push_back(statement_count);
+    m_lists.insert(m_lists.end(), statements, statements + statement_count);
+}
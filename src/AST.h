@@ -1,150 +1,177 @@
-// In src/AST.h
-
 #pragma once
 
 #include "Token.h"
-#include <memory>
+#include <cstdint>
+#include <cstring>
+#include <memory_resource>
+#include <string_view>
 #include <vector>
-#include <string>
 
-enum class DataType {
+enum class DataType : uint8_t {
     UNKNOWN, // Type hasn't been determined yet
     VOID,    // Represents the absence of a type, e.g., for a statement
     INT,
     FLOAT
 };
 
-// Forward declare all node types and the visitor
-struct BinaryOpNode;
-struct IntegerLiteralNode; 
-struct FloatLiteralNode; 
-struct IdentifierNode;
-struct FunctionCallNode;
-struct LetStatementNode;
-struct ExpressionStatementNode;
-struct CastNode;
-// The Visitor interface, updated for our new literal types.
-class ASTVisitor {
-public:
-    virtual ~ASTVisitor();
-    virtual void visit(const BinaryOpNode& node) = 0;
-    virtual void visit(const IntegerLiteralNode& node) = 0; 
-    virtual void visit(const FloatLiteralNode& node) = 0;  
-    virtual void visit(const IdentifierNode& node) = 0;
-    virtual void visit(const FunctionCallNode& node) = 0;
-    virtual void visit(const LetStatementNode& node) = 0;
-    virtual void visit(const ExpressionStatementNode& node) = 0;
-    virtual void visit(const CastNode& node) = 0;
+// Every node in the tree has one of these kinds. Passes dispatch on it with a
+// plain `switch` instead of a virtual visitor.
+enum class NodeKind : uint8_t {
+    // Expressions
+    INTEGER_LITERAL,
+    FLOAT_LITERAL,
+    IDENTIFIER,
+    UNARY_OP,
+    BINARY_OP,
+    CAST,
+    FUNCTION_CALL,
+
+    // Statements
+    LET_STATEMENT,
+    EXPRESSION_STATEMENT,
+    RETURN_STATEMENT,
+
+    // Function definitions
+    PARAMETER,
+    FUNCTION
 };
 
+// Nodes are referred to by their position in the AST's arrays.
+using NodeIndex = uint32_t;
+constexpr NodeIndex NO_NODE = UINT32_MAX;
 
-// --- Base Node Definitions ---
-
-class ASTNode {
-public:
-    virtual ~ASTNode() = default;
-    virtual void accept(ASTVisitor& visitor) const = 0;
-};
+// A contiguous run of node indices (the arguments of a call, or the
+// parameters or statements of a function).
+struct NodeRange {
+    const NodeIndex* first = nullptr;
+    uint32_t count = 0;
 
-class ExpressionNode : public ASTNode {
-public:
-    // CRUCIAL: Every expression node now has a field to store its type.
-    // This will be filled in during a later semantic analysis phase.
-    DataType type = DataType::UNKNOWN;
+    const NodeIndex* begin() const { return first; }
+    const NodeIndex* end() const { return first + count; }
+    uint32_t size() const { return count; }
+    NodeIndex operator[](uint32_t i) const { return first[i]; }
 };
 
-class StatementNode : public ASTNode {};
-
-
-// --- Concrete Expression Nodes ---
-
-// REPLACES NumberLiteralNode
-class IntegerLiteralNode : public ExpressionNode {
+// A data-oriented Abstract Syntax Tree.
+//
+// Instead of a tree of heap-allocated polymorphic objects, every node is a row
+// in a set of parallel arrays (struct-of-arrays): its kind, its computed type,
+// two 32-bit operand slots and its source position (a byte offset that
+// SourceBuffer::locate() turns into a line and column). What the operand
+// slots hold depends on the kind:
+//
+//   INTEGER_LITERAL       lhs:rhs  the 64-bit value
+//   FLOAT_LITERAL         lhs:rhs  the bits of the double
+//   IDENTIFIER            lhs      index into the name table
+//   UNARY_OP              lhs      the operand; `op` is the operator token
+//   BINARY_OP             lhs, rhs operand nodes; `op` is the operator token
+//   CAST                  lhs      the expression; the target type is in `type`
+//   FUNCTION_CALL         lhs      the callee; rhs indexes the argument list
+//   LET_STATEMENT         lhs      index into the name table; rhs the initializer
+//   EXPRESSION_STATEMENT  lhs      the expression
+//   RETURN_STATEMENT      lhs      the value; rhs the FUNCTION it returns from
+//   PARAMETER             lhs      index into the name table; the declared type is in `type`
+//   FUNCTION              lhs      index into the name table; rhs indexes its parameter and
+//                                  statement lists; the return type is in `type`
+//
+// The parser always creates children before their parent, so a node's operands
+// have smaller indices than the node itself. Each subtree is also one
+// contiguous run of nodes ending at its root, with the left operand (or a
+// call's callee) built first. Walking the arrays from 0 upwards
+// is therefore a post-order traversal of every statement, in source order —
+// which is exactly what the type checker and the IR generator need, without
+// any recursion.
+//
+// Functions are the one exception: a FUNCTION node follows its PARAMETERs
+// but comes before the statements of its body, the last of which is always
+// its RETURN_STATEMENT. So the same walk reaches the FUNCTION (and can open
+// its scope) before any statement inside it, and leaves the function at the
+// return. Only the FUNCTION is a top-level statement; its body statements
+// are listed by body().
+//
+// All arrays live in the compilation-session arena.
+class AST {
 public:
-    long long value;
-    explicit IntegerLiteralNode(long long value) : value(value) {
-        // For literals, we know the type at parse time.
-        type = DataType::INT;
+    explicit AST(std::pmr::memory_resource* memory = std::pmr::get_default_resource());
+
+    // Reserves room for about `node_count` nodes to avoid regrowing the arrays.
+    void reserve(size_t node_count);
+
+    // --- Building (used by the Parser) ---
+    NodeIndex add_integer(long long value, uint32_t position);
+    NodeIndex add_float(double value, uint32_t position);
+    NodeIndex add_identifier(std::string_view name, uint32_t position);
+    NodeIndex add_unary(TokenType op, NodeIndex operand, uint32_t position);
+    NodeIndex add_binary(TokenType op, NodeIndex left, NodeIndex right, uint32_t position);
+    NodeIndex add_cast(DataType target, NodeIndex expression, uint32_t position);
+    NodeIndex add_call(NodeIndex callee, const NodeIndex* arguments, uint32_t count, uint32_t position);
+    NodeIndex add_let(std::string_view name, NodeIndex initializer, uint32_t position);
+    NodeIndex add_expression_statement(NodeIndex expression, uint32_t position);
+    NodeIndex add_return(NodeIndex value, NodeIndex function, uint32_t position);
+    NodeIndex add_parameter(std::string_view name, DataType type, uint32_t position);
+    // The function's lists are filled in by set_function_body() once its
+    // body has been parsed.
+    NodeIndex add_function(std::string_view name, DataType return_type, uint32_t position);
+    void set_function_body(NodeIndex function, const NodeIndex* parameters, uint32_t parameter_count,
+                           const NodeIndex* statements, uint32_t statement_count);
+
+    // --- Reading ---
+    size_t size() const { return m_kinds.size(); }
+    NodeKind kind(NodeIndex n) const { return m_kinds[n]; }
+    DataType type(NodeIndex n) const { return m_types[n]; }
+    void set_type(NodeIndex n, DataType type) { m_types[n] = type; }
+    uint32_t position(NodeIndex n) const { return m_positions[n]; }
+
+    NodeIndex lhs(NodeIndex n) const { return m_lhs[n]; }
+    NodeIndex rhs(NodeIndex n) const { return m_rhs[n]; }
+    TokenType op(NodeIndex n) const { return m_ops[n]; }
+
+    long long int_value(NodeIndex n) const { return (long long)bits(n); }
+    double float_value(NodeIndex n) const {
+        uint64_t raw = bits(n);
+        double value;
+        std::memcpy(&value, &raw, sizeof(value));
+        return value;
     }
 
-    void accept(ASTVisitor& visitor) const override { visitor.visit(*this); }
-};
-
-class FloatLiteralNode : public ExpressionNode {
-public:
-    double value;
-    explicit FloatLiteralNode(double value) : value(value) {
-        type = DataType::FLOAT;
-    }
-
-    void accept(ASTVisitor& visitor) const override { visitor.visit(*this); }
-};
-
-class IdentifierNode : public ExpressionNode {
-public:
-    std::string name;
-    explicit IdentifierNode(const std::string& name) : name(name) {}
-    // Note: The type of an identifier is unknown until semantic analysis.
-    void accept(ASTVisitor& visitor) const override { visitor.visit(*this); }
-};
-
-class BinaryOpNode : public ExpressionNode {
-public:
-    TokenType op;
-    std::unique_ptr<ExpressionNode> left;
-    std::unique_ptr<ExpressionNode> right;
-
-    BinaryOpNode(TokenType op, std::unique_ptr<ExpressionNode> left, std::unique_ptr<ExpressionNode> right)
-        : op(op), left(std::move(left)), right(std::move(right)) {}
-
-    void accept(ASTVisitor& visitor) const override { visitor.visit(*this); }
-};
-
-class LetStatementNode : public StatementNode {
-public:
-    std::unique_ptr<IdentifierNode> name;
-    std::unique_ptr<ExpressionNode> initializer;
-
-    LetStatementNode(std::unique_ptr<IdentifierNode> name, std::unique_ptr<ExpressionNode> initializer)
-        : name(std::move(name)), initializer(std::move(initializer)) {}
+    // The name of an IDENTIFIER, the variable declared by a LET_STATEMENT,
+    // or the name of a PARAMETER or FUNCTION.
+    std::string_view name(NodeIndex n) const { return m_names[m_lhs[n]]; }
 
-    void accept(ASTVisitor& visitor) const override {
-        visitor.visit(*this);
+    // The argument nodes of a FUNCTION_CALL.
+    NodeRange arguments(NodeIndex n) const {
+        const NodeIndex* list = m_lists.data() + m_rhs[n];
+        return {list + 1, *list};
     }
-};
-
-class ExpressionStatementNode : public StatementNode {
-public:
-    std::unique_ptr<ExpressionNode> expression;
 
-    explicit ExpressionStatementNode(std::unique_ptr<ExpressionNode> expression)
-        : expression(std::move(expression)) {}
-
-    void accept(ASTVisitor& visitor) const override {
-        visitor.visit(*this);
+    // The PARAMETER nodes of a FUNCTION, and the statements of its body.
+    NodeRange parameters(NodeIndex n) const { return arguments(n); }
+    NodeRange body(NodeIndex n) const {
+        NodeRange parameters = arguments(n);
+        return {parameters.end() + 1, *parameters.end()};
     }
-};
-
-class CastNode : public ExpressionNode {
-public:
-    DataType targetType; // The type we are casting to
-    std::unique_ptr<ExpressionNode> expression; // The expression being cast
-
-    CastNode(DataType targetType, std::unique_ptr<ExpressionNode> expression)
-        : targetType(targetType), expression(std::move(expression)) {}
 
-    void accept(ASTVisitor& visitor) const override { visitor.visit(*this); }
+    // The top-level statements of the program, in source order.
+    const std::pmr::vector<NodeIndex>& statements() const { return m_statements; }
+    void add_statement(NodeIndex statement) { m_statements.push_back(statement); }
+
+private:
+    // One entry per node.
+    std::pmr::vector<NodeKind> m_kinds;
+    std::pmr::vector<TokenType> m_ops;
+    std::pmr::vector<DataType> m_types;
+    std::pmr::vector<NodeIndex> m_lhs;
+    std::pmr::vector<NodeIndex> m_rhs;
+    std::pmr::vector<uint32_t> m_positions; // Source offset of the node's token
+
+    // Side tables referenced from the operand slots.
+    std::pmr::vector<std::string_view> m_names;
+    std::pmr::vector<NodeIndex> m_lists; // Argument lists: a count followed by the nodes (for a
+                                         // function, its parameters, then its statements)
+
+    std::pmr::vector<NodeIndex> m_statements;
+
+    NodeIndex add_node(NodeKind kind, DataType type, NodeIndex lhs, NodeIndex rhs, uint32_t position);
+    NodeIndex add_bits(NodeKind kind, DataType type, uint64_t bits, uint32_t position);
+    uint64_t bits(NodeIndex n) const { return ((uint64_t)m_lhs[n] << 32) | m_rhs[n]; }
 };
-// In src/AST.h
-
-class FunctionCallNode : public ExpressionNode {
-public:
-    std::unique_ptr<ExpressionNode> callee;
-    std::vector<std::unique_ptr<ExpressionNode>> arguments;
-    FunctionCallNode(std::unique_ptr<ExpressionNode> callee, std::vector<std::unique_ptr<ExpressionNode>> arguments)
-        : callee(std::move(callee)), arguments(std::move(arguments)) {}
-
-    void accept(ASTVisitor& visitor) const override {
-        visitor.visit(*this);
-    }
-};
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 #include "AST.h"
 #include <iostream>
+#include <vector>
 inline std::ostream& operator<<(std::ostream& os, const DataType& type) {
     switch (type) {
         case DataType::INT:   os << "INT";   break;
@@ -11,63 +12,112 @@ inline std::ostream& operator<<(std::ostream& os, const DataType& type) {
     return os;
 }
 
-class ASTPrinter : public ASTVisitor {
+class ASTPrinter {
 private:
-    int indent_level = 0;
-    void indent() { for (int i = 0; i < indent_level; ++i) std::cout << "  "; }
+    std::ostream& m_out;
+
+    void indent(int depth) { for (int i = 0; i < depth; ++i) m_out << "  "; }
 
 public:
-    void print(const std::vector<std::unique_ptr<StatementNode>>& statements) {
-        std::cout << "--- Abstract Syntax Tree ---\n";
-        for (const auto& stmt : statements) {
-            stmt->accept(*this);
-        }
-        std::cout << "--------------------------\n";
-    }
+    explicit ASTPrinter(std::ostream& out = std::cout) : m_out(out) {}
 
-    void visit(const LetStatementNode& node) override {
-        indent();
-        std::cout << "LetStatement:\n";
-        indent_level++;
-        indent();
-        std::cout << "Name: " << node.name->name << "\n";
-        indent();
-        std::cout << "Initializer:\n";
-        indent_level++;
-        node.initializer->accept(*this);
-        indent_level -= 2;
+    void print(const AST& ast) {
+        printHeader();
+        printStatements(ast);
+        printFooter();
     }
 
-    void visit(const ExpressionStatementNode& node) override {
-        indent();
-        std::cout << "ExpressionStatement:\n";
-        indent_level++;
-        node.expression->accept(*this);
-        indent_level--;
+    // print() in parts, for a program that arrives as several ASTs: the
+    // header, then the statements of each AST in turn, then the footer.
+    void printHeader() { m_out << "--- Abstract Syntax Tree ---\n"; }
+    void printFooter() { m_out << "--------------------------\n"; }
+    void printStatements(const AST& ast) {
+        for (NodeIndex stmt : ast.statements()) {
+            print(ast, stmt);
+        }
     }
 
-    // In the ASTPrinter class, modify the visit methods for expressions
-    // to print the type stored in the node.
-    void visit(const BinaryOpNode& node) override {
-        indent();
-        // NEW: Print the computed type of the expression!
-        std::cout << "BinaryOp(" << node.op << ") [type: " << node.type << "]\n"; 
-        // ...
-    }
-// (Do the same for Integer, Float, and Identifier nodes)
-    void visit(const IntegerLiteralNode& node) override {
-        indent();
-        std::cout << "IntegerLiteral(" << node.value << ") [type: " << node.type << "]\n";
-    }
-    void visit(const FloatLiteralNode& node) override {
-        indent();
-        std::cout << "FloatLiteral(" << node.value << ") [type: " << node.type << "]\n";
-    }
-    void visit(const IdentifierNode& node) override {
-        indent();
-        std::cout << "Identifier(" << node.name << ") [type: " << node.type << "]\n";
+    // Prints one node and, indented below it, its children. Nodes waiting to
+    // be printed are kept on an explicit stack rather than recursing, so
+    // arbitrarily deep expressions print too.
+    void print(const AST& ast, NodeIndex root) {
+        struct Pending {
+            NodeIndex node;
+            int depth;
+        };
+        std::vector<Pending> stack{{root, 0}};
+
+        while (!stack.empty()) {
+            auto [node, depth] = stack.back();
+            stack.pop_back();
+
+            indent(depth);
+            switch (ast.kind(node)) {
+                case NodeKind::LET_STATEMENT:
+                    m_out << "LetStatement:\n";
+                    indent(depth + 1);
+                    m_out << "Name: " << ast.name(node) << "\n";
+                    indent(depth + 1);
+                    m_out << "Initializer:\n";
+                    stack.push_back({ast.rhs(node), depth + 2});
+                    break;
+                case NodeKind::EXPRESSION_STATEMENT:
+                    m_out << "ExpressionStatement:\n";
+                    stack.push_back({ast.lhs(node), depth + 1});
+                    break;
+                case NodeKind::RETURN_STATEMENT:
+                    m_out << "ReturnStatement:\n";
+                    stack.push_back({ast.lhs(node), depth + 1});
+                    break;
+                case NodeKind::PARAMETER:
+                    m_out << "Parameter(" << ast.name(node) << ") [type: " << ast.type(node) << "]\n";
+                    break;
+                case NodeKind::FUNCTION: {
+                    m_out << "Function(" << ast.name(node) << ") [returns: " << ast.type(node) << "]\n";
+                    // Parameters first, then the body, each in source order.
+                    NodeRange body = ast.body(node);
+                    for (uint32_t i = body.size(); i-- > 0;) {
+                        stack.push_back({body[i], depth + 1});
+                    }
+                    NodeRange parameters = ast.parameters(node);
+                    for (uint32_t i = parameters.size(); i-- > 0;) {
+                        stack.push_back({parameters[i], depth + 1});
+                    }
+                    break;
+                }
+                case NodeKind::UNARY_OP:
+                    m_out << "UnaryOp(" << ast.op(node) << ") [type: " << ast.type(node) << "]\n";
+                    stack.push_back({ast.lhs(node), depth + 1});
+                    break;
+                case NodeKind::BINARY_OP:
+                    m_out << "BinaryOp(" << ast.op(node) << ") [type: " << ast.type(node) << "]\n";
+                    // Pushed in reverse so the left operand is printed first.
+                    stack.push_back({ast.rhs(node), depth + 1});
+                    stack.push_back({ast.lhs(node), depth + 1});
+                    break;
+                case NodeKind::INTEGER_LITERAL:
+                    m_out << "IntegerLiteral(" << ast.int_value(node) << ") [type: " << ast.type(node) << "]\n";
+                    break;
+                case NodeKind::FLOAT_LITERAL:
+                    m_out << "FloatLiteral(" << ast.float_value(node) << ") [type: " << ast.type(node) << "]\n";
+                    break;
+                case NodeKind::IDENTIFIER:
+                    m_out << "Identifier(" << ast.name(node) << ") [type: " << ast.type(node) << "]\n";
+                    break;
+                case NodeKind::CAST:
+                    m_out << "Cast [type: " << ast.type(node) << "]\n";
+                    stack.push_back({ast.lhs(node), depth + 1});
+                    break;
+                case NodeKind::FUNCTION_CALL: {
+                    m_out << "FunctionCall [type: " << ast.type(node) << "]\n";
+                    NodeRange arguments = ast.arguments(node);
+                    for (uint32_t i = arguments.size(); i-- > 0;) {
+                        stack.push_back({arguments[i], depth + 1});
+                    }
+                    stack.push_back({ast.lhs(node), depth + 1});
+                    break;
+                }
+            }
+        }
     }
-    void visit(const FunctionCallNode& node) override {}
-    void visit(const CastNode& node) override {}
 };
-
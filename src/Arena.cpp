@@ -0,0 +1,87 @@
+#include "Arena.h"
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+Arena::Arena(size_t block_size) : m_block_size(block_size) {}
+
+Arena::~Arena() {
+    reset();
+}
+
+void Arena::reset() {
+    Block* block = m_head;
+    while (block) {
+        Block* next = block->next;
+        std::free(block);
+        block = next;
+    }
+    m_head = nullptr;
+    m_cursor = m_limit = nullptr;
+    m_bytes_used = m_bytes_reserved = m_block_count = m_allocation_count = 0;
+}
+
+std::string_view Arena::copy_string(std::string_view text) {
+    if (text.empty()) return {};
+    char* copy = static_cast<char*>(allocate(text.size(), 1));
+    std::memcpy(copy, text.data(), text.size());
+    return {copy, text.size()};
+}
+
+void* Arena::do_allocate(size_t bytes, size_t alignment) {
+    // Fast path: align the cursor and bump it inside the current block.
+    uintptr_t cursor = reinterpret_cast<uintptr_t>(m_cursor);
+    uintptr_t aligned = (cursor + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    if (m_cursor && aligned + bytes <= reinterpret_cast<uintptr_t>(m_limit)) {
+        m_cursor = reinterpret_cast<char*>(aligned + bytes);
+        m_bytes_used += bytes;
+        m_allocation_count++;
+        return reinterpret_cast<void*>(aligned);
+    }
+    return allocate_slow(bytes, alignment);
+}
+
+void* Arena::allocate_slow(size_t bytes, size_t alignment) {
+    Block* block = new_block(bytes + alignment);
+    char* start = reinterpret_cast<char*>(block + 1);
+
+    uintptr_t aligned = (reinterpret_cast<uintptr_t>(start) + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    char* end = start + block->size;
+
+    // An oversized request gets a dedicated block. Keep bumping in the old one
+    // so its remaining space isn't wasted.
+    if (block->size > m_block_size && m_head != block) {
+        m_bytes_used += bytes;
+        m_allocation_count++;
+        return reinterpret_cast<void*>(aligned);
+    }
+
+    m_cursor = reinterpret_cast<char*>(aligned + bytes);
+    m_limit = end;
+    m_bytes_used += bytes;
+    m_allocation_count++;
+    return reinterpret_cast<void*>(aligned);
+}
+
+Arena::Block* Arena::new_block(size_t min_size) {
+    size_t size = min_size > m_block_size ? min_size : m_block_size;
+    void* memory = std::malloc(sizeof(Block) + size);
+    if (!memory) throw std::bad_alloc();
+
+    Block* block = static_cast<Block*>(memory);
+    block->size = size;
+    m_bytes_reserved += sizeof(Block) + size;
+    m_block_count++;
+
+    if (size > m_block_size && m_head) {
+        // Dedicated block: link it behind the current head so the head stays
+        // the block we are bumping through.
+        block->next = m_head->next;
+        m_head->next = block;
+    } else {
+        block->next = m_head;
+        m_head = block;
+    }
+    return block;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+#include <string_view>
+#include <utility>
+
+// A compilation-session bump allocator.
+//
+// Every phase of the compiler (tokens, AST nodes, symbol tables, IR) allocates
+// out of one Arena that is owned by the driver. Allocation is just a pointer
+// bump inside the current block; individual deallocations are no-ops, and the
+// whole session is released in one shot when the Arena is destroyed.
+//
+// The Arena is also a std::pmr::memory_resource, so standard containers can
+// use it directly, e.g. `std::pmr::vector<Token> tokens(&arena);`.
+class Arena : public std::pmr::memory_resource {
+public:
+    static constexpr size_t DEFAULT_BLOCK_SIZE = 64 * 1024;
+
+    explicit Arena(size_t block_size = DEFAULT_BLOCK_SIZE);
+    ~Arena() override;
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    // Constructs a T inside the arena. Its destructor is never run, so T must
+    // only own memory that also lives in this arena (or none at all).
+    template <typename T, typename... Args>
+    T* make(Args&&... args) {
+        void* memory = allocate(sizeof(T), alignof(T));
+        return new (memory) T(std::forward<Args>(args)...);
+    }
+
+    // Copies a string into the arena and returns a view of the copy.
+    std::string_view copy_string(std::string_view text);
+
+    // Releases every block at once. All pointers into the arena become invalid.
+    void reset();
+
+    // --- Statistics ---
+    size_t bytes_used() const { return m_bytes_used; }         // Bytes handed out to callers
+    size_t bytes_reserved() const { return m_bytes_reserved; } // Bytes obtained from the system
+    size_t block_count() const { return m_block_count; }
+    size_t allocation_count() const { return m_allocation_count; }
+
+private:
+    struct Block {
+        Block* next;
+        size_t size; // Usable bytes following the header
+    };
+
+    Block* m_head = nullptr; // Most recently allocated block
+    char* m_cursor = nullptr;
+    char* m_limit = nullptr;
+    size_t m_block_size;
+
+    size_t m_bytes_used = 0;
+    size_t m_bytes_reserved = 0;
+    size_t m_block_count = 0;
+    size_t m_allocation_count = 0;
+
+    void* allocate_slow(size_t bytes, size_t alignment);
+    Block* new_block(size_t min_size);
+
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void*, size_t, size_t) override {} // Freed in one shot by reset()
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+};
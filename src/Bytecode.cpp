@@ -0,0 +1,272 @@
+#include "Bytecode.h"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+namespace {
+
+class BytecodeCompiler {
+public:
+    BytecodeCompiler(const IRModule& module, const NativeTable& natives) : m_module(module), m_natives(natives) {}
+
+    BytecodeProgram compile() {
+        for (size_t i = 1; i < m_module.functions.size(); ++i) {
+            m_function_indices.emplace(m_module.functions[i].name, (uint32_t)i);
+        }
+        m_result.code.reserve(m_module.instruction_count() + 2 * m_module.block_count());
+        for (const IRProgram& program : m_module.functions) {
+            m_program = &program;
+            compileFunction();
+        }
+        return std::move(m_result);
+    }
+
+private:
+    const IRModule& m_module;
+    const IRProgram* m_program = nullptr; // The part being compiled
+    const NativeTable& m_natives;
+    BytecodeProgram m_result;
+    std::unordered_map<std::string_view, uint32_t> m_function_indices; // The program's functions
+    std::unordered_map<std::string_view, uint32_t> m_native_indices;   // In m_result.natives
+    uint32_t m_zero = 0;                                 // The register holding 0
+    std::vector<uint32_t> m_block_start;                 // Position of each block's first instruction
+    std::vector<std::pair<uint32_t, BlockIndex>> m_jumps; // Jumps to patch, and their target blocks
+    std::vector<IRInstruction> m_params;                 // PARAMs waiting for their CALL, last argument first
+
+    // Assigns the argument slots of a call of a native function in order.
+    struct SlotAssigner {
+        uint32_t int_args = 0;
+        uint32_t float_args = 0;
+        uint32_t stack_args = 0;
+
+        // False when the slots are full.
+        bool next(DataType type, uint32_t& slot) {
+            if (type == DataType::FLOAT && float_args < BytecodeProgram::FLOAT_SLOTS) {
+                slot = BytecodeProgram::INT_SLOTS + float_args++;
+            } else if (type != DataType::FLOAT && int_args < BytecodeProgram::INT_SLOTS) {
+                slot = int_args++;
+            } else if (stack_args < BytecodeProgram::STACK_SLOTS) {
+                slot = BytecodeProgram::INT_SLOTS + BytecodeProgram::FLOAT_SLOTS + stack_args++;
+            } else {
+                return false;
+            }
+            return true;
+        }
+    };
+
+    void compileFunction() {
+        const IRProgram& program = *m_program;
+        if (program.in_ssa) {
+            throw std::runtime_error("Bytecode Error: the IR is still in SSA form.");
+        }
+
+        // --- The register file: temporaries, then constants, then a zero ---
+        uint32_t first_register = (uint32_t)m_result.registers.size();
+        uint32_t register_count = program.temp_count + (uint32_t)program.constants.size() + 1;
+        m_result.functions.push_back({(uint32_t)m_result.code.size(), first_register, register_count});
+        m_result.registers.resize(first_register + register_count);
+        for (size_t i = 0; i < program.constants.size(); ++i) {
+            const IRConstant& constant = program.constants[i];
+            BytecodeValue& value = m_result.registers[first_register + program.temp_count + i];
+            if (constant.type == DataType::FLOAT) {
+                value.f = constant.float_value;
+            } else {
+                value.i = constant.int_value;
+            }
+        }
+        m_zero = register_count - 1;
+
+        // Argument i arrives in slot i.
+        m_result.argument_slots = std::max(m_result.argument_slots, (uint32_t)program.parameters.size());
+
+        // --- The blocks, in order; jumps are patched once every block has a position ---
+        m_block_start.resize(program.blocks.size());
+        m_jumps.clear();
+        for (BlockIndex b = 0; b < program.blocks.size(); ++b) {
+            m_block_start[b] = (uint32_t)m_result.code.size();
+            const IRBlock& block = program.blocks[b];
+            for (const IRInstruction& instr : block.instructions) {
+                compileInstruction(instr);
+            }
+            compileTerminator(b, block.terminator);
+        }
+        for (auto [position, block] : m_jumps) {
+            BytecodeInstr& jump = m_result.code[position];
+            (jump.op == BytecodeOp::JUMP ? jump.a : jump.b) = m_block_start[block];
+        }
+    }
+
+    uint32_t reg(IROperand operand) const {
+        switch (operand.kind()) {
+            case IROperand::TEMP:
+                return operand.index();
+            case IROperand::CONSTANT:
+                return m_program->temp_count + operand.index();
+            case IROperand::SYMBOL:
+                // Only a call's callee may be a symbol.
+                throw std::runtime_error("Bytecode Error: '" + std::string(m_program->symbols[operand.index()]) +
+                                         "' is not a declared variable.");
+            default:
+                return m_zero;
+        }
+    }
+
+    void emit(BytecodeOp op, uint32_t dst, uint32_t a = 0, uint32_t b = 0) {
+        m_result.code.push_back({op, dst, a, b});
+    }
+
+    void emitJump(BytecodeOp op, uint32_t condition, BlockIndex target) {
+        m_jumps.push_back({(uint32_t)m_result.code.size(), target});
+        if (op == BytecodeOp::JUMP) {
+            emit(op, 0, 0);
+        } else {
+            emit(op, 0, condition, 0);
+        }
+    }
+
+    void compileInstruction(const IRInstruction& instr) {
+        if (instr.op == IROp::PARAM) {
+            m_params.push_back(instr);
+            return;
+        }
+        if (instr.op == IROp::CALL) {
+            compileCall(instr);
+            return;
+        }
+        if (instr.op == IROp::ARGUMENT) {
+            emit(BytecodeOp::ARGUMENT, reg(instr.result), instr.count);
+            return;
+        }
+        bool is_float = instr.type == DataType::FLOAT;
+        uint32_t dst = reg(instr.result);
+        uint32_t a = reg(instr.arg1);
+        uint32_t b = reg(instr.arg2);
+        switch (instr.op) {
+            case IROp::COPY:
+                emit(BytecodeOp::MOVE, dst, a);
+                break;
+            case IROp::ADD:
+                emit(is_float ? BytecodeOp::ADD_FLOAT : BytecodeOp::ADD_INT, dst, a, b);
+                break;
+            case IROp::SUB:
+                emit(is_float ? BytecodeOp::SUB_FLOAT : BytecodeOp::SUB_INT, dst, a, b);
+                break;
+            case IROp::MUL:
+                emit(is_float ? BytecodeOp::MUL_FLOAT : BytecodeOp::MUL_INT, dst, a, b);
+                break;
+            case IROp::DIV:
+                emit(is_float ? BytecodeOp::DIV_FLOAT : BytecodeOp::DIV_INT, dst, a, b);
+                break;
+            case IROp::CMP_EQ:
+            case IROp::CMP_NE:
+            case IROp::CMP_LT:
+            case IROp::CMP_LE:
+            case IROp::CMP_GT:
+            case IROp::CMP_GE: {
+                // The comparisons are in the same order in both enums.
+                uint32_t offset = (uint32_t)instr.op - (uint32_t)IROp::CMP_EQ;
+                BytecodeOp first = is_float ? BytecodeOp::EQ_FLOAT : BytecodeOp::EQ_INT;
+                emit(BytecodeOp((uint32_t)first + offset), dst, a, b);
+                break;
+            }
+            case IROp::CAST: {
+                DataType from = instr.arg1.kind() == IROperand::CONSTANT ? m_program->constants[instr.arg1.index()].type
+                                                                         : m_program->temp_types[instr.arg1.index()];
+                if (from == instr.type) {
+                    emit(BytecodeOp::MOVE, dst, a);
+                } else {
+                    emit(is_float ? BytecodeOp::INT_TO_FLOAT : BytecodeOp::FLOAT_TO_INT, dst, a);
+                }
+                break;
+            }
+            case IROp::PARAM:
+            case IROp::CALL:
+            case IROp::ARGUMENT:
+                break;
+        }
+    }
+
+    // The PARAMs are in reverse, so the first argument is the last one seen.
+    void compileCall(const IRInstruction& call) {
+        // Only a named function can be called; there are no function values.
+        if (call.arg1.kind() != IROperand::SYMBOL) {
+            throw std::runtime_error("Bytecode Error: the callee of a call is not a function.");
+        }
+        std::string_view name = m_program->symbols[call.arg1.index()];
+        auto function = m_function_indices.find(name);
+        uint32_t native = 0;
+        if (function == m_function_indices.end()) {
+            auto [it, inserted] = m_native_indices.try_emplace(name, (uint32_t)m_result.natives.size());
+            if (inserted) {
+                void* address = m_natives.find(name);
+                if (!address) {
+                    throw std::runtime_error("Bytecode Error: undefined function '" + std::string(name) + "'.");
+                }
+                m_result.natives.push_back(address);
+            }
+            native = it->second;
+        }
+
+        // A function of the program takes argument i in slot i; see
+        // compileFunction().
+        if (function != m_function_indices.end()) {
+            for (uint32_t i = 0; i < call.count; ++i) {
+                emit(BytecodeOp::ARG, i, reg(m_params[m_params.size() - 1 - i].arg1));
+            }
+            m_params.resize(m_params.size() - call.count);
+            emit(BytecodeOp::CALL_FUNCTION, reg(call.result), function->second);
+            return;
+        }
+
+        SlotAssigner slots;
+        for (size_t i = 0; i < call.count; ++i) {
+            const IRInstruction& param = m_params[m_params.size() - 1 - i];
+            uint32_t slot;
+            if (!slots.next(param.type, slot)) {
+                throw std::runtime_error("Bytecode Error: too many arguments in a call to '" + std::string(name) + "'.");
+            }
+            emit(BytecodeOp::ARG, slot, reg(param.arg1));
+        }
+        m_params.resize(m_params.size() - call.count);
+        BytecodeOp op = call.type == DataType::FLOAT ? BytecodeOp::CALL_FLOAT : BytecodeOp::CALL_INT;
+        emit(op, reg(call.result), native, slots.stack_args != 0);
+    }
+
+    void compileTerminator(BlockIndex block, const IRTerminator& terminator) {
+        BlockIndex next = block + 1;
+        switch (terminator.kind) {
+            case IRTerminator::JUMP:
+                if (terminator.targets[0] != next) emitJump(BytecodeOp::JUMP, 0, terminator.targets[0]);
+                break;
+            case IRTerminator::BRANCH: {
+                uint32_t condition = reg(terminator.value);
+                BlockIndex if_true = terminator.targets[0];
+                BlockIndex if_false = terminator.targets[1];
+                if (if_true == next) {
+                    emitJump(BytecodeOp::JUMP_IF_FALSE, condition, if_false);
+                } else {
+                    emitJump(BytecodeOp::JUMP_IF_TRUE, condition, if_true);
+                    if (if_false != next) emitJump(BytecodeOp::JUMP, 0, if_false);
+                }
+                break;
+            }
+            case IRTerminator::RETURN: {
+                bool is_float = terminator.value.kind() != IROperand::NONE &&
+                                (terminator.value.kind() == IROperand::CONSTANT
+                                     ? m_program->constants[terminator.value.index()].type
+                                     : m_program->temp_types[terminator.value.index()]) == DataType::FLOAT;
+                emit(is_float ? BytecodeOp::RETURN_FLOAT : BytecodeOp::RETURN_INT, 0, reg(terminator.value));
+                break;
+            }
+            case IRTerminator::NONE:
+                throw std::runtime_error("Bytecode Error: unterminated block.");
+        }
+    }
+};
+
+} // namespace
+
+BytecodeProgram compile_bytecode(const IRModule& module, const NativeTable& natives) {
+    return BytecodeCompiler(module, natives).compile();
+}
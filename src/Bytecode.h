@@ -0,0 +1,130 @@
+#pragma once
+
+#include "IR.h"
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// A compact register-based bytecode for running a program without the
+// native toolchain: compile_bytecode() translates the IR (out of SSA form)
+// and run_bytecode() interprets it.
+//
+// Operands are plain indices into one flat register file. The first
+// registers are the IR's temporaries, and each constant gets a register of
+// its own after them, preloaded before the program starts. The interpreter
+// never looks at an operand's kind, and the instructions are specialized by
+// type (ADD_INT, ADD_FLOAT, ...) so it never looks at a type either.
+//
+// Each function of the program has a register file of its own, laid out
+// the same way, which a call pushes onto a stack of them; the top level's
+// is at the bottom.
+enum class BytecodeOp : uint8_t {
+    MOVE,          // dst = a
+    ADD_INT,       // dst = a + b, wrapping around
+    SUB_INT,
+    MUL_INT,
+    DIV_INT,       // dst = a / b, truncating; dividing by zero (or INT64_MIN by -1) is an error
+    ADD_FLOAT,     // dst = a + b
+    SUB_FLOAT,
+    MUL_FLOAT,
+    DIV_FLOAT,
+    EQ_INT,        // dst = a == b (and so on: 1 if true, 0 if false)
+    NE_INT,
+    LT_INT,
+    LE_INT,
+    GT_INT,
+    GE_INT,
+    EQ_FLOAT,      // Like the INT comparisons; any comparison with NaN is false, except !=
+    NE_FLOAT,
+    LT_FLOAT,
+    LE_FLOAT,
+    GT_FLOAT,
+    GE_FLOAT,
+    INT_TO_FLOAT,  // dst = (float) a
+    FLOAT_TO_INT,  // dst = (int) a, see truncate_to_int()
+    ARG,           // Argument slot dst of the next call = a (see BytecodeProgram::argument_slots)
+    CALL_INT,      // dst = natives[a](the arguments), returning an int; b: whether any are on the stack
+    CALL_FLOAT,    // Likewise, returning a float
+    CALL_FUNCTION, // dst = functions[a](the arguments), a function of the program
+    ARGUMENT,      // dst = argument slot a of the call that entered this function
+    JUMP,          // Continue at instruction a
+    JUMP_IF_TRUE,  // Continue at instruction b if a is nonzero
+    JUMP_IF_FALSE, // Continue at instruction b if a is zero
+    RETURN_INT,    // Return a from the function, or end the program with it
+    RETURN_FLOAT,  // Return a from the function, or end the program with (int) a
+    COUNT,
+};
+
+// One instruction, 16 bytes like an IRInstruction.
+struct BytecodeInstr {
+    BytecodeOp op;
+    uint32_t dst = 0;
+    uint32_t a = 0;
+    uint32_t b = 0;
+};
+static_assert(sizeof(BytecodeInstr) == 16, "Bytecode instructions are meant to stay 16 bytes");
+
+// A register holds either kind of value; the instruction knows which.
+union BytecodeValue {
+    int64_t i;
+    double f;
+};
+static_assert(sizeof(BytecodeValue) == 8, "Bytecode registers are meant to be 8 bytes");
+
+// The external functions bytecode can call. It starts out with runtime.c's
+// functions built in, so a program runs with nothing but mcc; others are
+// added by name. Calls follow the System V ABI, so any C function taking
+// ints (long) and doubles can be registered.
+class NativeTable {
+public:
+    NativeTable();
+
+    // `name` must outlive the table.
+    void add(std::string_view name, void* address) { m_functions[name] = address; }
+
+    // The address of `name`, or nullptr if it isn't registered.
+    void* find(std::string_view name) const {
+        auto it = m_functions.find(name);
+        return it == m_functions.end() ? nullptr : it->second;
+    }
+
+private:
+    std::unordered_map<std::string_view, void*> m_functions;
+};
+
+struct BytecodeProgram {
+    // Where each argument of a call of a native function goes: six integer
+    // registers, eight float registers, then the stack, the way the System V
+    // ABI assigns them. A function of the program takes argument i in slot
+    // i instead, however many it has.
+    static constexpr uint32_t INT_SLOTS = 6;
+    static constexpr uint32_t FLOAT_SLOTS = 8;
+    static constexpr uint32_t STACK_SLOTS = 8;
+    static constexpr uint32_t ARGUMENT_SLOTS = INT_SLOTS + FLOAT_SLOTS + STACK_SLOTS;
+
+    // Where a part of the program starts, and its initial register file.
+    struct Function {
+        uint32_t entry;          // In `code`
+        uint32_t first_register; // In `registers`
+        uint32_t register_count;
+    };
+
+    std::vector<BytecodeInstr> code;       // Starts at code[0], the top level's entry
+    std::vector<BytecodeValue> registers;  // The initial register files, one after another: zeroed
+                                           // temporaries, then the constants
+    std::vector<Function> functions;       // functions[0] is the top level, then IRModule's functions in order
+    std::vector<void*> natives;            // The external functions called (CALL operand a)
+    uint32_t argument_slots = ARGUMENT_SLOTS; // Enough for any call, native or not
+};
+
+// Translates `module`, which must be out of SSA form, resolving its calls
+// of external functions in `natives`. Throws std::runtime_error for a
+// function that isn't registered, or a call of one with more arguments than
+// the native slots hold.
+BytecodeProgram compile_bytecode(const IRModule& module, const NativeTable& natives);
+
+// Runs the program and returns its result, the value a native build would
+// exit with. Throws std::runtime_error on a division by zero (or of
+// INT64_MIN by -1), where the native program would trap.
+int64_t run_bytecode(const BytecodeProgram& program);
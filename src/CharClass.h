@@ -0,0 +1,151 @@
+#pragma once
+
+#include "Token.h"
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+// Compile-time tables used by the Lexer's hot loop.
+
+// --- Character classes ---
+
+enum CharClass : uint8_t {
+    CHAR_SPACE       = 1 << 0, // ' ', '\t', '\r', '\n'
+    CHAR_IDENT_START = 1 << 1, // [A-Za-z_]
+    CHAR_DIGIT       = 1 << 2, // [0-9]
+    CHAR_IDENT       = CHAR_IDENT_START | CHAR_DIGIT,
+    CHAR_PUNCT       = 1 << 3, // A complete single-character token
+    CHAR_PAIR        = 1 << 4, // May start a two-character operator
+};
+
+constexpr std::array<uint8_t, 256> make_char_classes() {
+    std::array<uint8_t, 256> table{};
+    for (int c = 0; c < 256; ++c) {
+        uint8_t bits = 0;
+        if (c == ' ' || c == '\t' || c == '\r' || c == '\n') bits |= CHAR_SPACE;
+        if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_') bits |= CHAR_IDENT_START;
+        if (c >= '0' && c <= '9') bits |= CHAR_DIGIT;
+        table[c] = bits;
+    }
+    for (char c : std::string_view("(){}[],.:;=+-*/!<>")) {
+        table[(unsigned char)c] |= CHAR_PUNCT;
+    }
+    for (char c : std::string_view("=!<>&|")) {
+        table[(unsigned char)c] |= CHAR_PAIR;
+    }
+    return table;
+}
+
+inline constexpr std::array<uint8_t, 256> CHAR_CLASSES = make_char_classes();
+
+inline bool is_char_class(char c, uint8_t mask) {
+    return (CHAR_CLASSES[(unsigned char)c] & mask) != 0;
+}
+
+// The token produced by each single-character punctuator.
+constexpr std::array<TokenType, 256> make_punctuation_tokens() {
+    std::array<TokenType, 256> table{};
+    for (auto& entry : table) entry = TokenType::UNKNOWN;
+    table['('] = TokenType::LEFT_PAREN;
+    table[')'] = TokenType::RIGHT_PAREN;
+    table['{'] = TokenType::LEFT_BRACE;
+    table['}'] = TokenType::RIGHT_BRACE;
+    table['['] = TokenType::LEFT_BRACKET;
+    table[']'] = TokenType::RIGHT_BRACKET;
+    table[','] = TokenType::COMMA;
+    table['.'] = TokenType::DOT;
+    table[':'] = TokenType::COLON;
+    table[';'] = TokenType::SEMICOLON;
+    table['='] = TokenType::EQUALS;
+    table['+'] = TokenType::PLUS;
+    table['-'] = TokenType::MINUS;
+    table['*'] = TokenType::STAR;
+    table['/'] = TokenType::SLASH;
+    table['!'] = TokenType::BANG;
+    table['<'] = TokenType::LESS;
+    table['>'] = TokenType::GREATER;
+    return table;
+}
+
+inline constexpr std::array<TokenType, 256> PUNCTUATION_TOKENS = make_punctuation_tokens();
+
+// The token for a two-character operator starting with a CHAR_PAIR character,
+// or UNKNOWN if `first` and `second` don't form one. ('&' and '|' are only
+// valid doubled.)
+constexpr TokenType punctuation_pair(char first, char second) {
+    if (first == '&' && second == '&') return TokenType::AND_AND;
+    if (first == '|' && second == '|') return TokenType::OR_OR;
+    if (second != '=') return TokenType::UNKNOWN;
+    switch (first) {
+        case '=': return TokenType::EQUAL_EQUAL;
+        case '!': return TokenType::BANG_EQUAL;
+        case '<': return TokenType::LESS_EQUAL;
+        case '>': return TokenType::GREATER_EQUAL;
+        default:  return TokenType::UNKNOWN;
+    }
+}
+
+// --- Keywords ---
+//
+// Keywords are recognized with a perfect hash: every keyword lands in its own
+// slot of a small table, so a lookup is one hash, one length check and one
+// comparison. The static_assert below fails the build if a newly added
+// keyword collides with an existing one; tweak keyword_hash() if it does.
+
+struct Keyword {
+    std::string_view text;
+    TokenType type;
+};
+
+inline constexpr Keyword KEYWORDS[] = {
+    {"let", TokenType::LET},
+    {"fn", TokenType::FN},
+    {"return", TokenType::RETURN},
+};
+
+constexpr size_t KEYWORD_TABLE_SIZE = 16; // A power of two
+
+constexpr uint32_t keyword_hash(const char* text, size_t length) {
+    return ((uint8_t)text[0] * 7u + (uint8_t)text[length - 1] * 3u + (uint32_t)length) &
+           (KEYWORD_TABLE_SIZE - 1);
+}
+
+struct KeywordTable {
+    Keyword slots[KEYWORD_TABLE_SIZE];
+    size_t min_length;
+    size_t max_length;
+};
+
+constexpr KeywordTable make_keyword_table() {
+    KeywordTable table{};
+    for (auto& slot : table.slots) slot = {std::string_view(), TokenType::IDENTIFIER};
+    table.min_length = SIZE_MAX;
+    table.max_length = 0;
+    for (const Keyword& keyword : KEYWORDS) {
+        table.slots[keyword_hash(keyword.text.data(), keyword.text.size())] = keyword;
+        if (keyword.text.size() < table.min_length) table.min_length = keyword.text.size();
+        if (keyword.text.size() > table.max_length) table.max_length = keyword.text.size();
+    }
+    return table;
+}
+
+inline constexpr KeywordTable KEYWORD_TABLE = make_keyword_table();
+
+constexpr bool keyword_hash_is_perfect() {
+    for (const Keyword& keyword : KEYWORDS) {
+        if (KEYWORD_TABLE.slots[keyword_hash(keyword.text.data(), keyword.text.size())].text != keyword.text) {
+            return false;
+        }
+    }
+    return true;
+}
+static_assert(keyword_hash_is_perfect(), "Two keywords share a slot in the keyword hash table");
+
+// Returns the keyword's token type, or IDENTIFIER if `text` isn't a keyword.
+inline TokenType lookup_keyword(std::string_view text) {
+    if (text.size() < KEYWORD_TABLE.min_length || text.size() > KEYWORD_TABLE.max_length) {
+        return TokenType::IDENTIFIER;
+    }
+    const Keyword& slot = KEYWORD_TABLE.slots[keyword_hash(text.data(), text.size())];
+    return slot.text == text ? slot.type : TokenType::IDENTIFIER;
+}
@@ -0,0 +1,140 @@
+#include "CharScan.h"
+#include "CharClass.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define MCC_X86_SIMD 1
+#endif
+
+namespace {
+
+// --- Scalar fallback ---
+
+template <uint8_t Class>
+const char* scan_scalar(const char* first, const char* last) {
+    while (first < last && is_char_class(*first, Class)) ++first;
+    return first;
+}
+
+#ifdef MCC_X86_SIMD
+
+// --- SSE2 (always available on x86-64) ---
+
+// Bytes of `x` in [lo, hi] become 0xFF: (x - lo) <= (hi - lo), unsigned.
+inline __m128i in_range_sse2(__m128i x, char lo, char hi) {
+    __m128i shifted = _mm_sub_epi8(x, _mm_set1_epi8(lo));
+    return _mm_cmpeq_epi8(_mm_min_epu8(shifted, _mm_set1_epi8((char)(hi - lo))), shifted);
+}
+
+template <uint8_t Class>
+inline __m128i class_mask_sse2(__m128i x) {
+    if constexpr (Class == CHAR_SPACE) {
+        __m128i mask = _mm_cmpeq_epi8(x, _mm_set1_epi8(' '));
+        mask = _mm_or_si128(mask, _mm_cmpeq_epi8(x, _mm_set1_epi8('\n')));
+        mask = _mm_or_si128(mask, _mm_cmpeq_epi8(x, _mm_set1_epi8('\t')));
+        return _mm_or_si128(mask, _mm_cmpeq_epi8(x, _mm_set1_epi8('\r')));
+    } else if constexpr (Class == CHAR_DIGIT) {
+        return in_range_sse2(x, '0', '9');
+    } else {
+        // Setting bit 5 folds 'A'-'Z' onto 'a'-'z' without making any other
+        // byte land in that range.
+        __m128i letters = in_range_sse2(_mm_or_si128(x, _mm_set1_epi8(0x20)), 'a', 'z');
+        __m128i mask = _mm_or_si128(letters, in_range_sse2(x, '0', '9'));
+        return _mm_or_si128(mask, _mm_cmpeq_epi8(x, _mm_set1_epi8('_')));
+    }
+}
+
+template <uint8_t Class>
+const char* scan_sse2(const char* first, const char* last) {
+    while (last - first >= 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+        unsigned matches = (unsigned)_mm_movemask_epi8(class_mask_sse2<Class>(chunk));
+        if (matches != 0xFFFFu) return first + __builtin_ctz(~matches);
+        first += 16;
+    }
+    return scan_scalar<Class>(first, last);
+}
+
+// --- AVX2 ---
+
+__attribute__((target("avx2")))
+inline __m256i in_range_avx2(__m256i x, char lo, char hi) {
+    __m256i shifted = _mm256_sub_epi8(x, _mm256_set1_epi8(lo));
+    return _mm256_cmpeq_epi8(_mm256_min_epu8(shifted, _mm256_set1_epi8((char)(hi - lo))), shifted);
+}
+
+template <uint8_t Class>
+__attribute__((target("avx2")))
+inline __m256i class_mask_avx2(__m256i x) {
+    if constexpr (Class == CHAR_SPACE) {
+        __m256i mask = _mm256_cmpeq_epi8(x, _mm256_set1_epi8(' '));
+        mask = _mm256_or_si256(mask, _mm256_cmpeq_epi8(x, _mm256_set1_epi8('\n')));
+        mask = _mm256_or_si256(mask, _mm256_cmpeq_epi8(x, _mm256_set1_epi8('\t')));
+        return _mm256_or_si256(mask, _mm256_cmpeq_epi8(x, _mm256_set1_epi8('\r')));
+    } else if constexpr (Class == CHAR_DIGIT) {
+        return in_range_avx2(x, '0', '9');
+    } else {
+        __m256i letters = in_range_avx2(_mm256_or_si256(x, _mm256_set1_epi8(0x20)), 'a', 'z');
+        __m256i mask = _mm256_or_si256(letters, in_range_avx2(x, '0', '9'));
+        return _mm256_or_si256(mask, _mm256_cmpeq_epi8(x, _mm256_set1_epi8('_')));
+    }
+}
+
+template <uint8_t Class>
+__attribute__((target("avx2")))
+const char* scan_avx2(const char* first, const char* last) {
+    while (last - first >= 32) {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first));
+        unsigned matches = (unsigned)_mm256_movemask_epi8(class_mask_avx2<Class>(chunk));
+        if (matches != 0xFFFFFFFFu) return first + __builtin_ctz(~matches);
+        first += 32;
+    }
+    return scan_sse2<Class>(first, last);
+}
+
+#endif // MCC_X86_SIMD
+
+const CharScanners SCALAR_SCANNERS = {
+    "scalar", scan_scalar<CHAR_SPACE>, scan_scalar<CHAR_IDENT>, scan_scalar<CHAR_DIGIT>};
+
+#ifdef MCC_X86_SIMD
+const CharScanners SSE2_SCANNERS = {
+    "sse2", scan_sse2<CHAR_SPACE>, scan_sse2<CHAR_IDENT>, scan_sse2<CHAR_DIGIT>};
+const CharScanners AVX2_SCANNERS = {
+    "avx2", scan_avx2<CHAR_SPACE>, scan_avx2<CHAR_IDENT>, scan_avx2<CHAR_DIGIT>};
+#endif
+
+const CharScanners* best_scanners() {
+#ifdef MCC_X86_SIMD
+    if (__builtin_cpu_supports("avx2")) return &AVX2_SCANNERS;
+    return &SSE2_SCANNERS;
+#else
+    return &SCALAR_SCANNERS;
+#endif
+}
+
+const CharScanners* g_scanners = best_scanners();
+
+} // namespace
+
+const CharScanners& char_scanners() {
+    return *g_scanners;
+}
+
+bool select_char_scanners(std::string_view name) {
+    if (name == "scalar") {
+        g_scanners = &SCALAR_SCANNERS;
+        return true;
+    }
+#ifdef MCC_X86_SIMD
+    if (name == "sse2") {
+        g_scanners = &SSE2_SCANNERS;
+        return true;
+    }
+    if (name == "avx2" && __builtin_cpu_supports("avx2")) {
+        g_scanners = &AVX2_SCANNERS;
+        return true;
+    }
+#endif
+    return false;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <string_view>
+
+// Vectorized scanning over runs of characters that share a CharClass.
+//
+// Each scanner returns the first position in [first, last) whose character is
+// NOT in its class (or `last` if the whole range is). On x86-64 they compare
+// 16 (SSE2) or 32 (AVX2) bytes at a time; elsewhere they fall back to a
+// scalar loop over the CHAR_CLASSES table. The implementation is chosen once,
+// at startup, from what the CPU supports.
+struct CharScanners {
+    const char* name; // "scalar", "sse2" or "avx2"
+    const char* (*spaces)(const char* first, const char* last);
+    const char* (*identifier)(const char* first, const char* last);
+    const char* (*digits)(const char* first, const char* last);
+};
+
+// The scanners in use by every Lexer.
+const CharScanners& char_scanners();
+
+// Forces a particular implementation ("scalar", "sse2", "avx2"), e.g. for
+// benchmarking. Returns false if it isn't available on this machine.
+bool select_char_scanners(std::string_view name);
@@ -1,163 +1,943 @@
 #include "CodeGenerator.h"
-#include <vector>
+#include <algorithm>
+#include <cstring>
 #include <iostream>
+#include <iterator>
+#include <utility>
+#include <stdexcept>
 
-// Helper function to get the correct assembly operand string.
-// This is a robust version that handles all cases correctly.
-std::string get_operand_asm(const IROperand& operand, const std::map<std::string, int>& stack_offsets, const std::map<std::string, std::string>& temp_registers) {
-    // Case 1: The operand is a literal integer.
-    if (auto val = std::get_if<int>(&operand)) {
-        return std::to_string(*val);
-    }
-    // Case 2: The operand is a literal double (we truncate to int for now).
-    if (auto val = std::get_if<double>(&operand)) {
-        return std::to_string(static_cast<int>(*val));
-    }
-    // Case 3: The operand is a string (variable name or temporary).
-    if (auto var_name = std::get_if<std::string>(&operand)) {
-        // Check if it's a temporary stored in a register.
-        if (temp_registers.count(*var_name)) {
-            return temp_registers.at(*var_name);
+static bool fits_imm32(long long value) {
+    return value >= INT32_MIN && value <= INT32_MAX;
+}
+
+static MachineOperand gpr(Register reg) {
+    return MachineOperand::of(reg);
+}
+
+static MachineOperand xmm(Register reg) {
+    return MachineOperand::of(reg);
+}
+
+// The literal pool entry holding `value`, shared by every use of the same bits.
+uint32_t CodeGenerator::literal(double value) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    auto [it, inserted] = m_literal_indices.try_emplace(bits, (uint32_t)m_code.literals.size());
+    if (inserted) m_code.literals.push_back(bits);
+    return it->second;
+}
+
+// Helper function to get the machine operand for an IR operand.
+MachineOperand CodeGenerator::operand(IROperand ir_operand) {
+    switch (ir_operand.kind()) {
+        // Case 1: A literal from the constant pool. x86 has no float
+        // immediates, so doubles are read from the read-only data.
+        case IROperand::CONSTANT: {
+            const IRConstant& constant = m_program->constants[ir_operand.index()];
+            if (constant.type == DataType::FLOAT) {
+                return MachineOperand::literal(literal(constant.float_value));
+            }
+            return MachineOperand::immediate(constant.int_value);
+        }
+        // Case 2: A temporary, in the register or stack slot it was allocated.
+        case IROperand::TEMP: {
+            const TempLocation& location = m_allocation->locations[ir_operand.index()];
+            if (location.kind == TempLocation::REGISTER) return MachineOperand::of(location.reg);
+            return stack_slot(location.slot);
+        }
+        // Case 3: An external name can only be called, not used as a value.
+        case IROperand::SYMBOL:
+            throw std::runtime_error("Code Generation Error: '" + std::string(m_program->symbols[ir_operand.index()]) +
+                                     "' is not a declared variable.");
+        case IROperand::NONE:
+            break;
+    }
+    throw std::runtime_error("Code Generation Error: missing operand.");
+}
+
+// Spill slots sit just above the outgoing argument area, addressed from rsp,
+// or below the saved rbp (and any saved registers) when there is a frame
+// pointer.
+MachineOperand CodeGenerator::stack_slot(uint32_t slot) const {
+    if (m_options.omit_frame_pointer) {
+        return MachineOperand::memory(Register::RSP, 8 * (int32_t)(m_outgoing_slots + slot));
+    }
+    return MachineOperand::memory(Register::RBP, -8 * ((int32_t)(m_saved_registers.size() + slot) + 1));
+}
+
+DataType CodeGenerator::type_of(IROperand ir_operand) const {
+    switch (ir_operand.kind()) {
+        case IROperand::CONSTANT: return m_program->constants[ir_operand.index()].type;
+        case IROperand::TEMP:     return m_program->temp_types[ir_operand.index()];
+        default:                  return DataType::INT;
+    }
+}
+
+MachineOperand CodeGenerator::source(IROperand ir_operand) {
+    return source(operand(ir_operand));
+}
+
+MachineOperand CodeGenerator::source(MachineOperand result) {
+    if (result.kind == MachineOperand::IMMEDIATE && !fits_imm32(result.value)) {
+        emit(MachineOp::MOV, gpr(Register::R11), result);
+        return gpr(Register::R11);
+    }
+    return result;
+}
+
+void CodeGenerator::emit(MachineOp op, MachineOperand dst, MachineOperand src) {
+    m_code.instructions.push_back({op, Condition::EQ, dst, src, {}});
+}
+
+void CodeGenerator::emit_conditional(MachineOp op, Condition condition, MachineOperand dst) {
+    m_code.instructions.push_back({op, condition, dst, {}, {}});
+}
+
+void CodeGenerator::emit_move(IROperand dest, IROperand value, DataType type) {
+    if (type == DataType::FLOAT) {
+        emit_float_move(operand(dest), operand(value));
+    } else {
+        emit_move(operand(dest), operand(value));
+    }
+}
+
+// dest = value, going through rax only when x86 can't move it directly
+// (memory to memory), or r11 for a 64-bit immediate to memory.
+void CodeGenerator::emit_move(MachineOperand dest, MachineOperand value) {
+    if (dest == value) return;
+
+    if (dest.kind == MachineOperand::MEMORY) {
+        if (value.kind == MachineOperand::MEMORY) {
+            emit(MachineOp::MOV, gpr(Register::RAX), value);
+            value = gpr(Register::RAX);
         } else {
-            // Otherwise, it must be a variable on the stack.
-            int offset = stack_offsets.at(*var_name);
-            
-            // Correctly format the stack address.
-            if (offset < 0) {
-                return "[rbp" + std::to_string(offset) + "]";
-            } else if (offset > 0) {
-                return "[rbp+" + std::to_string(offset) + "]";
-            } else {
-                return "[rbp]";
+            value = source(value);
+        }
+    }
+    emit(MachineOp::MOV, dest, value);
+}
+
+// dest = value for a double in an xmm register, a stack slot or the literal
+// pool. Memory to memory copies the bits through rax.
+void CodeGenerator::emit_float_move(MachineOperand dest, MachineOperand value) {
+    if (dest == value) return;
+    if (dest.kind == MachineOperand::REGISTER) {
+        if (value.kind == MachineOperand::LITERAL && m_code.literals[value.value] == 0) {
+            emit(MachineOp::XORPD, dest, dest); // +0.0
+        } else {
+            emit(MachineOp::MOVSD, dest, value);
+        }
+        return;
+    }
+    if (value.is_memory()) {
+        emit(MachineOp::MOV, gpr(Register::RAX), value);
+        emit(MachineOp::MOV, dest, gpr(Register::RAX));
+        return;
+    }
+    emit(MachineOp::MOVSD, dest, value);
+}
+
+void CodeGenerator::generate(const IRProgram& program, const RegisterAllocation& allocation) {
+    if (program.in_ssa) {
+        throw std::runtime_error("Code Generation Error: the IR is still in SSA form.");
+    }
+    m_program = &program;
+    m_allocation = &allocation;
+    m_code.instructions.clear();
+    m_code.instructions.reserve(4 * program.instruction_count() + 8);
+    m_code.symbols.assign(program.symbols.begin(), program.symbols.end());
+    m_code.literals.clear();
+    m_literal_indices.clear();
+    m_params.clear();
+    m_callable = m_options.callable || !program.name.empty();
+    if (m_options.use_fma) countUses();
+
+    // --- Stack frame: the spilled temporaries above the outgoing arguments ---
+    // _start is entered with rsp 16-byte aligned, and the frame keeps it so
+    // at every call. It never returns, so it has no registers to preserve.
+    // A callable entry is entered with the return address pushed, and saves
+    // the callee-saved registers it uses below the frame pointer.
+    m_outgoing_slots = 0;
+    for (const IRBlock& block : program.blocks) {
+        uint32_t int_args = 0;
+        uint32_t float_args = 0;
+        for (const IRInstruction& instr : block.instructions) {
+            if (instr.op == IROp::PARAM) {
+                ++(instr.type == DataType::FLOAT ? float_args : int_args);
+            } else if (instr.op == IROp::CALL) {
+                uint32_t stack_args = (int_args > std::size(INTEGER_ARGUMENT_REGISTERS) ? int_args - (uint32_t)std::size(INTEGER_ARGUMENT_REGISTERS) : 0) +
+                                      (float_args > std::size(FLOAT_ARGUMENT_REGISTERS) ? float_args - (uint32_t)std::size(FLOAT_ARGUMENT_REGISTERS) : 0);
+                m_outgoing_slots = std::max(m_outgoing_slots, stack_args);
+                int_args = float_args = 0;
+            }
+        }
+    }
+    int64_t pushed = m_callable ? 8 : 0; // Bytes on the stack above the frame
+    if (!m_options.omit_frame_pointer) {
+        emit(MachineOp::PUSH, {}, gpr(Register::RBP));
+        emit(MachineOp::MOV, gpr(Register::RBP), gpr(Register::RSP));
+        pushed += 8;
+    }
+    m_saved_registers.clear();
+    if (m_callable) {
+        for (Register reg : {Register::RBX, Register::R12, Register::R13, Register::R14, Register::R15}) {
+            if (allocation.registers_used & register_bit(reg)) {
+                emit(MachineOp::PUSH, {}, gpr(reg));
+                m_saved_registers.push_back(reg);
+                pushed += 8;
+            }
+        }
+    }
+    m_frame_size = 8 * ((int64_t)allocation.spill_slots + m_outgoing_slots);
+    m_frame_size = ((m_frame_size + pushed + 15) & ~(int64_t)15) - pushed;
+    if (m_frame_size != 0) {
+        emit(MachineOp::SUB, gpr(Register::RSP), MachineOperand::immediate(m_frame_size));
+    }
+    if (!program.parameters.empty()) emit_arguments(program.blocks[0], pushed);
+
+    // --- Translate the blocks in order ---
+    // Only blocks that something jumps to need a label, and a jump to the
+    // block that comes next anyway is left out.
+    for (BlockIndex b = 0; b < program.blocks.size(); ++b) {
+        const IRBlock& block = program.blocks[b];
+        if (!block.predecessors.empty()) {
+            emit(MachineOp::LABEL, MachineOperand::label(b));
+        }
+        for (size_t i = 0; i < block.instructions.size(); ++i) {
+            if (i + 1 < block.instructions.size() && can_fuse(block.instructions[i], block.instructions[i + 1])) {
+                emit_fused_multiply_add(block.instructions[i], block.instructions[i + 1]);
+                ++i;
+                continue;
             }
+            emit_instruction(block.instructions[i]);
         }
+        emit_terminator(b, block.terminator);
     }
-    return "UNKNOWN_OPERAND";
 }
 
 
-CodeGenerator::CodeGenerator(const std::string& output_filename) {
-    m_output_file.open(output_filename);
-    if (!m_output_file.is_open()) {
-        throw std::runtime_error("Could not open output file for code generation.");
+static Condition comparison_condition(IROp op) {
+    switch (op) {
+        case IROp::CMP_NE: return Condition::NE;
+        case IROp::CMP_LT: return Condition::LT;
+        case IROp::CMP_LE: return Condition::LE;
+        case IROp::CMP_GT: return Condition::GT;
+        case IROp::CMP_GE: return Condition::GE;
+        default:           return Condition::EQ;
     }
 }
 
-void CodeGenerator::generate(const IRProgram& program) {
-    // --- Boilerplate Assembly Header ---
-    m_output_file << "section .text\n";
-    m_output_file << "extern my_func\n\n";
-    m_output_file << "global _start\n\n";
-    m_output_file << "_start:\n";
-    m_output_file << "    push rbp\n";
-    m_output_file << "    mov rbp, rsp\n\n";
+static Condition mirrored(Condition condition) {
+    switch (condition) {
+        case Condition::LT: return Condition::GT;
+        case Condition::LE: return Condition::GE;
+        case Condition::GT: return Condition::LT;
+        case Condition::GE: return Condition::LE;
+        default:            return condition; // EQ and NE are symmetric
+    }
+}
 
-    // --- First Pass: Find all variables and allocate stack space ---
-    for (const auto& instr : program.instructions) {
-        if (instr.op == TokenType::EQUALS) {
-            if (auto var_name = std::get_if<std::string>(&instr.result)) {
-                if (m_stack_offsets.find(*var_name) == m_stack_offsets.end()) {
-                    allocate_variable(*var_name);
-                }
+static bool is_power_of_two(uint64_t value) {
+    return value != 0 && (value & (value - 1)) == 0;
+}
+
+static int log2_exact(uint64_t value) {
+    return __builtin_ctzll(value);
+}
+
+// The magic multiplier and shift that turn signed division by `divisor`
+// into a multiplication (Hacker's Delight, section 10-4): n / d is the high
+// half of n * M, corrected by n when M's sign is wrong, shifted right by
+// `shift`, plus one if that result is negative. `divisor` must not be 0, 1,
+// -1 or INT64_MIN.
+struct DivisionMagic {
+    int64_t multiplier;
+    int shift;
+};
+
+static DivisionMagic division_magic(int64_t divisor) {
+    const uint64_t two63 = 1ull << 63;
+    uint64_t ad = divisor < 0 ? 0 - (uint64_t)divisor : (uint64_t)divisor;
+    uint64_t t = two63 + ((uint64_t)divisor >> 63);
+    uint64_t anc = t - 1 - t % ad; // Absolute value of nc
+    int p = 63;
+    uint64_t q1 = two63 / anc, r1 = two63 - q1 * anc; // 2^p / |nc| and its remainder
+    uint64_t q2 = two63 / ad, r2 = two63 - q2 * ad;   // 2^p / |d| and its remainder
+    uint64_t delta;
+    do {
+        ++p;
+        q1 *= 2;
+        r1 *= 2;
+        if (r1 >= anc) {
+            ++q1;
+            r1 -= anc;
+        }
+        q2 *= 2;
+        r2 *= 2;
+        if (r2 >= ad) {
+            ++q2;
+            r2 -= ad;
+        }
+        delta = ad - r2;
+    } while (q1 < delta || (q1 == delta && r1 == 0));
+
+    uint64_t multiplier = q2 + 1;
+    if (divisor < 0) multiplier = 0 - multiplier;
+    return {(int64_t)multiplier, p - 64};
+}
+
+bool CodeGenerator::constant_value(IROperand ir_operand, int64_t& value) const {
+    if (ir_operand.kind() != IROperand::CONSTANT) return false;
+    const IRConstant& constant = m_program->constants[ir_operand.index()];
+    if (constant.type != DataType::INT) return false;
+    value = constant.int_value;
+    return true;
+}
+
+// result = lhs <op> rhs with a two-address add, sub or imul, working in
+// the result's own register when it has one.
+void CodeGenerator::emit_binary(MachineOp op, IROperand result, IROperand lhs, IROperand rhs) {
+    MachineOperand dest = operand(result);
+    MachineOperand left = operand(lhs);
+    MachineOperand right = operand(rhs);
+    bool commutative = op != MachineOp::SUB;
+    if (commutative && dest == right && dest != left) {
+        std::swap(left, right);
+    }
+
+    if (dest.kind == MachineOperand::REGISTER) {
+        if (dest == left) {
+            emit(op, dest, source(right));
+        } else if (dest != right) {
+            emit(MachineOp::MOV, dest, left);
+            emit(op, dest, source(right));
+        } else { // dest = left - dest
+            emit(MachineOp::NEG, dest);
+            emit(MachineOp::ADD, dest, source(left));
+        }
+        return;
+    }
+
+    // A stack slot can be updated in place, except by imul.
+    if (op != MachineOp::IMUL && dest == left && right.kind != MachineOperand::MEMORY) {
+        emit(op, dest, source(right));
+        return;
+    }
+    MachineOperand rax = gpr(Register::RAX);
+    emit(MachineOp::MOV, rax, left);
+    emit(op, rax, source(right));
+    emit(MachineOp::MOV, dest, rax);
+}
+
+// result = -value
+void CodeGenerator::emit_negate(IROperand result, IROperand value) {
+    MachineOperand dest = operand(result);
+    MachineOperand input = operand(value);
+    if (dest == input) {
+        emit(MachineOp::NEG, dest);
+        return;
+    }
+    MachineOperand work = dest.kind == MachineOperand::REGISTER ? dest : gpr(Register::RAX);
+    emit(MachineOp::MOV, work, input);
+    emit(MachineOp::NEG, work);
+    if (work != dest) emit(MachineOp::MOV, dest, work);
+}
+
+void CodeGenerator::emit_add(IROperand result, IROperand lhs, IROperand rhs) {
+    int64_t constant;
+    if (constant_value(lhs, constant) && rhs.kind() != IROperand::CONSTANT) std::swap(lhs, rhs);
+    if (constant_value(rhs, constant) && constant == 0) {
+        emit_move(result, lhs);
+        return;
+    }
+
+    // lea computes a sum into a third register without touching the flags.
+    MachineOperand dest = operand(result);
+    MachineOperand left = operand(lhs);
+    MachineOperand right = operand(rhs);
+    if (dest.kind == MachineOperand::REGISTER && left.kind == MachineOperand::REGISTER && dest != left) {
+        if (right.kind == MachineOperand::IMMEDIATE && fits_imm32(right.value)) {
+            emit(MachineOp::LEA, dest, MachineOperand::memory(left.reg, (int32_t)right.value));
+            return;
+        }
+        if (right.kind == MachineOperand::REGISTER && dest != right) {
+            emit(MachineOp::LEA, dest, MachineOperand::address(left.reg, right.reg, 1, 0));
+            return;
+        }
+    }
+    emit_binary(MachineOp::ADD, result, lhs, rhs);
+}
+
+void CodeGenerator::emit_subtract(IROperand result, IROperand lhs, IROperand rhs) {
+    int64_t constant;
+    if (constant_value(rhs, constant)) {
+        if (constant == 0) {
+            emit_move(result, lhs);
+            return;
+        }
+        MachineOperand dest = operand(result);
+        MachineOperand left = operand(lhs);
+        if (dest.kind == MachineOperand::REGISTER && left.kind == MachineOperand::REGISTER && dest != left &&
+            constant != INT64_MIN && fits_imm32(-constant)) {
+            emit(MachineOp::LEA, dest, MachineOperand::memory(left.reg, (int32_t)-constant));
+            return;
+        }
+    } else if (constant_value(lhs, constant) && constant == 0) { // -x
+        emit_negate(result, rhs);
+        return;
+    }
+    emit_binary(MachineOp::SUB, result, lhs, rhs);
+}
+
+// Multiplication by a constant becomes a move, a negation, a shift or a
+// lea where one of those does the job, and an imul with an immediate
+// otherwise.
+void CodeGenerator::emit_multiply(IROperand result, IROperand lhs, IROperand rhs) {
+    int64_t constant;
+    if (constant_value(lhs, constant) && rhs.kind() != IROperand::CONSTANT) std::swap(lhs, rhs);
+    if (!constant_value(rhs, constant)) {
+        emit_binary(MachineOp::IMUL, result, lhs, rhs);
+        return;
+    }
+    if (constant == 1) {
+        emit_move(result, lhs);
+        return;
+    }
+    if (constant == -1) {
+        emit_negate(result, lhs);
+        return;
+    }
+
+    MachineOperand dest = operand(result);
+    MachineOperand value = operand(lhs);
+    if (constant == 0) {
+        emit(MachineOp::MOV, dest, MachineOperand::immediate(0));
+        return;
+    }
+
+    bool shift = constant > 0 && is_power_of_two((uint64_t)constant);
+    bool scaled = constant == 3 || constant == 5 || constant == 9; // x + x * 2, 4 or 8
+    if (!shift && !scaled) {
+        emit_binary(MachineOp::IMUL, result, lhs, rhs);
+        return;
+    }
+    if (shift && dest == value) {
+        emit(MachineOp::SHL, dest, MachineOperand::immediate(log2_exact((uint64_t)constant)));
+        return;
+    }
+
+    MachineOperand work = dest.kind == MachineOperand::REGISTER ? dest : gpr(Register::RAX);
+    if (shift) {
+        emit(MachineOp::MOV, work, value);
+        emit(MachineOp::SHL, work, MachineOperand::immediate(log2_exact((uint64_t)constant)));
+    } else {
+        if (value.kind != MachineOperand::REGISTER) {
+            emit(MachineOp::MOV, work, value);
+            value = work;
+        }
+        emit(MachineOp::LEA, work, MachineOperand::address(value.reg, value.reg, (uint8_t)(constant - 1), 0));
+    }
+    if (work != dest) emit(MachineOp::MOV, dest, work);
+}
+
+// Signed division truncating toward zero. A constant divisor avoids idiv
+// (tens of cycles): a power of two becomes a shift that rounds negative
+// dividends up, and anything else a multiplication by a magic number.
+void CodeGenerator::emit_divide(IROperand result, IROperand lhs, IROperand rhs) {
+    const MachineOperand rax = gpr(Register::RAX);
+    const MachineOperand rdx = gpr(Register::RDX);
+    MachineOperand dest = operand(result);
+    int64_t divisor;
+    bool constant = constant_value(rhs, divisor);
+
+    // 0, -1 and INT64_MIN are left to idiv, which traps as it should for
+    // the first two.
+    if (!constant || divisor == 0 || divisor == -1 || divisor == INT64_MIN) {
+        MachineOperand divisor_operand = operand(rhs);
+        if (divisor_operand.kind == MachineOperand::IMMEDIATE) { // idiv takes no immediate
+            emit(MachineOp::MOV, gpr(Register::R11), divisor_operand);
+            divisor_operand = gpr(Register::R11);
+        }
+        emit(MachineOp::MOV, rax, operand(lhs));
+        emit(MachineOp::CQO);
+        emit(MachineOp::IDIV, {}, divisor_operand);
+        emit(MachineOp::MOV, dest, rax);
+        return;
+    }
+    if (divisor == 1) {
+        emit_move(result, lhs);
+        return;
+    }
+
+    uint64_t magnitude = divisor < 0 ? 0 - (uint64_t)divisor : (uint64_t)divisor;
+    if (is_power_of_two(magnitude)) {
+        // Add 2^k - 1 to a negative dividend first, so the shift rounds toward zero.
+        int k = log2_exact(magnitude);
+        emit(MachineOp::MOV, rax, operand(lhs));
+        emit(MachineOp::CQO);
+        emit(MachineOp::SHR, rdx, MachineOperand::immediate(64 - k));
+        emit(MachineOp::ADD, rax, rdx);
+        emit(MachineOp::SAR, rax, MachineOperand::immediate(k));
+        if (divisor < 0) emit(MachineOp::NEG, rax);
+        emit(MachineOp::MOV, dest, rax);
+        return;
+    }
+
+    DivisionMagic magic = division_magic(divisor);
+    MachineOperand dividend = operand(lhs);
+    if (dividend.kind == MachineOperand::IMMEDIATE) {
+        emit(MachineOp::MOV, gpr(Register::R11), dividend);
+        dividend = gpr(Register::R11);
+    }
+    emit(MachineOp::MOV, rax, MachineOperand::immediate(magic.multiplier));
+    emit(MachineOp::IMUL, {}, dividend); // rdx = high half of the product
+    if (divisor > 0 && magic.multiplier < 0) emit(MachineOp::ADD, rdx, dividend);
+    if (divisor < 0 && magic.multiplier > 0) emit(MachineOp::SUB, rdx, dividend);
+    if (magic.shift > 0) emit(MachineOp::SAR, rdx, MachineOperand::immediate(magic.shift));
+    emit(MachineOp::MOV, rax, rdx);
+    emit(MachineOp::SHR, rax, MachineOperand::immediate(63));
+    emit(MachineOp::ADD, rdx, rax);
+    emit(MachineOp::MOV, dest, rdx);
+}
+
+// Compares the operands directly (with the constant on the right, mirroring
+// the condition if needed) and turns the flags into 0 or 1.
+void CodeGenerator::emit_compare(IROp op, IROperand result, IROperand lhs, IROperand rhs) {
+    const MachineOperand rax = gpr(Register::RAX);
+    Condition condition = comparison_condition(op);
+    MachineOperand dest = operand(result);
+    MachineOperand left = operand(lhs);
+    MachineOperand right = operand(rhs);
+    if (left.kind == MachineOperand::IMMEDIATE && right.kind != MachineOperand::IMMEDIATE) {
+        std::swap(left, right);
+        condition = mirrored(condition);
+    }
+
+    // Zeroing the result up front lets setcc write it directly, but only if
+    // the comparison doesn't read it.
+    bool zero_first = dest.kind == MachineOperand::REGISTER &&
+                      ((registers_read_by(left) | registers_read_by(right)) & register_bit(dest.reg)) == 0;
+    if (zero_first) emit(MachineOp::XOR, dest, dest);
+
+    if (left.kind == MachineOperand::IMMEDIATE ||
+        (left.kind == MachineOperand::MEMORY && right.kind == MachineOperand::MEMORY)) {
+        emit(MachineOp::MOV, rax, left);
+        left = rax;
+    }
+    emit(MachineOp::CMP, left, source(right));
+
+    if (zero_first) {
+        emit_conditional(MachineOp::SETCC, condition, dest);
+    } else {
+        emit_conditional(MachineOp::SETCC, condition, rax);
+        if (dest.kind == MachineOperand::REGISTER) {
+            emit(MachineOp::MOVZX, dest, rax);
+        } else {
+            emit(MachineOp::MOVZX, rax, rax);
+            emit(MachineOp::MOV, dest, rax);
+        }
+    }
+}
+
+// Every instruction reads all of its operands before it writes its result,
+// so the result may share a register with an operand whose last use this is.
+void CodeGenerator::emit_instruction(const IRInstruction& instr) {
+    if (instr.type == DataType::FLOAT && instr.op >= IROp::ADD && instr.op <= IROp::CMP_GE) {
+        if (instr.op <= IROp::DIV) {
+            emit_float_binary(instr.op, instr.result, instr.arg1, instr.arg2);
+        } else {
+            emit_float_compare(instr.op, instr.result, instr.arg1, instr.arg2);
+        }
+        return;
+    }
+
+    switch (instr.op) {
+        case IROp::ADD: emit_add(instr.result, instr.arg1, instr.arg2); break;
+        case IROp::SUB: emit_subtract(instr.result, instr.arg1, instr.arg2); break;
+        case IROp::MUL: emit_multiply(instr.result, instr.arg1, instr.arg2); break;
+        case IROp::DIV: emit_divide(instr.result, instr.arg1, instr.arg2); break;
+        case IROp::CMP_EQ:
+        case IROp::CMP_NE:
+        case IROp::CMP_LT:
+        case IROp::CMP_LE:
+        case IROp::CMP_GT:
+        case IROp::CMP_GE:
+            emit_compare(instr.op, instr.result, instr.arg1, instr.arg2);
+            break;
+        case IROp::COPY:
+            emit_move(instr.result, instr.arg1, instr.type);
+            break;
+        case IROp::CAST:
+            emit_cast(instr);
+            break;
+        case IROp::PARAM:
+            // Arguments are placed when their CALL is reached.
+            m_params.push_back(instr);
+            break;
+        case IROp::CALL:
+            emit_call(instr);
+            break;
+        case IROp::ARGUMENT:
+            // Already moved into place on entry, by emit_arguments().
+            break;
+    }
+}
+
+// --- Calls ---
+
+// Arguments go where the System V ABI wants them: the first six integers in
+// rdi, rsi, rdx, rcx, r8 and r9, the first eight floats in xmm0-xmm7, and
+// the rest in the outgoing argument area at the bottom of the frame, where
+// the callee finds them at [rsp + 8], [rsp + 16], ... after the return
+// address. rsp never moves inside the function, so it stays 16-byte aligned
+// at every call.
+//
+// The register arguments are one parallel move (see emit_parallel_move()):
+// an argument may currently live in the register another one is headed for.
+void CodeGenerator::emit_call(const IRInstruction& call) {
+    std::vector<Move> moves;
+    size_t first_param = m_params.size() - call.count;
+    size_t int_args = 0;
+    size_t float_args = 0;
+    int32_t stack_args = 0;
+    for (size_t i = m_params.size(); i-- > first_param;) { // The last PARAM is the first argument
+        const IRInstruction& param = m_params[i];
+        bool is_float = param.type == DataType::FLOAT;
+        MachineOperand value = operand(param.arg1);
+        if (is_float && float_args < std::size(FLOAT_ARGUMENT_REGISTERS)) {
+            moves.push_back({xmm(FLOAT_ARGUMENT_REGISTERS[float_args++]), value, true});
+        } else if (!is_float && int_args < std::size(INTEGER_ARGUMENT_REGISTERS)) {
+            moves.push_back({gpr(INTEGER_ARGUMENT_REGISTERS[int_args++]), value, false});
+        } else {
+            // Stack arguments are stored first, while rax is still free.
+            MachineOperand slot = MachineOperand::memory(Register::RSP, 8 * stack_args++);
+            if (is_float) {
+                emit_float_move(slot, value);
+            } else {
+                emit_move(slot, value);
             }
         }
     }
-    if (m_current_stack_offset != 0) {
-        m_output_file << "    sub rsp, " << -m_current_stack_offset << "\n\n";
+    m_params.resize(first_param);
+
+    // A computed callee, e.g. f(x)(y), is called through rax, which no
+    // argument uses.
+    const MachineOperand rax = gpr(Register::RAX);
+    if (call.arg1.kind() != IROperand::SYMBOL) {
+        moves.push_back({rax, operand(call.arg1), false});
     }
+    emit_parallel_move(moves);
 
-    // --- Second Pass: Translate IR instructions to Assembly ---
-    std::map<std::string, std::string> temp_registers;
+    if (call.arg1.kind() == IROperand::SYMBOL) {
+        emit(MachineOp::CALL, MachineOperand::symbol(call.arg1.index()));
+    } else {
+        emit(MachineOp::CALL, rax);
+    }
 
-    for (const auto& instr : program.instructions) {
-        switch (instr.op) {
-            case TokenType::PLUS:
-            case TokenType::MINUS:
-            case TokenType::STAR:
-            case TokenType::SLASH: {
-                std::string left_asm = get_operand_asm(instr.arg1, m_stack_offsets, temp_registers);
-                std::string right_asm = get_operand_asm(instr.arg2, m_stack_offsets, temp_registers);
-                
-                m_output_file << "    mov rax, " << left_asm << "\n";
-                m_output_file << "    mov rbx, " << right_asm << "\n";
+    // The return value is in rax (xmm0 for a float). Values that live
+    // across the call were allocated callee-saved registers or stack
+    // slots, so nothing is clobbered.
+    if (call.type == DataType::FLOAT) {
+        emit_float_move(operand(call.result), xmm(Register::XMM0));
+    } else {
+        emit(MachineOp::MOV, operand(call.result), rax);
+    }
+}
 
-                if (instr.op == TokenType::PLUS)  m_output_file << "    add rax, rbx\n";
-                if (instr.op == TokenType::MINUS) m_output_file << "    sub rax, rbx\n";
-                if (instr.op == TokenType::STAR)  m_output_file << "    imul rax, rbx\n";
-                if (instr.op == TokenType::SLASH) {
-                    m_output_file << "    xor rdx, rdx\n";
-                    m_output_file << "    idiv rbx\n";
+// Performs all of `moves` as if at once. Moves whose destination nobody
+// still needs go first; what remains are cycles, broken by parking one
+// destination's value in a scratch register (r11 or xmm15). Only registers
+// may be both a destination and a value.
+void CodeGenerator::emit_parallel_move(std::vector<Move>& moves) {
+    // Whether a move other than moves[except] still needs `reg`'s value.
+    auto is_read = [&](const MachineOperand& reg, size_t except) {
+        for (size_t i = 0; i < moves.size(); ++i) {
+            if (i != except && moves[i].value == reg) return true;
+        }
+        return false;
+    };
+    while (!moves.empty()) {
+        bool progress = false;
+        for (size_t i = 0; i < moves.size(); ++i) {
+            const Move move = moves[i];
+            if (move.dest != move.value) {
+                if (is_read(move.dest, i)) continue;
+                if (move.is_float) {
+                    emit_float_move(move.dest, move.value);
+                } else {
+                    emit_move(move.dest, move.value);
                 }
-                
-                temp_registers[std::get<std::string>(instr.result)] = "rax";
-                break;
             }
-            case TokenType::EQUALS: {
-                std::string dest_asm = get_operand_asm(instr.result, m_stack_offsets, temp_registers);
-                std::string source_asm = get_operand_asm(instr.arg1, m_stack_offsets, temp_registers);
+            moves.erase(moves.begin() + i);
+            progress = true;
+            break;
+        }
+        if (progress) continue;
 
-                m_output_file << "    mov rax, " << source_asm << "\n";
-                m_output_file << "    mov " << dest_asm << ", rax\n";
-                break;
+        MachineOperand blocked = moves.front().dest;
+        MachineOperand scratch = moves.front().is_float ? xmm(Register::XMM15) : gpr(Register::R11);
+        emit(moves.front().is_float ? MachineOp::MOVSD : MachineOp::MOV, scratch, blocked);
+        for (Move& move : moves) {
+            if (move.value == blocked) move.value = scratch;
+        }
+    }
+}
+
+// A function's parameters arrive where a call puts its arguments (see
+// emit_call()): in registers, or above the return address for the ones
+// that don't fit. On entry, the ARGUMENTs at the start of the entry block
+// take them from there into their allocated locations, as one parallel move.
+// `pushed` is the number of bytes between the frame and the arguments on
+// the stack, including the return address.
+void CodeGenerator::emit_arguments(const IRBlock& entry, int64_t pushed) {
+    std::vector<MachineOperand> arrives_in;
+    size_t int_args = 0;
+    size_t float_args = 0;
+    int32_t stack_args = 0;
+    for (DataType type : m_program->parameters) {
+        if (type == DataType::FLOAT && float_args < std::size(FLOAT_ARGUMENT_REGISTERS)) {
+            arrives_in.push_back(xmm(FLOAT_ARGUMENT_REGISTERS[float_args++]));
+        } else if (type != DataType::FLOAT && int_args < std::size(INTEGER_ARGUMENT_REGISTERS)) {
+            arrives_in.push_back(gpr(INTEGER_ARGUMENT_REGISTERS[int_args++]));
+        } else if (m_options.omit_frame_pointer) {
+            arrives_in.push_back(MachineOperand::memory(Register::RSP, (int32_t)(m_frame_size + pushed) + 8 * stack_args++));
+        } else {
+            arrives_in.push_back(MachineOperand::memory(Register::RBP, 16 + 8 * stack_args++));
+        }
+    }
+
+    std::vector<Move> moves;
+    for (const IRInstruction& instr : entry.instructions) {
+        if (instr.op != IROp::ARGUMENT) break;
+        moves.push_back({operand(instr.result), arrives_in[instr.count], instr.type == DataType::FLOAT});
+    }
+    emit_parallel_move(moves);
+}
+
+// --- Floating point ---
+
+static MachineOp sse_op(IROp op) {
+    switch (op) {
+        case IROp::ADD: return MachineOp::ADDSD;
+        case IROp::SUB: return MachineOp::SUBSD;
+        case IROp::MUL: return MachineOp::MULSD;
+        default:        return MachineOp::DIVSD;
+    }
+}
+
+// result = lhs <op> rhs on doubles. Like the integer instructions these are
+// two-address, but the destination must be an xmm register, so a result in
+// a stack slot is computed in the scratch register xmm15.
+void CodeGenerator::emit_float_binary(IROp ir_op, IROperand result, IROperand lhs, IROperand rhs) {
+    MachineOp op = sse_op(ir_op);
+    MachineOperand dest = operand(result);
+    MachineOperand left = operand(lhs);
+    MachineOperand right = operand(rhs);
+    bool commutative = op == MachineOp::ADDSD || op == MachineOp::MULSD;
+    if (commutative && dest == right && dest != left) {
+        std::swap(left, right);
+    }
+
+    if (dest.is_xmm_register() && dest == left) {
+        emit(op, dest, right);
+        return;
+    }
+    MachineOperand work = dest.is_xmm_register() && dest != right ? dest : xmm(Register::XMM15);
+    emit_float_move(work, left);
+    emit(op, work, right);
+    emit_float_move(dest, work);
+}
+
+// ucomisd sets the flags like an unsigned comparison, and reports a NaN
+// operand as "unordered": ZF, PF and CF all set. So a < b is tested as
+// b > a ("above", false when unordered), and == and != also check PF.
+void CodeGenerator::emit_float_compare(IROp op, IROperand result, IROperand lhs, IROperand rhs) {
+    const MachineOperand rax = gpr(Register::RAX);
+    const MachineOperand r11 = gpr(Register::R11);
+    MachineOperand dest = operand(result);
+    MachineOperand left = operand(lhs);
+    MachineOperand right = operand(rhs);
+    Condition condition = Condition::EQ;
+    switch (op) {
+        case IROp::CMP_LT: condition = Condition::A;  std::swap(left, right); break;
+        case IROp::CMP_LE: condition = Condition::AE; std::swap(left, right); break;
+        case IROp::CMP_GT: condition = Condition::A;  break;
+        case IROp::CMP_GE: condition = Condition::AE; break;
+        case IROp::CMP_NE: condition = Condition::NE; break;
+        default:           break;
+    }
+    if (!left.is_xmm_register()) {
+        emit_float_move(xmm(Register::XMM15), left);
+        left = xmm(Register::XMM15);
+    }
+
+    if (op == IROp::CMP_EQ || op == IROp::CMP_NE) {
+        // Equal and ordered, or not equal or unordered.
+        emit(MachineOp::XOR, rax, rax);
+        emit(MachineOp::XOR, r11, r11);
+        emit(MachineOp::UCOMISD, left, right);
+        emit_conditional(MachineOp::SETCC, condition, rax);
+        emit_conditional(MachineOp::SETCC, op == IROp::CMP_EQ ? Condition::NP : Condition::P, r11);
+        emit(op == IROp::CMP_EQ ? MachineOp::AND : MachineOp::OR, rax, r11);
+        emit(MachineOp::MOV, dest, rax);
+        return;
+    }
+
+    // The operands are xmm registers or memory, so an integer result
+    // register can be zeroed first and set directly.
+    if (dest.kind == MachineOperand::REGISTER) {
+        emit(MachineOp::XOR, dest, dest);
+        emit(MachineOp::UCOMISD, left, right);
+        emit_conditional(MachineOp::SETCC, condition, dest);
+    } else {
+        emit(MachineOp::UCOMISD, left, right);
+        emit_conditional(MachineOp::SETCC, condition, rax);
+        emit(MachineOp::MOVZX, rax, rax);
+        emit(MachineOp::MOV, dest, rax);
+    }
+}
+
+// Conversions between int and double. A double is truncated toward zero,
+// and one out of range becomes INT64_MIN, as constant folding assumes.
+void CodeGenerator::emit_cast(const IRInstruction& instr) {
+    DataType from = type_of(instr.arg1);
+    if (from == instr.type) {
+        emit_move(instr.result, instr.arg1, instr.type);
+        return;
+    }
+    MachineOperand dest = operand(instr.result);
+    MachineOperand value = operand(instr.arg1);
+
+    if (instr.type == DataType::FLOAT) {
+        if (value.kind == MachineOperand::IMMEDIATE) { // cvtsi2sd takes no immediate
+            emit(MachineOp::MOV, gpr(Register::R11), value);
+            value = gpr(Register::R11);
+        }
+        // cvtsi2sd only writes the low half of its destination; zeroing it
+        // first means it doesn't have to wait for whatever was there.
+        MachineOperand work = dest.is_xmm_register() ? dest : xmm(Register::XMM15);
+        emit(MachineOp::XORPD, work, work);
+        emit(MachineOp::CVTSI2SD, work, value);
+        emit_float_move(dest, work);
+    } else {
+        MachineOperand work = dest.kind == MachineOperand::REGISTER ? dest : gpr(Register::RAX);
+        emit(MachineOp::CVTTSD2SI, work, value);
+        if (work != dest) emit(MachineOp::MOV, dest, work);
+    }
+}
+
+// --- FMA contraction ---
+
+void CodeGenerator::countUses() {
+    m_use_counts.assign(m_program->temp_count, 0);
+    auto count = [&](IROperand operand) {
+        if (operand.kind() == IROperand::TEMP) ++m_use_counts[operand.index()];
+    };
+    for (const IRBlock& block : m_program->blocks) {
+        for (const IRInstruction& instr : block.instructions) {
+            count(instr.arg1);
+            count(instr.arg2);
+        }
+        count(block.terminator.value);
+    }
+}
+
+// A float multiplication whose only use is an addition or subtraction right
+// after it can be done as one fused multiply-add. The result is rounded
+// once instead of twice, so it may differ in the last bit.
+bool CodeGenerator::can_fuse(const IRInstruction& multiply, const IRInstruction& add) const {
+    if (!m_options.use_fma || multiply.op != IROp::MUL || multiply.type != DataType::FLOAT) return false;
+    if ((add.op != IROp::ADD && add.op != IROp::SUB) || add.type != DataType::FLOAT) return false;
+    if (multiply.result.kind() != IROperand::TEMP || m_use_counts[multiply.result.index()] != 1) return false;
+    return (add.arg1 == multiply.result) != (add.arg2 == multiply.result);
+}
+
+void CodeGenerator::emit_fused_multiply_add(const IRInstruction& multiply, const IRInstruction& add) {
+    // a * b + c, a * b - c or c - a * b
+    bool product_first = add.arg1 == multiply.result;
+    IROperand addend = product_first ? add.arg2 : add.arg1;
+    MachineOp op = add.op == IROp::ADD ? MachineOp::VFMADD231SD
+                 : product_first       ? MachineOp::VFMSUB231SD
+                                       : MachineOp::VFNMADD231SD;
+
+    MachineOperand dest = operand(add.result);
+    MachineOperand factor1 = operand(multiply.arg1);
+    MachineOperand factor2 = operand(multiply.arg2);
+    if (!factor1.is_xmm_register()) std::swap(factor1, factor2);
+    if (!factor1.is_xmm_register()) {
+        emit_float_move(xmm(Register::XMM14), factor1);
+        factor1 = xmm(Register::XMM14);
+    }
+
+    // The accumulator starts as the addend, so it can't be where a factor is.
+    MachineOperand work = dest.is_xmm_register() && dest != factor1 && dest != factor2 ? dest : xmm(Register::XMM15);
+    emit_float_move(work, operand(addend));
+    m_code.instructions.push_back({op, Condition::EQ, work, factor1, factor2});
+    emit_float_move(dest, work);
+}
+
+void CodeGenerator::emit_terminator(BlockIndex block, const IRTerminator& terminator) {
+    BlockIndex next = block + 1;
+    switch (terminator.kind) {
+        case IRTerminator::JUMP:
+            if (terminator.targets[0] != next) {
+                emit(MachineOp::JMP, MachineOperand::label(terminator.targets[0]));
             }
-            case TokenType::PARAM: {
-                std::string param_asm = get_operand_asm(instr.arg1, m_stack_offsets, temp_registers);
-                m_output_file << "    mov rax, " << param_asm << "\n";
-                m_output_file << "    push rax\n";
-                break;
+            break;
+        case IRTerminator::BRANCH: {
+            MachineOperand value = operand(terminator.value);
+            if (value.kind == MachineOperand::IMMEDIATE) {
+                emit(MachineOp::MOV, gpr(Register::RAX), value);
+                emit(MachineOp::TEST, gpr(Register::RAX), gpr(Register::RAX));
+            } else if (value.kind == MachineOperand::MEMORY) {
+                emit(MachineOp::CMP, value, MachineOperand::immediate(0));
+            } else {
+                emit(MachineOp::TEST, value, value);
+            }
+            BlockIndex if_true = terminator.targets[0];
+            BlockIndex if_false = terminator.targets[1];
+            if (if_true == next) {
+                emit_conditional(MachineOp::JCC, Condition::EQ, MachineOperand::label(if_false));
+            } else {
+                emit_conditional(MachineOp::JCC, Condition::NE, MachineOperand::label(if_true));
+                if (if_false != next) emit(MachineOp::JMP, MachineOperand::label(if_false));
+            }
+            break;
+        }
+        case IRTerminator::RETURN: {
+            // Exit the program with the returned value as exit code, or
+            // return it from a callable entry. A function returns a float
+            // in xmm0; the program's result is always an int.
+            MachineOperand result = gpr(m_callable ? Register::RAX : Register::RDI);
+            if (!m_program->name.empty() && type_of(terminator.value) == DataType::FLOAT) {
+                emit_float_move(xmm(Register::XMM0), operand(terminator.value));
+            } else if (type_of(terminator.value) == DataType::FLOAT) {
+                emit(MachineOp::CVTTSD2SI, result, operand(terminator.value));
+            } else if (terminator.value.kind() != IROperand::NONE) {
+                emit(MachineOp::MOV, result, operand(terminator.value));
+            } else {
+                emit(MachineOp::XOR, result, result); // No variables, exit with 0
             }
-            case TokenType::CALL: {
-                std::string callee_name = std::get<std::string>(instr.arg1);
-                int num_args = std::get<int>(instr.arg2);
-
-                // NEW: Pop arguments from the stack into the correct registers
-                // according to the x86-64 System V ABI.
-                // Note: We pushed them in reverse, so we pop them in order.
-                if (num_args > 0) {
-                    m_output_file << "    pop rdi\n"; // First argument goes into RDI
+            if (m_callable) {
+                if (m_frame_size != 0) {
+                    emit(MachineOp::ADD, gpr(Register::RSP), MachineOperand::immediate(m_frame_size));
                 }
-                if (num_args > 1) {
-                    m_output_file << "    pop rsi\n"; // Second argument goes into RSI
+                for (auto reg = m_saved_registers.rbegin(); reg != m_saved_registers.rend(); ++reg) {
+                    emit(MachineOp::POP, gpr(*reg));
                 }
-                // (A more complete implementation would handle rdx, rcx, r8, r9 here)
-
-                m_output_file << "    call " << callee_name << "\n";
-                
-                // The stack cleanup `add rsp, ...` is NO LONGER NEEDED,
-                // because we already cleaned it up with the pop instructions.
-                
-                // The return value is in rax. Map the result temporary to "rax".
-                temp_registers[std::get<std::string>(instr.result)] = "rax";
+                if (!m_options.omit_frame_pointer) emit(MachineOp::POP, gpr(Register::RBP));
+                emit(MachineOp::RET);
                 break;
             }
-            case TokenType::CAST: {
-                std::string source_asm = get_operand_asm(instr.arg1, m_stack_offsets, temp_registers);
-                m_output_file << "    mov rax, " << source_asm << "\n";
-                temp_registers[std::get<std::string>(instr.result)] = "rax";
-                break;
+            if (!m_options.omit_frame_pointer) {
+                emit(MachineOp::MOV, gpr(Register::RSP), gpr(Register::RBP));
+                emit(MachineOp::POP, gpr(Register::RBP));
             }
-            default:
-                break;
+            emit(MachineOp::MOV, gpr(Register::RAX), MachineOperand::immediate(60));
+            emit(MachineOp::SYSCALL);
+            break;
         }
-        m_output_file << "\n";
-    }
-
-    // --- Boilerplate Assembly Footer ---
-    m_output_file << "    ; Exit program with the value of the last variable as exit code\n";
-    if (!m_stack_offsets.empty()) {
-         m_output_file << "    mov rdi, [rbp" << m_current_stack_offset << "]\n";
-    } else {
-         m_output_file << "    xor rdi, rdi\n"; // No variables, exit with 0
+        case IRTerminator::NONE:
+            throw std::runtime_error("Code Generation Error: unterminated block.");
     }
-    m_output_file << "    mov rsp, rbp\n";
-    m_output_file << "    pop rbp\n";
-    m_output_file << "    mov rax, 60\n";
-    m_output_file << "    syscall\n";
 }
-
-void CodeGenerator::allocate_variable(const std::string& var_name) {
-    // Correct logic: decrement first, then assign.
-    m_current_stack_offset -= 8;
-    m_stack_offsets[var_name] = m_current_stack_offset;
-    m_output_file << "    ; Allocating " << var_name << " at [rbp" << m_current_stack_offset << "]\n";
-}
\ No newline at end of file
@@ -1,23 +1,103 @@
 #pragma once
 
 #include "IR.h"
+#include "MachineCode.h"
+#include "RegisterAllocator.h"
+#include <cstdint>
 #include <string>
-#include <fstream>
-#include <map>
+#include <unordered_map>
+#include <vector>
+
+struct CodeGenOptions {
+    // A float multiplication feeding an addition becomes one FMA3
+    // instruction (vfmadd231sd and friends), which the target CPU must support.
+    bool use_fma = false;
+    // Address the stack frame from rsp and leave rbp alone, instead of
+    // building an rbp frame (which debuggers and profilers can walk).
+    bool omit_frame_pointer = true;
+    // Compile the program as a function `int64_t f()` that follows the
+    // System V ABI: it saves the callee-saved registers it uses and returns
+    // the result in rax, instead of being a _start that exits with it. The
+    // JIT calls the code this way. Function definitions are always compiled
+    // like this.
+    bool callable = false;
+};
 
 class CodeGenerator {
 public:
-    // The constructor will open the output file.
-    CodeGenerator(const std::string& output_filename);
+    explicit CodeGenerator(const CodeGenOptions& options = {}) : m_options(options) {}
+
+    // The main method to generate machine code from the IR. The program
+    // must be out of SSA form (see lower_out_of_ssa()), and `allocation` must
+    // come from allocate_registers() on it. A function definition (one with
+    // a name) becomes a System V function taking its ARGUMENTs; its calls of
+    // other functions are resolved by link_machine_code().
+    void generate(const IRProgram& program, const RegisterAllocation& allocation);
 
-    // The main method to generate the assembly code from the IR.
-    void generate(const IRProgram& program);
+    // The instructions generate() produced, for passes that rewrite them
+    // and for write_nasm() and write_elf_object().
+    MachineCode& code() { return m_code; }
 
 private:
-    std::ofstream m_output_file;
-    std::map<std::string, int> m_stack_offsets; // Maps variable names to stack offsets
-    int m_current_stack_offset = 0;
+    MachineCode m_code;
+    const IRProgram* m_program = nullptr;
+    const RegisterAllocation* m_allocation = nullptr;
+    CodeGenOptions m_options;
+    bool m_callable = false;       // Returns to its caller rather than exiting
+    uint32_t m_outgoing_slots = 0; // Stack arguments of the largest call, at the bottom of the frame
+    int64_t m_frame_size = 0;      // Below the saved registers
+    std::vector<Register> m_saved_registers; // Callee-saved registers pushed by a callable entry
+
+    std::unordered_map<uint64_t, uint32_t> m_literal_indices; // Float bits -> index in m_code.literals
+    std::vector<IRInstruction> m_params;    // PARAMs waiting for their CALL, last argument first
+    std::vector<uint32_t> m_use_counts;     // Reads of each temporary (only with use_fma)
+
+    // The machine operand for an IR operand: an immediate, a register, a
+    // stack slot or a float in the literal pool.
+    MachineOperand operand(IROperand ir_operand);
+    MachineOperand stack_slot(uint32_t slot) const;
+    uint32_t literal(double value);
+    DataType type_of(IROperand ir_operand) const;
+
+    // Like operand(), but a constant that doesn't fit in a sign-extended
+    // 32-bit immediate is first loaded into the scratch register r11.
+    MachineOperand source(IROperand ir_operand);
+    MachineOperand source(MachineOperand operand);
+
+    // Whether `ir_operand` is a constant, and if so its value.
+    bool constant_value(IROperand ir_operand, int64_t& value) const;
+
+    void emit(MachineOp op, MachineOperand dst = {}, MachineOperand src = {});
+    void emit_conditional(MachineOp op, Condition condition, MachineOperand dst); // SETCC or JCC
+    void emit_move(IROperand dest, IROperand value, DataType type = DataType::INT);
+    void emit_move(MachineOperand dest, MachineOperand value);
+    void emit_float_move(MachineOperand dest, MachineOperand value);
+    void emit_instruction(const IRInstruction& instr);
+    void emit_call(const IRInstruction& call);
+    void emit_arguments(const IRBlock& entry, int64_t pushed);
+
+    // One move of a parallel move, e.g. the arguments of a call.
+    struct Move {
+        MachineOperand dest;
+        MachineOperand value;
+        bool is_float;
+    };
+    void emit_parallel_move(std::vector<Move>& moves);
+
+    // Instruction selection for each arithmetic operation.
+    void emit_binary(MachineOp op, IROperand result, IROperand lhs, IROperand rhs);
+    void emit_negate(IROperand result, IROperand value);
+    void emit_add(IROperand result, IROperand lhs, IROperand rhs);
+    void emit_subtract(IROperand result, IROperand lhs, IROperand rhs);
+    void emit_multiply(IROperand result, IROperand lhs, IROperand rhs);
+    void emit_divide(IROperand result, IROperand lhs, IROperand rhs);
+    void emit_compare(IROp op, IROperand result, IROperand lhs, IROperand rhs);
+    void emit_float_binary(IROp op, IROperand result, IROperand lhs, IROperand rhs);
+    void emit_float_compare(IROp op, IROperand result, IROperand lhs, IROperand rhs);
+    void emit_cast(const IRInstruction& instr);
 
-    // Helper to allocate space for a variable on the stack.
-    void allocate_variable(const std::string& var_name);
-};
\ No newline at end of file
+    void countUses();
+    bool can_fuse(const IRInstruction& multiply, const IRInstruction& add) const;
+    void emit_fused_multiply_add(const IRInstruction& multiply, const IRInstruction& add);
+    void emit_terminator(BlockIndex block, const IRTerminator& terminator);
+};
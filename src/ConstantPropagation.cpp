@@ -0,0 +1,344 @@
+#include "Optimizer.h"
+#include "SSA.h"
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// --- Folding ---
+
+uint64_t bits_of(const IRConstant& constant) {
+    uint64_t bits;
+    std::memcpy(&bits, &constant.int_value, sizeof(bits)); // Either member
+    return bits;
+}
+
+bool same_constant(const IRConstant& a, const IRConstant& b) {
+    return a.type == b.type && bits_of(a) == bits_of(b);
+}
+
+IRConstant make_int(long long value) {
+    IRConstant constant{DataType::INT, {}};
+    constant.int_value = value;
+    return constant;
+}
+
+IRConstant make_float(double value) {
+    IRConstant constant{DataType::FLOAT, {}};
+    constant.float_value = value;
+    return constant;
+}
+
+double as_float(const IRConstant& constant) {
+    return constant.type == DataType::FLOAT ? constant.float_value : (double)constant.int_value;
+}
+
+long long as_int(const IRConstant& constant) {
+    return constant.type == DataType::FLOAT ? truncate_to_int(constant.float_value) : constant.int_value;
+}
+
+bool is_true(const IRConstant& constant) {
+    return constant.type == DataType::FLOAT ? constant.float_value != 0.0 : constant.int_value != 0;
+}
+
+bool is_comparison(IROp op) {
+    return op >= IROp::CMP_EQ && op <= IROp::CMP_GE;
+}
+
+template <typename T>
+bool compare(IROp op, T a, T b) {
+    switch (op) {
+        case IROp::CMP_EQ: return a == b;
+        case IROp::CMP_NE: return a != b;
+        case IROp::CMP_LT: return a < b;
+        case IROp::CMP_LE: return a <= b;
+        case IROp::CMP_GT: return a > b;
+        default:           return a >= b;
+    }
+}
+
+// Computes `instr` on constant operands. Returns false if the result must be
+// left to run time.
+bool fold(const IRInstruction& instr, const IRConstant& a, const IRConstant& b, IRConstant& result) {
+    switch (instr.op) {
+        case IROp::COPY:
+            result = a;
+            return true;
+        case IROp::CAST:
+            result = instr.type == DataType::FLOAT ? make_float(as_float(a)) : make_int(as_int(a));
+            return true;
+        case IROp::ADD:
+        case IROp::SUB:
+        case IROp::MUL:
+        case IROp::DIV:
+            if (instr.type == DataType::FLOAT) {
+                double x = as_float(a), y = as_float(b);
+                double value = instr.op == IROp::ADD ? x + y
+                             : instr.op == IROp::SUB ? x - y
+                             : instr.op == IROp::MUL ? x * y
+                                                     : x / y;
+                result = make_float(value);
+            } else {
+                // Unsigned arithmetic wraps around like the hardware does.
+                uint64_t x = (uint64_t)as_int(a), y = (uint64_t)as_int(b);
+                if (instr.op == IROp::DIV) {
+                    if (y == 0 || ((long long)x == INT64_MIN && (long long)y == -1)) return false; // Traps
+                    result = make_int((long long)x / (long long)y);
+                } else {
+                    uint64_t value = instr.op == IROp::ADD ? x + y : instr.op == IROp::SUB ? x - y : x * y;
+                    result = make_int((long long)value);
+                }
+            }
+            return true;
+        default:
+            if (!is_comparison(instr.op)) return false; // PARAM, CALL
+            if (a.type == DataType::FLOAT || b.type == DataType::FLOAT) {
+                result = make_int(compare(instr.op, as_float(a), as_float(b)));
+            } else {
+                result = make_int(compare(instr.op, a.int_value, b.int_value));
+            }
+            return true;
+    }
+}
+
+// --- The lattice ---
+
+// What is known about a temporary: nothing yet (its definition hasn't been
+// reached), a single constant, or that it varies at run time.
+struct LatticeValue {
+    enum State : uint8_t { UNDEFINED, CONSTANT, VARYING };
+    State state = UNDEFINED;
+    IRConstant constant{DataType::INT, {}};
+};
+
+const LatticeValue VARYING_VALUE{LatticeValue::VARYING, {DataType::INT, {}}};
+
+void meet(LatticeValue& into, const LatticeValue& other) {
+    if (other.state == LatticeValue::UNDEFINED || into.state == LatticeValue::VARYING) return;
+    if (into.state == LatticeValue::UNDEFINED) {
+        into = other;
+    } else if (other.state == LatticeValue::VARYING || !same_constant(into.constant, other.constant)) {
+        into = VARYING_VALUE;
+    }
+}
+
+class ConstantPropagation {
+public:
+    explicit ConstantPropagation(IRProgram& program)
+        : m_program(program),
+          m_chains(program),
+          m_values(program.temp_count),
+          m_block_executable(program.blocks.size(), 0),
+          m_edge_base(program.blocks.size() + 1, 0) {
+        for (BlockIndex b = 0; b < program.blocks.size(); ++b) {
+            m_edge_base[b + 1] = m_edge_base[b] + (uint32_t)program.blocks[b].predecessors.size();
+        }
+        m_edge_executable.assign(m_edge_base.back(), 0);
+    }
+
+    void run(OptimizationStats& stats) {
+        if (m_program.blocks.empty()) return;
+        analyze();
+        rewrite(stats);
+        stats.blocks_removed += remove_unreachable_blocks(m_program);
+    }
+
+private:
+    IRProgram& m_program;
+    DefUseChains m_chains;
+    std::vector<LatticeValue> m_values; // Per temporary
+    std::vector<uint8_t> m_block_executable;
+    std::vector<uint32_t> m_edge_base;      // Edges into block b are m_edge_base[b] + predecessor slot
+    std::vector<uint8_t> m_edge_executable;
+    std::vector<std::pair<BlockIndex, uint32_t>> m_edge_worklist; // Block, predecessor slot
+    std::vector<uint32_t> m_value_worklist;                       // Temporaries that changed
+
+    LatticeValue valueOf(IROperand operand) const {
+        switch (operand.kind()) {
+            case IROperand::TEMP:
+                return m_values[operand.index()];
+            case IROperand::CONSTANT:
+                return {LatticeValue::CONSTANT, m_program.constants[operand.index()]};
+            default:
+                return VARYING_VALUE;
+        }
+    }
+
+    // Values only ever move down the lattice (UNDEFINED, then CONSTANT, then
+    // VARYING); a change is propagated to the temporary's uses.
+    void setValue(IROperand result, const LatticeValue& value) {
+        LatticeValue& current = m_values[result.index()];
+        if (value.state < current.state) return;
+        if (value.state == current.state) {
+            if (value.state != LatticeValue::CONSTANT || same_constant(value.constant, current.constant)) return;
+            current = VARYING_VALUE;
+        } else {
+            current = value;
+        }
+        m_value_worklist.push_back(result.index());
+    }
+
+    void markEdges(BlockIndex from, BlockIndex to) {
+        const auto& predecessors = m_program.blocks[to].predecessors;
+        for (uint32_t slot = 0; slot < predecessors.size(); ++slot) {
+            if (predecessors[slot] == from) m_edge_worklist.push_back({to, slot});
+        }
+    }
+
+    void visitPhi(BlockIndex block, uint32_t index) {
+        const IRPhi& phi = m_program.blocks[block].phis[index];
+        LatticeValue value;
+        for (uint32_t slot = 0; slot < phi.incoming.size(); ++slot) {
+            if (m_edge_executable[m_edge_base[block] + slot]) meet(value, valueOf(phi.incoming[slot]));
+        }
+        setValue(phi.result, value);
+    }
+
+    void visitInstruction(const IRInstruction& instr) {
+        if (instr.op == IROp::PARAM) return;
+        if (instr.op == IROp::CALL || instr.op == IROp::ARGUMENT) {
+            setValue(instr.result, VARYING_VALUE);
+            return;
+        }
+
+        LatticeValue a = valueOf(instr.arg1);
+        LatticeValue b = (instr.op == IROp::COPY || instr.op == IROp::CAST) ? a : valueOf(instr.arg2);
+        if (a.state == LatticeValue::VARYING || b.state == LatticeValue::VARYING) {
+            setValue(instr.result, VARYING_VALUE);
+        } else if (a.state == LatticeValue::CONSTANT && b.state == LatticeValue::CONSTANT) {
+            LatticeValue folded{LatticeValue::CONSTANT, {DataType::INT, {}}};
+            setValue(instr.result, fold(instr, a.constant, b.constant, folded.constant) ? folded : VARYING_VALUE);
+        }
+    }
+
+    void visitTerminator(BlockIndex block) {
+        const IRTerminator& terminator = m_program.blocks[block].terminator;
+        if (terminator.kind == IRTerminator::JUMP) {
+            markEdges(block, terminator.targets[0]);
+        } else if (terminator.kind == IRTerminator::BRANCH) {
+            LatticeValue condition = valueOf(terminator.value);
+            if (condition.state == LatticeValue::CONSTANT) {
+                markEdges(block, terminator.targets[is_true(condition.constant) ? 0 : 1]);
+            } else if (condition.state == LatticeValue::VARYING) {
+                markEdges(block, terminator.targets[0]);
+                markEdges(block, terminator.targets[1]);
+            }
+        }
+    }
+
+    void visitBlock(BlockIndex block) {
+        const IRBlock& b = m_program.blocks[block];
+        for (uint32_t i = 0; i < b.phis.size(); ++i) visitPhi(block, i);
+        for (const IRInstruction& instr : b.instructions) visitInstruction(instr);
+        visitTerminator(block);
+    }
+
+    void analyze() {
+        m_block_executable[0] = 1;
+        visitBlock(0);
+
+        while (!m_edge_worklist.empty() || !m_value_worklist.empty()) {
+            while (!m_edge_worklist.empty()) {
+                auto [block, slot] = m_edge_worklist.back();
+                m_edge_worklist.pop_back();
+                if (m_edge_executable[m_edge_base[block] + slot]) continue;
+                m_edge_executable[m_edge_base[block] + slot] = 1;
+
+                if (!m_block_executable[block]) {
+                    m_block_executable[block] = 1;
+                    visitBlock(block);
+                } else {
+                    // Only the phis can see the new edge.
+                    for (uint32_t i = 0; i < m_program.blocks[block].phis.size(); ++i) visitPhi(block, i);
+                }
+            }
+            while (!m_value_worklist.empty()) {
+                uint32_t temp = m_value_worklist.back();
+                m_value_worklist.pop_back();
+                for (const IRLocation& use : m_chains.uses(temp)) {
+                    if (!m_block_executable[use.block]) continue;
+                    switch (use.where) {
+                        case IRLocation::PHI:
+                            visitPhi(use.block, use.index);
+                            break;
+                        case IRLocation::INSTRUCTION:
+                            visitInstruction(m_program.blocks[use.block].instructions[use.index]);
+                            break;
+                        case IRLocation::TERMINATOR:
+                            visitTerminator(use.block);
+                            break;
+                    }
+                }
+            }
+        }
+    }
+
+    // --- Rewriting ---
+
+    std::map<std::pair<DataType, uint64_t>, uint32_t> m_constant_indices;
+
+    IROperand internConstant(const IRConstant& constant) {
+        if (m_constant_indices.empty()) {
+            for (uint32_t i = 0; i < m_program.constants.size(); ++i) {
+                m_constant_indices.try_emplace({m_program.constants[i].type, bits_of(m_program.constants[i])}, i);
+            }
+        }
+        auto [it, inserted] = m_constant_indices.try_emplace({constant.type, bits_of(constant)},
+                                                             (uint32_t)m_program.constants.size());
+        if (inserted) m_program.constants.push_back(constant);
+        return IROperand::constant(it->second);
+    }
+
+    bool isConstant(IROperand operand) const {
+        return operand.kind() == IROperand::TEMP && m_values[operand.index()].state == LatticeValue::CONSTANT;
+    }
+
+    void substitute(IROperand& operand) {
+        if (isConstant(operand)) operand = internConstant(m_values[operand.index()].constant);
+    }
+
+    void rewrite(OptimizationStats& stats) {
+        for (BlockIndex b = 0; b < m_program.blocks.size(); ++b) {
+            IRBlock& block = m_program.blocks[b];
+
+            // Blocks that never run are removed afterwards; only their
+            // operands are updated, in case one of them is still reachable.
+            if (m_block_executable[b]) {
+                size_t before = block.phis.size() + block.instructions.size();
+                block.phis.erase(std::remove_if(block.phis.begin(), block.phis.end(),
+                                                [&](const IRPhi& phi) { return isConstant(phi.result); }),
+                                 block.phis.end());
+                block.instructions.erase(std::remove_if(block.instructions.begin(), block.instructions.end(),
+                                                        [&](const IRInstruction& instr) { return isConstant(instr.result); }),
+                                         block.instructions.end());
+                stats.constants_folded += before - block.phis.size() - block.instructions.size();
+            }
+
+            for (IRPhi& phi : block.phis) {
+                for (IROperand& incoming : phi.incoming) substitute(incoming);
+            }
+            for (IRInstruction& instr : block.instructions) {
+                substitute(instr.arg1);
+                substitute(instr.arg2);
+            }
+
+            IRTerminator& terminator = block.terminator;
+            substitute(terminator.value);
+            if (m_block_executable[b] && terminator.kind == IRTerminator::BRANCH &&
+                terminator.value.kind() == IROperand::CONSTANT) {
+                bool taken = is_true(m_program.constants[terminator.value.index()]);
+                terminator = {IRTerminator::JUMP, {}, {terminator.targets[taken ? 0 : 1], NO_BLOCK}};
+                ++stats.branches_folded;
+            }
+        }
+    }
+};
+
+} // namespace
+
+void propagate_constants(IRProgram& program, OptimizationStats& stats) {
+    ConstantPropagation(program).run(stats);
+}
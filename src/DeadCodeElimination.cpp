@@ -0,0 +1,175 @@
+#include "Optimizer.h"
+#include "SSA.h"
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// Copy propagation: `t = x` and single-operand phis make t another name for
+// x, so every use of t is pointed at x and the copy disappears.
+size_t propagate_copies(IRProgram& program) {
+    std::vector<IROperand> replacement(program.temp_count);
+    for (uint32_t t = 0; t < program.temp_count; ++t) replacement[t] = IROperand::temp(t);
+
+    size_t removed = 0;
+    for (IRBlock& block : program.blocks) {
+        for (const IRPhi& phi : block.phis) {
+            if (phi.incoming.size() == 1) replacement[phi.result.index()] = phi.incoming[0];
+        }
+        for (const IRInstruction& instr : block.instructions) {
+            if (instr.op == IROp::COPY) replacement[instr.result.index()] = instr.arg1;
+        }
+    }
+
+    // Copies of copies: follow each chain to its source. Phis can only be
+    // forwarded to dominating values, so there are no cycles.
+    auto source = [&](IROperand operand) {
+        while (operand.kind() == IROperand::TEMP && replacement[operand.index()] != operand) {
+            operand = replacement[operand.index()];
+        }
+        return operand;
+    };
+
+    auto forwarded = [&](IROperand result) { return replacement[result.index()] != result; };
+    for (IRBlock& block : program.blocks) {
+        size_t before = block.phis.size() + block.instructions.size();
+        block.phis.erase(std::remove_if(block.phis.begin(), block.phis.end(),
+                                        [&](const IRPhi& phi) { return forwarded(phi.result); }),
+                         block.phis.end());
+        block.instructions.erase(std::remove_if(block.instructions.begin(), block.instructions.end(),
+                                                [&](const IRInstruction& instr) {
+                                                    return instr.op == IROp::COPY && forwarded(instr.result);
+                                                }),
+                                 block.instructions.end());
+        removed += before - block.phis.size() - block.instructions.size();
+
+        for (IRPhi& phi : block.phis) {
+            for (IROperand& incoming : phi.incoming) incoming = source(incoming);
+        }
+        for (IRInstruction& instr : block.instructions) {
+            instr.arg1 = source(instr.arg1);
+            instr.arg2 = source(instr.arg2);
+        }
+        block.terminator.value = source(block.terminator.value);
+    }
+    return removed;
+}
+
+// True for an integer division that may trap at run time: by zero, or of
+// the most negative integer by -1. Only a constant divisor rules that out.
+bool may_trap(const IRProgram& program, const IRInstruction& instr) {
+    if (instr.op != IROp::DIV || instr.type != DataType::INT) return false;
+    if (instr.arg2.kind() != IROperand::CONSTANT) return true;
+    long long divisor = program.constants[instr.arg2.index()].int_value;
+    return divisor == 0 || divisor == -1;
+}
+
+// Mark and sweep: calls (with their PARAMs), divisions that may trap and
+// terminators are live, and so is everything a live instruction or phi
+// reads. The rest is deleted.
+size_t remove_dead_code(IRProgram& program) {
+    DefUseChains chains(program);
+    std::vector<uint8_t> live(program.temp_count, 0);
+    std::vector<uint32_t> worklist;
+
+    auto markLive = [&](IROperand operand) {
+        if (operand.kind() == IROperand::TEMP && !live[operand.index()]) {
+            live[operand.index()] = 1;
+            worklist.push_back(operand.index());
+        }
+    };
+
+    for (const IRBlock& block : program.blocks) {
+        for (const IRInstruction& instr : block.instructions) {
+            if (instr.op == IROp::CALL || instr.op == IROp::PARAM) {
+                markLive(instr.result);
+                markLive(instr.arg1);
+            } else if (may_trap(program, instr)) {
+                markLive(instr.result);
+            }
+        }
+        markLive(block.terminator.value);
+    }
+
+    while (!worklist.empty()) {
+        uint32_t temp = worklist.back();
+        worklist.pop_back();
+        if (!chains.defined(temp)) continue;
+
+        const IRLocation& def = chains.definition(temp);
+        const IRBlock& block = program.blocks[def.block];
+        if (def.where == IRLocation::PHI) {
+            for (IROperand incoming : block.phis[def.index].incoming) markLive(incoming);
+        } else {
+            const IRInstruction& instr = block.instructions[def.index];
+            markLive(instr.arg1);
+            markLive(instr.arg2);
+        }
+    }
+
+    size_t removed = 0;
+    auto dead = [&](IROperand result) { return result.kind() == IROperand::TEMP && !live[result.index()]; };
+    for (IRBlock& block : program.blocks) {
+        size_t before = block.phis.size() + block.instructions.size();
+        block.phis.erase(std::remove_if(block.phis.begin(), block.phis.end(),
+                                        [&](const IRPhi& phi) { return dead(phi.result); }),
+                         block.phis.end());
+        block.instructions.erase(std::remove_if(block.instructions.begin(), block.instructions.end(),
+                                                [&](const IRInstruction& instr) { return dead(instr.result); }),
+                                 block.instructions.end());
+        removed += before - block.phis.size() - block.instructions.size();
+    }
+    return removed;
+}
+
+// Appends a block to its only predecessor when that predecessor simply
+// jumps to it, which undoes the chains of blocks left behind once branches
+// are folded. A branch whose two targets are the same block becomes a jump.
+size_t merge_blocks(IRProgram& program) {
+    size_t merged = 0;
+    for (BlockIndex b = 0; b < program.blocks.size(); ++b) {
+        IRTerminator& terminator = program.blocks[b].terminator;
+        if (terminator.kind == IRTerminator::BRANCH && terminator.targets[0] == terminator.targets[1]) {
+            // Both edges come from the same block, so they carry the same
+            // phi operands; drop one of them.
+            IRBlock& target = program.blocks[terminator.targets[0]];
+            size_t slot = std::find(target.predecessors.begin(), target.predecessors.end(), b) -
+                          target.predecessors.begin();
+            target.predecessors.erase(target.predecessors.begin() + slot);
+            for (IRPhi& phi : target.phis) phi.incoming.erase(phi.incoming.begin() + slot);
+            terminator = {IRTerminator::JUMP, {}, {terminator.targets[0], NO_BLOCK}};
+        }
+
+        while (true) {
+            IRBlock& block = program.blocks[b];
+            if (block.terminator.kind != IRTerminator::JUMP) break;
+            BlockIndex next = block.terminator.targets[0];
+            IRBlock& successor = program.blocks[next];
+            if (next == b || next == 0 || successor.predecessors.size() != 1 || !successor.phis.empty()) break;
+
+            block.instructions.insert(block.instructions.end(), successor.instructions.begin(),
+                                      successor.instructions.end());
+            block.terminator = successor.terminator;
+            for (uint32_t k = 0; k < block.terminator.successor_count(); ++k) {
+                for (BlockIndex& pred : program.blocks[block.terminator.targets[k]].predecessors) {
+                    if (pred == next) pred = b;
+                }
+            }
+            successor.instructions.clear();
+            successor.predecessors.clear();
+            successor.terminator = {IRTerminator::RETURN, {}, {NO_BLOCK, NO_BLOCK}}; // Unreachable now
+            ++merged;
+        }
+    }
+    return merged;
+}
+
+} // namespace
+
+void eliminate_dead_code(IRProgram& program, OptimizationStats& stats) {
+    stats.copies_propagated += propagate_copies(program);
+    stats.dead_eliminated += remove_dead_code(program);
+    stats.blocks_merged += merge_blocks(program);
+    stats.blocks_removed += remove_unreachable_blocks(program);
+}
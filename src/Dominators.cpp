@@ -0,0 +1,101 @@
+#include "Dominators.h"
+#include <algorithm>
+#include <utility>
+
+DominatorTree::DominatorTree(const IRProgram& program)
+    : m_idom(program.blocks.size(), NO_BLOCK),
+      m_rpo_number(program.blocks.size(), UNREACHED),
+      m_children(program.blocks.size()),
+      m_enter(program.blocks.size(), 0),
+      m_exit(program.blocks.size(), 0) {
+    if (program.blocks.empty()) return;
+    computeReversePostorder(program);
+    computeImmediateDominators(program);
+    numberTree();
+}
+
+// Depth-first search over successors with an explicit stack.
+void DominatorTree::computeReversePostorder(const IRProgram& program) {
+    std::vector<uint8_t> visited(program.blocks.size(), 0);
+    std::vector<std::pair<BlockIndex, uint32_t>> stack; // Block, next successor to visit
+    std::vector<BlockIndex> postorder;
+
+    stack.push_back({0, 0});
+    visited[0] = 1;
+    while (!stack.empty()) {
+        auto& [block, next] = stack.back();
+        const IRTerminator& terminator = program.blocks[block].terminator;
+        if (next < terminator.successor_count()) {
+            BlockIndex successor = terminator.targets[next++];
+            if (successor < program.blocks.size() && !visited[successor]) {
+                visited[successor] = 1;
+                stack.push_back({successor, 0});
+            }
+        } else {
+            postorder.push_back(block);
+            stack.pop_back();
+        }
+    }
+
+    m_reverse_postorder.assign(postorder.rbegin(), postorder.rend());
+    for (uint32_t i = 0; i < m_reverse_postorder.size(); ++i) {
+        m_rpo_number[m_reverse_postorder[i]] = i;
+    }
+}
+
+// Iterates idom(b) = intersection of the dominators of b's processed
+// predecessors until nothing changes. Blocks are visited in reverse
+// postorder, so an acyclic CFG (all we generate today) settles in one pass.
+void DominatorTree::computeImmediateDominators(const IRProgram& program) {
+    // Walks both fingers up the partially built tree until they meet.
+    auto intersect = [&](BlockIndex a, BlockIndex b) {
+        while (a != b) {
+            while (m_rpo_number[a] > m_rpo_number[b]) a = m_idom[a];
+            while (m_rpo_number[b] > m_rpo_number[a]) b = m_idom[b];
+        }
+        return a;
+    };
+
+    m_idom[0] = 0; // Temporarily, so intersect() stops at the entry
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t i = 1; i < m_reverse_postorder.size(); ++i) {
+            BlockIndex block = m_reverse_postorder[i];
+            BlockIndex new_idom = NO_BLOCK;
+            for (BlockIndex pred : program.blocks[block].predecessors) {
+                if (pred >= program.blocks.size() || m_idom[pred] == NO_BLOCK) continue; // Not processed yet
+                new_idom = (new_idom == NO_BLOCK) ? pred : intersect(pred, new_idom);
+            }
+            if (new_idom != m_idom[block]) {
+                m_idom[block] = new_idom;
+                changed = true;
+            }
+        }
+    }
+    m_idom[0] = NO_BLOCK;
+
+    for (BlockIndex block : m_reverse_postorder) {
+        if (m_idom[block] != NO_BLOCK) m_children[m_idom[block]].push_back(block);
+    }
+}
+
+// Preorder/postorder numbers over the dominator tree: `a` dominates `b`
+// exactly when b's interval nests inside a's.
+void DominatorTree::numberTree() {
+    uint32_t counter = 0;
+    std::vector<std::pair<BlockIndex, uint32_t>> stack; // Block, next child to visit
+    stack.push_back({0, 0});
+    m_enter[0] = counter++;
+    while (!stack.empty()) {
+        auto& [block, next] = stack.back();
+        if (next < m_children[block].size()) {
+            BlockIndex child = m_children[block][next++];
+            m_enter[child] = counter++;
+            stack.push_back({child, 0});
+        } else {
+            m_exit[block] = counter++;
+            stack.pop_back();
+        }
+    }
+}
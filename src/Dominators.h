@@ -0,0 +1,49 @@
+#pragma once
+
+#include "IR.h"
+#include <vector>
+
+// The dominator tree of an IRProgram's control-flow graph.
+//
+// Block A dominates block B if every path from the entry block to B passes
+// through A. Immediate dominators are computed with the iterative algorithm
+// of Cooper, Harvey and Kennedy ("A Simple, Fast Dominance Algorithm"), and
+// the tree is then numbered so dominates() is a constant-time check.
+//
+// The tree is a snapshot: recompute it after changing the CFG.
+class DominatorTree {
+public:
+    explicit DominatorTree(const IRProgram& program);
+
+    // The immediate dominator of `block`, or NO_BLOCK for the entry block and
+    // for blocks that can't be reached from it.
+    BlockIndex idom(BlockIndex block) const { return m_idom[block]; }
+
+    bool reachable(BlockIndex block) const { return m_rpo_number[block] != UNREACHED; }
+
+    // True if `a` dominates `b` (every block dominates itself).
+    bool dominates(BlockIndex a, BlockIndex b) const {
+        return reachable(a) && reachable(b) && m_enter[a] <= m_enter[b] && m_exit[b] <= m_exit[a];
+    }
+
+    // The blocks immediately dominated by `block`.
+    const std::vector<BlockIndex>& children(BlockIndex block) const { return m_children[block]; }
+
+    // The reachable blocks in reverse postorder, entry first. Every block comes
+    // after its dominators.
+    const std::vector<BlockIndex>& reverse_postorder() const { return m_reverse_postorder; }
+
+private:
+    static constexpr uint32_t UNREACHED = UINT32_MAX;
+
+    std::vector<BlockIndex> m_idom;
+    std::vector<BlockIndex> m_reverse_postorder;
+    std::vector<uint32_t> m_rpo_number; // Position in m_reverse_postorder
+    std::vector<std::vector<BlockIndex>> m_children;
+    std::vector<uint32_t> m_enter; // Preorder and postorder numbers in the tree
+    std::vector<uint32_t> m_exit;
+
+    void computeReversePostorder(const IRProgram& program);
+    void computeImmediateDominators(const IRProgram& program);
+    void numberTree();
+};
@@ -0,0 +1,170 @@
+#include "ElfWriter.h"
+#include "X86Encoder.h"
+#include <elf.h>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+// The sections, in section header order.
+enum Section : uint16_t {
+    SECTION_NULL,
+    SECTION_TEXT,
+    SECTION_RODATA,
+    SECTION_RELA_TEXT,
+    SECTION_SYMTAB,
+    SECTION_STRTAB,
+    SECTION_SHSTRTAB,
+    SECTION_NOTE_GNU_STACK, // Empty: marks the stack as not executable
+    SECTION_COUNT,
+};
+
+// The symbols: the two section symbols (which relocations into .rodata use),
+// then the globals: _start, the program's functions and the external
+// functions.
+enum : uint32_t {
+    SYMBOL_TEXT = 1,
+    SYMBOL_RODATA = 2,
+    SYMBOL_START = 3,
+    FIRST_FUNCTION = 4,
+};
+
+// A string table: names packed one after another, each ending in '\0', and
+// referred to by offset.
+class StringTable {
+public:
+    StringTable() { m_data.push_back('\0'); }
+
+    uint32_t add(std::string_view name) {
+        uint32_t offset = (uint32_t)m_data.size();
+        m_data.append(name);
+        m_data.push_back('\0');
+        return offset;
+    }
+
+    const std::string& data() const { return m_data; }
+
+private:
+    std::string m_data;
+};
+
+template <typename T>
+void append(std::vector<char>& out, const T& value) {
+    const char* bytes = reinterpret_cast<const char*>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+void align(std::vector<char>& out, size_t alignment) {
+    out.resize((out.size() + alignment - 1) / alignment * alignment, '\0');
+}
+
+} // namespace
+
+void write_elf_object(std::ostream& os, const MachineCode& code) {
+    EncodedCode encoded = encode_x86(code);
+
+    // --- Symbols ---
+    StringTable strings;
+    std::vector<Elf64_Sym> symbols(FIRST_FUNCTION);
+    std::memset(symbols.data(), 0, symbols.size() * sizeof(Elf64_Sym));
+    symbols[SYMBOL_TEXT].st_info = ELF64_ST_INFO(STB_LOCAL, STT_SECTION);
+    symbols[SYMBOL_TEXT].st_shndx = SECTION_TEXT;
+    symbols[SYMBOL_RODATA].st_info = ELF64_ST_INFO(STB_LOCAL, STT_SECTION);
+    symbols[SYMBOL_RODATA].st_shndx = SECTION_RODATA;
+    symbols[SYMBOL_START].st_name = strings.add("_start");
+    symbols[SYMBOL_START].st_info = ELF64_ST_INFO(STB_GLOBAL, STT_NOTYPE);
+    symbols[SYMBOL_START].st_shndx = SECTION_TEXT;
+    for (size_t i = 0; i < code.functions.size(); ++i) {
+        // Each function runs up to the next one, the last to the end of .text.
+        uint64_t end = i + 1 < code.functions.size() ? encoded.function_offsets[i + 1] : encoded.text.size();
+        Elf64_Sym symbol{};
+        symbol.st_name = strings.add(code.functions[i]);
+        symbol.st_info = ELF64_ST_INFO(STB_GLOBAL, STT_FUNC);
+        symbol.st_shndx = SECTION_TEXT;
+        symbol.st_value = encoded.function_offsets[i];
+        symbol.st_size = end - encoded.function_offsets[i];
+        symbols.push_back(symbol);
+    }
+    const uint32_t first_external = (uint32_t)symbols.size();
+    for (std::string_view name : code.symbols) {
+        Elf64_Sym symbol{};
+        symbol.st_name = strings.add(name);
+        symbol.st_info = ELF64_ST_INFO(STB_GLOBAL, STT_NOTYPE);
+        symbol.st_shndx = SHN_UNDEF;
+        symbols.push_back(symbol);
+    }
+
+    // --- Relocations ---
+    std::vector<Elf64_Rela> relocations;
+    relocations.reserve(encoded.relocations.size());
+    for (const CodeRelocation& relocation : encoded.relocations) {
+        Elf64_Rela rela;
+        rela.r_offset = relocation.offset;
+        if (relocation.kind == CodeRelocation::CALL) {
+            rela.r_info = ELF64_R_INFO(first_external + relocation.index, R_X86_64_PLT32);
+            rela.r_addend = relocation.addend;
+        } else {
+            rela.r_info = ELF64_R_INFO(SYMBOL_RODATA, R_X86_64_PC32);
+            rela.r_addend = 8 * (int64_t)relocation.index + relocation.addend;
+        }
+        relocations.push_back(rela);
+    }
+
+    // --- Section contents, after the ELF header ---
+    static const char* const SECTION_NAMES[SECTION_COUNT] = {
+        "", ".text", ".rodata", ".rela.text", ".symtab", ".strtab", ".shstrtab", ".note.GNU-stack",
+    };
+    StringTable section_names;
+    Elf64_Shdr headers[SECTION_COUNT];
+    std::memset(headers, 0, sizeof(headers));
+    for (int section = 1; section < SECTION_COUNT; ++section) {
+        headers[section].sh_name = section_names.add(SECTION_NAMES[section]);
+    }
+    std::vector<char> file(sizeof(Elf64_Ehdr), '\0');
+    auto place = [&](Section section, uint32_t type, uint64_t flags, size_t alignment, const void* data, size_t size) {
+        align(file, alignment);
+        Elf64_Shdr& header = headers[section];
+        header.sh_type = type;
+        header.sh_flags = flags;
+        header.sh_offset = file.size();
+        header.sh_size = size;
+        header.sh_addralign = alignment;
+        file.insert(file.end(), (const char*)data, (const char*)data + size);
+    };
+    place(SECTION_TEXT, SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR, 16, encoded.text.data(), encoded.text.size());
+    place(SECTION_RODATA, SHT_PROGBITS, SHF_ALLOC, 8, code.literals.data(), code.literals.size() * sizeof(uint64_t));
+    place(SECTION_RELA_TEXT, SHT_RELA, SHF_INFO_LINK, 8, relocations.data(), relocations.size() * sizeof(Elf64_Rela));
+    headers[SECTION_RELA_TEXT].sh_link = SECTION_SYMTAB;
+    headers[SECTION_RELA_TEXT].sh_info = SECTION_TEXT;
+    headers[SECTION_RELA_TEXT].sh_entsize = sizeof(Elf64_Rela);
+    place(SECTION_SYMTAB, SHT_SYMTAB, 0, 8, symbols.data(), symbols.size() * sizeof(Elf64_Sym));
+    headers[SECTION_SYMTAB].sh_link = SECTION_STRTAB;
+    headers[SECTION_SYMTAB].sh_info = SYMBOL_START; // One past the last local symbol
+    headers[SECTION_SYMTAB].sh_entsize = sizeof(Elf64_Sym);
+    place(SECTION_STRTAB, SHT_STRTAB, 0, 1, strings.data().data(), strings.data().size());
+    place(SECTION_SHSTRTAB, SHT_STRTAB, 0, 1, section_names.data().data(), section_names.data().size());
+    place(SECTION_NOTE_GNU_STACK, SHT_PROGBITS, 0, 1, nullptr, 0);
+
+    // --- Section headers, then the ELF header in front ---
+    align(file, 8);
+    Elf64_Ehdr header{};
+    std::memcpy(header.e_ident, ELFMAG, SELFMAG);
+    header.e_ident[EI_CLASS] = ELFCLASS64;
+    header.e_ident[EI_DATA] = ELFDATA2LSB;
+    header.e_ident[EI_VERSION] = EV_CURRENT;
+    header.e_ident[EI_OSABI] = ELFOSABI_SYSV;
+    header.e_type = ET_REL;
+    header.e_machine = EM_X86_64;
+    header.e_version = EV_CURRENT;
+    header.e_shoff = file.size();
+    header.e_ehsize = sizeof(Elf64_Ehdr);
+    header.e_shentsize = sizeof(Elf64_Shdr);
+    header.e_shnum = SECTION_COUNT;
+    header.e_shstrndx = SECTION_SHSTRTAB;
+    for (const Elf64_Shdr& section : headers) append(file, section);
+    std::memcpy(file.data(), &header, sizeof(header));
+
+    os.write(file.data(), (std::streamsize)file.size());
+}
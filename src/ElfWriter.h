@@ -0,0 +1,12 @@
+#pragma once
+
+#include "MachineCode.h"
+#include <iostream>
+
+// Writes the program as an ELF64 relocatable object for x86-64 Linux, the
+// same program `nasm -f elf64` makes of write_nasm()'s output: the code in
+// .text with a global _start and a global function symbol for each of the
+// program's functions, the float literals in .rodata, and an
+// R_X86_64_PLT32 relocation against an undefined symbol for every call to
+// an external function, ready for `ld`.
+void write_elf_object(std::ostream& os, const MachineCode& code);
@@ -0,0 +1,168 @@
+#include "IR.h"
+
+const char* ir_op_name(IROp op) {
+    switch (op) {
+        case IROp::COPY:   return "copy";
+        case IROp::ADD:    return "+";
+        case IROp::SUB:    return "-";
+        case IROp::MUL:    return "*";
+        case IROp::DIV:    return "/";
+        case IROp::CMP_EQ: return "==";
+        case IROp::CMP_NE: return "!=";
+        case IROp::CMP_LT: return "<";
+        case IROp::CMP_LE: return "<=";
+        case IROp::CMP_GT: return ">";
+        case IROp::CMP_GE: return ">=";
+        case IROp::CAST:   return "cast";
+        case IROp::PARAM:  return "PARAM";
+        case IROp::CALL:   return "CALL";
+        case IROp::ARGUMENT: return "ARGUMENT";
+    }
+    return "?";
+}
+
+long long truncate_to_int(double value) {
+    if (!(value >= -9223372036854775808.0 && value < 9223372036854775808.0)) return INT64_MIN;
+    return (long long)value;
+}
+
+size_t IRProgram::instruction_count() const {
+    size_t count = 0;
+    for (const IRBlock& block : blocks) {
+        count += block.phis.size() + block.instructions.size();
+    }
+    return count;
+}
+
+IRProgram& IRModule::add_function(std::string_view name) {
+    arenas.push_back(std::make_unique<Arena>(FUNCTION_ARENA_BLOCK_SIZE));
+    IRProgram& function = functions.emplace_back(arenas.back().get());
+    function.name = name;
+    return function;
+}
+
+size_t IRModule::instruction_count() const {
+    size_t count = 0;
+    for (const IRProgram& function : functions) count += function.instruction_count();
+    return count;
+}
+
+size_t IRModule::block_count() const {
+    size_t count = 0;
+    for (const IRProgram& function : functions) count += function.blocks.size();
+    return count;
+}
+
+void print_operand(std::ostream& os, const IRProgram& program, IROperand operand) {
+    switch (operand.kind()) {
+        case IROperand::NONE:     os << "_"; break;
+        case IROperand::TEMP:     os << "t" << operand.index(); break;
+        case IROperand::SYMBOL:   os << program.symbols[operand.index()]; break;
+        case IROperand::CONSTANT: {
+            const IRConstant& constant = program.constants[operand.index()];
+            if (constant.type == DataType::FLOAT) {
+                os << constant.float_value;
+            } else {
+                os << constant.int_value;
+            }
+            break;
+        }
+    }
+}
+
+static void print_instruction(std::ostream& os, const IRProgram& program, const IRInstruction& instr) {
+    switch (instr.op) {
+        case IROp::CAST:
+            print_operand(os, program, instr.result);
+            os << " = (" << (instr.type == DataType::FLOAT ? "float" : "int") << ") ";
+            print_operand(os, program, instr.arg1);
+            break;
+        case IROp::CALL:
+            print_operand(os, program, instr.result);
+            os << " = CALL ";
+            print_operand(os, program, instr.arg1);
+            os << ", " << instr.count << "_params";
+            break;
+        case IROp::PARAM:
+            os << "PARAM ";
+            print_operand(os, program, instr.arg1);
+            break;
+        case IROp::ARGUMENT:
+            print_operand(os, program, instr.result);
+            os << " = ARGUMENT " << instr.count;
+            break;
+        case IROp::COPY:
+            print_operand(os, program, instr.result);
+            os << " = ";
+            print_operand(os, program, instr.arg1);
+            break;
+        default: // Binary operations
+            print_operand(os, program, instr.result);
+            os << " = ";
+            print_operand(os, program, instr.arg1);
+            os << " " << ir_op_name(instr.op) << " ";
+            print_operand(os, program, instr.arg2);
+            break;
+    }
+}
+
+static void print_terminator(std::ostream& os, const IRProgram& program, const IRTerminator& terminator) {
+    switch (terminator.kind) {
+        case IRTerminator::NONE:
+            os << "<unterminated>";
+            break;
+        case IRTerminator::JUMP:
+            os << "jump b" << terminator.targets[0];
+            break;
+        case IRTerminator::BRANCH:
+            os << "branch ";
+            print_operand(os, program, terminator.value);
+            os << " ? b" << terminator.targets[0] << " : b" << terminator.targets[1];
+            break;
+        case IRTerminator::RETURN:
+            os << "return";
+            if (terminator.value.kind() != IROperand::NONE) {
+                os << " ";
+                print_operand(os, program, terminator.value);
+            }
+            break;
+    }
+}
+
+void print_ir(const IRProgram& program, std::ostream& os) {
+    os << "--- Intermediate Representation ";
+    if (!program.name.empty()) os << "of " << program.name << " ";
+    os << "(IR" << (program.in_ssa ? ", SSA" : "") << ") ---\n";
+    for (BlockIndex b = 0; b < program.blocks.size(); ++b) {
+        const IRBlock& block = program.blocks[b];
+        os << "b" << b << ":";
+        if (!block.predecessors.empty()) {
+            os << "  ; preds:";
+            for (BlockIndex pred : block.predecessors) os << " b" << pred;
+        }
+        os << "\n";
+
+        for (const IRPhi& phi : block.phis) {
+            os << "  ";
+            print_operand(os, program, phi.result);
+            os << " = phi";
+            for (size_t i = 0; i < phi.incoming.size(); ++i) {
+                os << (i == 0 ? " " : ", ") << "[";
+                if (i < block.predecessors.size()) os << "b" << block.predecessors[i];
+                os << ": ";
+                print_operand(os, program, phi.incoming[i]);
+                os << "]";
+            }
+            os << "\n";
+        }
+        for (const IRInstruction& instr : block.instructions) {
+            os << "  ";
+            print_instruction(os, program, instr);
+            os << "\n";
+        }
+        os << "  ";
+        print_terminator(os, program, block.terminator);
+        os << "\n";
+    }
+    os << "-------------------------------------\n";
+}
@@ -1,71 +1,233 @@
 #pragma once
 
-#include "AST.h" // For TokenType and DataType
-#include <string>
-#include <variant>
+#include "AST.h" // For DataType
+#include "Arena.h"
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <string_view>
 #include <vector>
 #include <iostream>
-// An Operand can be a temporary variable (like "t1"), a user-defined variable, or a literal constant.
-using IROperand = std::variant<std::string, int, double>;
 
-// A single Three-Address Code instruction
+// The operations of our Three-Address Code. The IR has its own opcodes
+// rather than reusing TokenType, so the backend never has to guess whether
+// e.g. MINUS is a subtraction or a negation. Control flow isn't an
+// instruction: it is the terminator at the end of each IRBlock.
+enum class IROp : uint8_t {
+    COPY,   // result = arg1
+    ADD,    // result = arg1 + arg2
+    SUB,    // result = arg1 - arg2
+    MUL,    // result = arg1 * arg2
+    DIV,    // result = arg1 / arg2
+    CMP_EQ, // result = arg1 == arg2 (and so on: 1 if true, 0 if false)
+    CMP_NE,
+    CMP_LT,
+    CMP_LE,
+    CMP_GT,
+    CMP_GE,
+    CAST,   // result = (type) arg1, with the target type in the instruction's `type`
+    PARAM,  // Passes arg1 to the next CALL
+    CALL,   // result = arg1(the `count` preceding PARAMs)
+    ARGUMENT, // result = the function's argument number `count`; only at the start of the entry block
+};
+
+// An operand is a 32-bit handle: a kind tag in the top bits and an index
+// below it. What the index refers to depends on the kind:
+//
+//   TEMP      a virtual register, numbered 0..IRProgram::temp_count-1
+//   CONSTANT  an entry in IRProgram::constants
+//   SYMBOL    an entry in IRProgram::symbols (the functions it calls)
+//
+// Variables declared with 'let' have no operand kind of their own: in SSA
+// form a variable is just a name for the temporary holding its value.
+//
+// Comparing or hashing an operand is a single integer operation.
+class IROperand {
+public:
+    enum Kind : uint32_t { NONE, TEMP, CONSTANT, SYMBOL };
+
+    static constexpr uint32_t KIND_SHIFT = 29;
+    static constexpr uint32_t MAX_INDEX = (1u << KIND_SHIFT) - 1;
+
+    constexpr IROperand() : m_bits(0) {}
+    constexpr IROperand(Kind kind, uint32_t index) : m_bits((kind << KIND_SHIFT) | index) {}
+
+    static constexpr IROperand temp(uint32_t index) { return {TEMP, index}; }
+    static constexpr IROperand constant(uint32_t index) { return {CONSTANT, index}; }
+    static constexpr IROperand symbol(uint32_t index) { return {SYMBOL, index}; }
+
+    constexpr Kind kind() const { return Kind(m_bits >> KIND_SHIFT); }
+    constexpr uint32_t index() const { return m_bits & MAX_INDEX; }
+    constexpr uint32_t bits() const { return m_bits; }
+
+    constexpr bool operator==(IROperand other) const { return m_bits == other.m_bits; }
+    constexpr bool operator!=(IROperand other) const { return m_bits != other.m_bits; }
+
+private:
+    uint32_t m_bits;
+};
+static_assert(sizeof(IROperand) == 4, "IR operands are meant to be 32-bit handles");
+
+// A literal value referred to by a CONSTANT operand.
+struct IRConstant {
+    DataType type; // INT or FLOAT
+    union {
+        long long int_value;
+        double float_value;
+    };
+};
+
+// Float to int the way a CAST does it at run time (cvttsd2si): truncation
+// toward zero, and the "integer indefinite" value INT64_MIN for NaN and
+// anything out of range.
+long long truncate_to_int(double value);
+
+// A single Three-Address Code instruction, packed into 16 bytes. There are
+// no implicit conversions: both operands of an arithmetic operation or a
+// comparison have the same type, and an int used as a float goes through a
+// CAST first.
 struct IRInstruction {
-    TokenType op; // The operator (e.g., TOKEN_PLUS, TOKEN_STAR, TOKEN_EQUALS for assignment)
-    
+    IROp op;
+    DataType type;      // The type of the result (for CAST, the target type; for comparisons,
+                        // the type of the operands: the result is always an INT)
+    uint16_t count = 0; // CALL: the number of arguments; ARGUMENT: which argument
+    IROperand result;   // The temporary that receives the result
     IROperand arg1;
     IROperand arg2;
-    IROperand result; // Where the result is stored (usually a temporary like "t1" or a variable name)
 };
+static_assert(sizeof(IRInstruction) == 16, "IR instructions are meant to stay packed into 16 bytes");
 
-// A simple container for our entire IR program
-struct IRProgram {
-    std::vector<IRInstruction> instructions;
+// Calls `visit(operand)` for every operand that `instr` reads. (COPY, CAST,
+// PARAM and CALL leave arg2 unused; an ARGUMENT reads nothing.)
+template <typename Visit>
+void forEachUse(const IRInstruction& instr, Visit&& visit) {
+    if (instr.op == IROp::ARGUMENT) return;
+    visit(instr.arg1);
+    if (instr.op != IROp::COPY && instr.op != IROp::CAST && instr.op != IROp::PARAM && instr.op != IROp::CALL) {
+        visit(instr.arg2);
+    }
+}
+
+// Blocks are referred to by their position in IRProgram::blocks.
+using BlockIndex = uint32_t;
+constexpr BlockIndex NO_BLOCK = UINT32_MAX;
+
+// How control leaves a basic block.
+struct IRTerminator {
+    enum Kind : uint8_t {
+        NONE,   // Not terminated yet (only while the block is being built)
+        JUMP,   // Continue at targets[0]
+        BRANCH, // Continue at targets[0] if `value` is nonzero, else at targets[1]
+        RETURN, // End the program, or return from the function, with `value` (NONE: with 0)
+    };
+    Kind kind = NONE;
+    IROperand value;
+    BlockIndex targets[2] = {NO_BLOCK, NO_BLOCK};
+
+    uint32_t successor_count() const { return kind == JUMP ? 1 : kind == BRANCH ? 2 : 0; }
 };
-// In src/IR.h, after the struct definitions
 
+// result = phi(incoming[0] from predecessors[0], incoming[1] from predecessors[1], ...)
+struct IRPhi {
+    IROperand result;
+    DataType type;
+    std::pmr::vector<IROperand> incoming; // One per predecessor of the block, in the same order
 
+    IRPhi(IROperand result, DataType type, std::pmr::memory_resource* memory)
+        : result(result), type(type), incoming(memory) {}
+};
 
-// Helper to print a single operand
-inline void print_operand(const IROperand& operand) {
-    std::visit([](auto&& arg){ std::cout << arg; }, operand);
-}
+// A basic block: phis, then straight-line instructions, then one terminator.
+struct IRBlock {
+    std::pmr::vector<IRPhi> phis;
+    std::pmr::vector<IRInstruction> instructions;
+    IRTerminator terminator;
+    std::pmr::vector<BlockIndex> predecessors; // Kept in sync with the terminators that target this block
+
+    explicit IRBlock(std::pmr::memory_resource* memory)
+        : phis(memory), instructions(memory), predecessors(memory) {}
+};
+
+// A complete program as a control-flow graph, plus the tables its operands
+// index into. Everything lives in the compilation-session arena.
+//
+// The IRGenerator produces SSA form: every temporary is assigned exactly once
+// (by an instruction or a phi), and every use is dominated by its definition
+// (see SSA.h for the verifier). lower_out_of_ssa() then replaces the phis with
+// copies so the backend can consume the blocks directly.
+struct IRProgram {
+    std::pmr::vector<IRBlock> blocks;           // blocks[0] is the entry block
+    std::pmr::vector<IRConstant> constants;     // Deduplicated literal values
+    std::pmr::vector<std::string_view> symbols; // Names of the functions called
+    uint32_t temp_count = 0;                    // Number of temporaries used
+    std::pmr::vector<DataType> temp_types;      // INT or FLOAT, indexed by temporary
+    bool in_ssa = true;                         // False once the phis have been lowered
+
+    // Set for a function definition; the top level has neither.
+    std::string_view name;
+    std::pmr::vector<DataType> parameters; // The type of each ARGUMENT
+
+    explicit IRProgram(std::pmr::memory_resource* memory = std::pmr::get_default_resource())
+        : blocks(memory), constants(memory), symbols(memory), temp_types(memory), parameters(memory) {}
+
+    std::pmr::memory_resource* memory() const { return blocks.get_allocator().resource(); }
+
+    // Appends an empty block and returns its index.
+    BlockIndex add_block() {
+        blocks.emplace_back(memory());
+        return (BlockIndex)blocks.size() - 1;
+    }
+
+    // Ends `from` with a jump to `to` and records the edge.
+    void jump(BlockIndex from, BlockIndex to) {
+        blocks[from].terminator = {IRTerminator::JUMP, {}, {to, NO_BLOCK}};
+        blocks[to].predecessors.push_back(from);
+    }
+
+    // Ends `from` with a two-way branch on `condition` and records both edges.
+    void branch(BlockIndex from, IROperand condition, BlockIndex if_true, BlockIndex if_false) {
+        blocks[from].terminator = {IRTerminator::BRANCH, condition, {if_true, if_false}};
+        blocks[if_true].predecessors.push_back(from);
+        blocks[if_false].predecessors.push_back(from);
+    }
 
-// Helper to print the entire IR program
-inline void print_ir(const IRProgram& program) {
-    std::cout << "--- Intermediate Representation (IR) ---\n";
-    for (const auto& instr : program.instructions) {
-        switch (instr.op) {
-            case TokenType::CAST:
-                print_operand(instr.result);
-                std::cout << " = (cast) ";
-                print_operand(instr.arg1);
-                // We could store the target type in arg2 if needed
-                break;
-            case TokenType::CALL:
-                print_operand(instr.result);
-                std::cout << " = CALL ";
-                print_operand(instr.arg1); // Function name
-                // We can check the variant index for the number of args
-                std::cout << ", " << std::get<int>(instr.arg2) << "_params"; 
-                break;
-            case TokenType::PARAM:
-                std::cout << "PARAM ";
-                print_operand(instr.arg1);
-                break;
-            case TokenType::EQUALS:
-                print_operand(instr.result);
-                std::cout << " = ";
-                print_operand(instr.arg1);
-                break;
-            default: // For binary ops like +, -, *
-                print_operand(instr.result);
-                std::cout << " = ";
-                print_operand(instr.arg1);
-                std::cout << " " << (char)instr.op << " ";
-                print_operand(instr.arg2);
-                break;
-        }
-        std::cout << "\n";
+    IROperand new_temporary(DataType type) {
+        temp_types.push_back(type);
+        return IROperand::temp(temp_count++);
     }
-    std::cout << "-------------------------------------\n";
-}
\ No newline at end of file
+
+    // Total number of instructions and phis in all blocks.
+    size_t instruction_count() const;
+};
+
+// A whole program, as parts that are compiled separately: functions[0] is
+// the top-level code, which runs first and whose value is the exit status,
+// followed by one IRProgram per function definition in source order. Calls
+// between them go by name, through each part's symbols.
+//
+// The top level's IR lives in the session arena. Each function has an arena
+// of its own, so the phases after IR generation can work on several
+// functions at once (see WorkStealingPool.h) without sharing an allocator.
+struct IRModule {
+    static constexpr size_t FUNCTION_ARENA_BLOCK_SIZE = 4 * 1024; // Most functions are small
+
+    std::vector<std::unique_ptr<Arena>> arenas; // arenas[i] backs functions[i + 1]; outlives them
+    std::vector<IRProgram> functions;
+
+    // Appends a function with no blocks yet, in a new arena.
+    IRProgram& add_function(std::string_view name);
+
+    // Totals over every part.
+    size_t instruction_count() const;
+    size_t block_count() const;
+};
+
+// The textual name of an opcode, e.g. "+".
+const char* ir_op_name(IROp op);
+
+// Prints one operand the way print_ir() does ("t3", "42", "my_func").
+void print_operand(std::ostream& os, const IRProgram& program, IROperand operand);
+
+// Prints the whole program block by block, one instruction per line. A
+// function's header names it.
+void print_ir(const IRProgram& program, std::ostream& os = std::cout);
@@ -1,138 +1,413 @@
 #include "IRGenerator.h"
-#include <string>
+#include <cstring>
+#include <stdexcept>
+
+IRGenerator::IRGenerator(Arena& arena)
+    : m_program(&m_module.functions.emplace_back(&arena)), m_values(&arena), m_variables(&arena),
+      m_symbol_indices(&arena), m_int_constants(&arena), m_float_constants(&arena), m_function_indices(&arena),
+      m_outer_variables(&arena), m_outer_symbol_indices(&arena), m_outer_int_constants(&arena),
+      m_outer_float_constants(&arena), m_short_circuit_at(&arena) {}
+
+static bool isLogical(TokenType op) {
+    return op == TokenType::AND_AND || op == TokenType::OR_OR;
+}
 
 // The main entry point. It runs the generator and returns the completed program.
-IRProgram IRGenerator::generate(const std::vector<std::unique_ptr<StatementNode>>& statements) {
-    for (const auto& stmt : statements) {
-        stmt->accept(*this);
+// Nodes are stored in post-order (see AST.h), so by the time we reach a node
+// the code for all of its operands has already been emitted.
+IRModule IRGenerator::generate(const AST& ast) {
+    m_current_block = m_program->add_block();
+    m_program->blocks[m_current_block].instructions.reserve(ast.size());
+    add(ast);
+    return finish();
+}
+
+void IRGenerator::add(const AST& ast) {
+    if (m_program->blocks.empty()) m_current_block = m_program->add_block();
+    // Node indices start over in every AST.
+    m_values.resize(ast.size());
+    findShortCircuits(ast);
+
+    for (NodeIndex node = 0; node < ast.size(); ++node) {
+        // The right operand of a && or || starts here: only evaluate it if
+        // the left operand didn't already decide the result.
+        if (!m_short_circuit_at.empty() && m_short_circuit_at[node] != NO_NODE) {
+            beginLogicalRhs(ast, m_short_circuit_at[node]);
+        }
+
+        switch (ast.kind(node)) {
+            // Literals and identifiers are the "leaves" of our expressions.
+            // They don't generate instructions themselves. They just provide
+            // their value or name to be used by their parent node.
+            case NodeKind::INTEGER_LITERAL: m_values[node] = int_constant(ast.int_value(node)); break;
+            case NodeKind::FLOAT_LITERAL:   m_values[node] = float_constant(ast.float_value(node)); break;
+            case NodeKind::IDENTIFIER:      m_values[node] = resolve_name(ast.name(node)); break;
+
+            case NodeKind::UNARY_OP:        emitUnaryOp(ast, node); break;
+            case NodeKind::BINARY_OP:
+                if (isLogical(ast.op(node))) {
+                    emitLogicalOp(ast, node);
+                } else {
+                    emitBinaryOp(ast, node);
+                }
+                break;
+            case NodeKind::CAST:            emitCast(ast, node); break;
+            case NodeKind::FUNCTION_CALL:   emitFunctionCall(ast, node); break;
+            case NodeKind::LET_STATEMENT:   emitLet(ast, node); break;
+            case NodeKind::FUNCTION:        beginFunction(ast, node); break;
+            case NodeKind::RETURN_STATEMENT: emitReturn(ast, node); break;
+
+            // The code for the expression has already been generated.
+            case NodeKind::EXPRESSION_STATEMENT: break;
+            // Parameters are declared by beginFunction().
+            case NodeKind::PARAMETER: break;
+        }
     }
-    return m_program;
 }
 
-// Helper to create new, unique temporary variable names like "t0", "t1", etc.
-std::string IRGenerator::new_temporary() {
-    return "t" + std::to_string(m_temp_counter++);
+IRModule IRGenerator::finish() {
+    if (m_program->blocks.empty()) m_current_block = m_program->add_block();
+
+    // The program exits with the value of the most recently declared variable.
+    IROperand result;
+    if (!m_last_declared.empty()) result = m_variables[m_last_declared];
+    m_program->blocks[m_current_block].terminator = {IRTerminator::RETURN, result, {NO_BLOCK, NO_BLOCK}};
+
+    // Moving keeps the programs' vectors bound to their arenas.
+    return std::move(m_module);
 }
 
-// --- Visitor Implementations ---
+// The first node of `node`'s subtree in post-order: the parser builds each
+// subtree as one contiguous run of nodes, left operand first, so this is
+// found by following left operands down to a leaf.
+static NodeIndex subtreeStart(const AST& ast, NodeIndex node) {
+    while (true) {
+        switch (ast.kind(node)) {
+            case NodeKind::UNARY_OP:
+            case NodeKind::BINARY_OP:
+            case NodeKind::CAST:
+            case NodeKind::FUNCTION_CALL: // lhs is the callee
+                node = ast.lhs(node);
+                break;
+            default:
+                return node;
+        }
+    }
+}
+
+// Marks where the right operand of each && and || begins. Each node is on
+// the left spine of at most one such operand, so this is linear overall.
+void IRGenerator::findShortCircuits(const AST& ast) {
+    m_short_circuit_at.clear();
+    bool any = false;
+    for (NodeIndex node = 0; node < ast.size() && !any; ++node) {
+        any = ast.kind(node) == NodeKind::BINARY_OP && isLogical(ast.op(node));
+    }
+    if (!any) return;
 
-// When we visit a statement, we just need to process the expressions inside it.
-void IRGenerator::visit(const ExpressionStatementNode& node) {
-    node.expression->accept(*this); // This will generate code for the expression.
+    m_short_circuit_at.assign(ast.size(), NO_NODE);
+    for (NodeIndex node = 0; node < ast.size(); ++node) {
+        if (ast.kind(node) == NodeKind::BINARY_OP && isLogical(ast.op(node))) {
+            m_short_circuit_at[subtreeStart(ast, ast.rhs(node))] = node;
+        }
+    }
 }
 
-// Literals and identifiers are the "leaves" of our expressions.
-// They don't generate instructions themselves. They just provide their value or name
-// to be used by their parent node. We store this in `m_last_operand`.
+IROperand IRGenerator::int_constant(long long value) {
+    auto [it, inserted] = m_int_constants.try_emplace(value, (uint32_t)m_program->constants.size());
+    if (inserted) {
+        IRConstant constant{DataType::INT, {}};
+        constant.int_value = value;
+        m_program->constants.push_back(constant);
+    }
+    return IROperand::constant(it->second);
+}
 
-void IRGenerator::visit(const IntegerLiteralNode& node) {
-    m_last_operand = (int)node.value;
+IROperand IRGenerator::float_constant(double value) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    auto [it, inserted] = m_float_constants.try_emplace(bits, (uint32_t)m_program->constants.size());
+    if (inserted) {
+        IRConstant constant{DataType::FLOAT, {}};
+        constant.float_value = value;
+        m_program->constants.push_back(constant);
+    }
+    return IROperand::constant(it->second);
 }
 
-void IRGenerator::visit(const FloatLiteralNode& node) {
-    m_last_operand = node.value;
+// A variable is the value its latest 'let' gave it. A name that no earlier
+// 'let' declared refers to something outside the program, such as an
+// external function.
+IROperand IRGenerator::resolve_name(std::string_view name) {
+    auto variable = m_variables.find(name);
+    if (variable != m_variables.end()) return variable->second;
+
+    auto [it, inserted] = m_symbol_indices.try_emplace(name, (uint32_t)m_program->symbols.size());
+    if (inserted) m_program->symbols.push_back(name);
+    return IROperand::symbol(it->second);
+}
+
+void IRGenerator::emit(IROp op, DataType type, IROperand result, IROperand arg1, IROperand arg2) {
+    m_program->blocks[m_current_block].instructions.push_back({op, type, 0, result, arg1, arg2});
+}
+
+// The IR opcode for a binary operator token.
+static IROp binary_op(TokenType op) {
+    switch (op) {
+        case TokenType::PLUS:          return IROp::ADD;
+        case TokenType::MINUS:         return IROp::SUB;
+        case TokenType::STAR:          return IROp::MUL;
+        case TokenType::SLASH:         return IROp::DIV;
+        case TokenType::EQUAL_EQUAL:   return IROp::CMP_EQ;
+        case TokenType::BANG_EQUAL:    return IROp::CMP_NE;
+        case TokenType::LESS:          return IROp::CMP_LT;
+        case TokenType::LESS_EQUAL:    return IROp::CMP_LE;
+        case TokenType::GREATER:       return IROp::CMP_GT;
+        case TokenType::GREATER_EQUAL: return IROp::CMP_GE;
+        default:
+            throw std::runtime_error("IR Error: Unsupported binary operator.");
+    }
+}
+
+static bool isComparison(IROp op) {
+    return op >= IROp::CMP_EQ && op <= IROp::CMP_GE;
+}
+
+// `value` (of type `from`) as a value of type `to`. Constants are converted
+// right away; anything else gets a CAST.
+IROperand IRGenerator::convert(IROperand value, DataType from, DataType to) {
+    if (from == to) return value;
+    if (value.kind() == IROperand::CONSTANT) {
+        const IRConstant& constant = m_program->constants[value.index()];
+        if (constant.type == to) return value;
+        if (to == DataType::FLOAT) return float_constant((double)constant.int_value);
+    }
+    IROperand result_temp = m_program->new_temporary(to);
+    emit(IROp::CAST, to, result_temp, value);
+    return result_temp;
 }
 
-void IRGenerator::visit(const IdentifierNode& node) {
-    m_last_operand = node.name;
+// Zero of the given type, for tests against zero.
+IROperand IRGenerator::zero(DataType type) {
+    return type == DataType::FLOAT ? float_constant(0.0) : int_constant(0);
+}
+
+// 1 if `value` is nonzero, else 0, as an int. Ints are used as they are
+// (branches test them against zero); a float is compared with 0.0.
+IROperand IRGenerator::truth_value(IROperand value, DataType type) {
+    if (type != DataType::FLOAT) return value;
+    IROperand result_temp = m_program->new_temporary(DataType::INT);
+    emit(IROp::CMP_NE, DataType::FLOAT, result_temp, value, zero(DataType::FLOAT));
+    return result_temp;
 }
 
 // This is the core of expression code generation.
-void IRGenerator::visit(const BinaryOpNode& node) {
-    // 1. Recursively generate code for the left-hand side.
-    // The result (e.g., a constant, or the name of a temporary "t0") will be in m_last_operand.
-    node.left->accept(*this);
-    IROperand left_operand = m_last_operand;
+void IRGenerator::emitBinaryOp(const AST& ast, NodeIndex node) {
+    // 1. Bring both operands to a common type: if either is a float, the
+    // operation is done on floats.
+    DataType left_type = ast.type(ast.lhs(node));
+    DataType right_type = ast.type(ast.rhs(node));
+    DataType operand_type = (left_type == DataType::FLOAT || right_type == DataType::FLOAT) ? DataType::FLOAT
+                                                                                            : DataType::INT;
+    IROperand left = convert(m_values[ast.lhs(node)], left_type, operand_type);
+    IROperand right = convert(m_values[ast.rhs(node)], right_type, operand_type);
 
-    // 2. Do the same for the right-hand side.
-    node.right->accept(*this);
-    IROperand right_operand = m_last_operand;
+    // 2. Create a new temporary to store the result of this operation.
+    IROp op = binary_op(ast.op(node));
+    IROperand result_temp = m_program->new_temporary(isComparison(op) ? DataType::INT : operand_type);
 
-    // 3. Create a new temporary variable to store the result of this operation.
-    std::string result_temp = new_temporary();
+    // 3. Emit the instruction. Both operands have already been generated.
+    emit(op, operand_type, result_temp, left, right);
 
-    // 4. Emit the instruction.
-    m_program.instructions.push_back({
-        node.op,          // The operator, e.g., TOKEN_PLUS
-        left_operand,     // The first argument
-        right_operand,    // The second argument
-        result_temp       // The destination
-    });
+    // 4. Record where this node's parent can find the result of this sub-expression.
+    m_values[node] = result_temp;
+}
 
-    // 5. Finally, update m_last_operand so that this node's parent
-    // knows where to find the result of this sub-expression.
-    m_last_operand = result_temp;
+// The IR has no unary instructions: `-x` becomes `0 - x` (`x * -1.0` for a
+// float, which also flips the sign of zero) and `!x` becomes `x == 0`.
+void IRGenerator::emitUnaryOp(const AST& ast, NodeIndex node) {
+    IROperand operand = m_values[ast.lhs(node)];
+    DataType operand_type = ast.type(ast.lhs(node));
+
+    if (ast.op(node) == TokenType::BANG) {
+        IROperand result_temp = m_program->new_temporary(DataType::INT);
+        emit(IROp::CMP_EQ, operand_type, result_temp, operand, zero(operand_type));
+        m_values[node] = result_temp;
+        return;
+    }
+    IROperand result_temp = m_program->new_temporary(operand_type);
+    if (operand_type == DataType::FLOAT) {
+        emit(IROp::MUL, DataType::FLOAT, result_temp, operand, float_constant(-1.0));
+    } else {
+        emit(IROp::SUB, DataType::INT, result_temp, int_constant(0), operand);
+    }
+    m_values[node] = result_temp;
 }
 
 // 'let' statements use the result of an expression.
-void IRGenerator::visit(const LetStatementNode& node) {
-    // 1. Generate all the code for the initializer expression.
-    // After this call, m_last_operand will hold the final result of the expression
-    // (e.g., a constant like 5, or a temporary like "t2").
-    node.initializer->accept(*this);
-
-    // 2. Emit one final assignment instruction to move the result into the variable.
-    m_program.instructions.push_back({
-        TokenType::EQUALS,  // Our "assignment" operator
-        m_last_operand,     // The source value
-        {},                 // Assignment only has one argument, so arg2 is empty.
-        node.name->name     // The destination variable
-    });
-}
-// In src/IRGenerator.cpp
-
-void IRGenerator::visit(const CastNode& node) {
-    // 1. First, generate the code for the expression being cast.
-    // The result will be in m_last_operand.
-    node.expression->accept(*this);
-    IROperand source_operand = m_last_operand;
-
-    // 2. Create a new temporary to hold the result of the cast.
-    std::string result_temp = new_temporary();
-
-    // 3. Emit the CAST instruction.
-    // We can store the target type in arg2 for the final code generator,
-    // but for now, we'll just emit the cast operation itself.
-    m_program.instructions.push_back({
-        TokenType::CAST,
-        source_operand,
-        {}, // Not a binary operation
-        result_temp
-    });
-
-    // 4. Update m_last_operand with the result of this cast.
-    m_last_operand = result_temp;
-}
-// In src/IRGenerator.cpp
-
-void IRGenerator::visit(const FunctionCallNode& node) {
-    // 1. Generate code for each argument and emit a PARAM instruction for it.
-    // We process arguments in reverse for some common calling conventions (like cdecl).
-    for (int i = node.arguments.size() - 1; i >= 0; --i) {
-        node.arguments[i]->accept(*this);
-        m_program.instructions.push_back({
-            TokenType::PARAM,
-            m_last_operand, // The result of the argument expression
-            {},
-            {}
-        });
-    }
-
-    // 2. Generate code for the callee itself (in case it's a complex expression).
-    node.callee->accept(*this);
-    IROperand callee_operand = m_last_operand;
+void IRGenerator::emitLet(const AST& ast, NodeIndex node) {
+    // The initializer has been evaluated before the name is (re)declared, so
+    // in `let x = x + 1;` the right-hand side still refers to any earlier x.
+    // A variable is always a temporary, so a constant initializer gets one
+    // copy; otherwise the name simply refers to the initializer's result.
+    IROperand value = m_values[ast.rhs(node)];
+    if (value.kind() != IROperand::TEMP) {
+        IROperand temp = m_program->new_temporary(ast.type(ast.rhs(node)));
+        emit(IROp::COPY, ast.type(ast.rhs(node)), temp, value);
+        value = temp;
+    }
+
+    auto [it, inserted] = m_variables.insert_or_assign(ast.name(node), value);
+    if (inserted) m_last_declared = ast.name(node);
+}
+
+// At the first node of a && or || node's right operand. The left operand's
+// value is known, so end the current block with a branch that skips the
+// right operand when the left one already decides the result. The merge
+// block doesn't exist yet (blocks are numbered in layout order, and the
+// right operand may create blocks of its own), so its edge is patched in by
+// emitLogicalOp().
+void IRGenerator::beginLogicalRhs(const AST& ast, NodeIndex node) {
+    BlockIndex decided = m_current_block;
+    IROperand condition = truth_value(m_values[ast.lhs(node)], ast.type(ast.lhs(node)));
+    BlockIndex rhs_block = m_program->add_block();
+    bool is_and = ast.op(node) == TokenType::AND_AND;
+
+    IRBlock& block = m_program->blocks[decided];
+    block.terminator = {IRTerminator::BRANCH, condition,
+                        {is_and ? rhs_block : NO_BLOCK, is_and ? NO_BLOCK : rhs_block}};
+    m_program->blocks[rhs_block].predecessors.push_back(decided);
+
+    m_logical_stack.push_back({node, decided});
+    m_current_block = rhs_block;
+}
+
+// `a && b` is `a ? (b != 0) : 0` and `a || b` is `a ? 1 : (b != 0)`; the two
+// paths meet in a new block with a phi.
+void IRGenerator::emitLogicalOp(const AST& ast, NodeIndex node) {
+    PendingLogical pending = m_logical_stack.back();
+    m_logical_stack.pop_back();
+    bool is_and = ast.op(node) == TokenType::AND_AND;
+
+    DataType rhs_type = ast.type(ast.rhs(node));
+    IROperand truth = m_program->new_temporary(DataType::INT);
+    emit(IROp::CMP_NE, rhs_type, truth, m_values[ast.rhs(node)], zero(rhs_type));
+
+    BlockIndex merge = m_program->add_block();
+    m_program->blocks[pending.decided].terminator.targets[is_and ? 1 : 0] = merge;
+    m_program->blocks[merge].predecessors.push_back(pending.decided);
+    m_program->jump(m_current_block, merge);
+
+    IROperand result = m_program->new_temporary(DataType::INT);
+    IRPhi phi(result, DataType::INT, m_program->memory());
+    phi.incoming.push_back(int_constant(is_and ? 0 : 1));
+    phi.incoming.push_back(truth);
+    m_program->blocks[merge].phis.push_back(std::move(phi));
+
+    m_current_block = merge;
+    m_values[node] = result;
+}
+
+void IRGenerator::emitCast(const AST& ast, NodeIndex node) {
+    // 1. Create a new temporary to hold the result of the cast.
+    IROperand result_temp = m_program->new_temporary(ast.type(node));
+
+    // 2. Emit the CAST instruction; its type is the target type.
+    emit(IROp::CAST, ast.type(node), result_temp, m_values[ast.lhs(node)]);
+
+    // 3. Record the result of this cast.
+    m_values[node] = result_temp;
+}
+
+void IRGenerator::emitFunctionCall(const AST& ast, NodeIndex node) {
+    NodeRange arguments = ast.arguments(node);
+    if (arguments.size() > UINT16_MAX) {
+        throw std::runtime_error("IR Error: Too many arguments in a function call.");
+    }
+
+    // 1. A function defined in the program takes each argument as the type
+    // of its parameter. The conversions all come first: a CALL's PARAMs
+    // immediately precede it.
+    NodeIndex callee = ast.lhs(node);
+    const IRProgram* function = nullptr;
+    if (ast.kind(callee) == NodeKind::IDENTIFIER && m_values[callee].kind() == IROperand::SYMBOL) {
+        auto it = m_function_indices.find(ast.name(callee));
+        if (it != m_function_indices.end()) function = &m_module.functions[it->second];
+    }
+    for (uint32_t i = 0; i < arguments.size(); ++i) {
+        if (function) {
+            m_values[arguments[i]] = convert(m_values[arguments[i]], ast.type(arguments[i]), function->parameters[i]);
+        }
+    }
+
+    // 2. The arguments have already been evaluated; emit a PARAM instruction
+    // for each one. We pass arguments in reverse for some common calling
+    // conventions (like cdecl).
+    for (int i = (int)arguments.size() - 1; i >= 0; --i) {
+        DataType type = function ? function->parameters[i] : ast.type(arguments[i]);
+        emit(IROp::PARAM, type, {}, m_values[arguments[i]]);
+    }
 
     // 3. Create a new temporary to hold the return value of the function.
-    std::string result_temp = new_temporary();
-    
-    // 4. Emit the CALL instruction. We'll store the number of arguments in arg2.
-    m_program.instructions.push_back({
-        TokenType::CALL,
-        callee_operand,                             // The function to call
-        (int)node.arguments.size(),                 // The number of params
-        result_temp                                 // Where the return value goes
-    });
+    IROperand result_temp = m_program->new_temporary(ast.type(node));
+
+    // 4. Emit the CALL instruction, recording how many PARAMs belong to it.
+    emit(IROp::CALL, ast.type(node), result_temp, m_values[ast.lhs(node)]);
+    m_program->blocks[m_current_block].instructions.back().count = (uint16_t)arguments.size();
 
     // 5. The result of this entire expression is the return value.
-    m_last_operand = result_temp;
-}
\ No newline at end of file
+    m_values[node] = result_temp;
+}
+
+// Exchanges the interning tables with the set-aside ones, on entering or
+// leaving a function.
+void IRGenerator::swapScopes() {
+    // All of them are in the session arena, so swapping is just a few pointers.
+    m_variables.swap(m_outer_variables);
+    m_symbol_indices.swap(m_outer_symbol_indices);
+    m_int_constants.swap(m_outer_int_constants);
+    m_float_constants.swap(m_outer_float_constants);
+}
+
+// At a function, before any statement of its body (see AST.h): starts its
+// IRProgram, whose entry block takes each parameter as an ARGUMENT.
+void IRGenerator::beginFunction(const AST& ast, NodeIndex node) {
+    NodeRange parameters = ast.parameters(node);
+    if (parameters.size() > UINT16_MAX) {
+        throw std::runtime_error("IR Error: Too many parameters in a function.");
+    }
+
+    m_outer_block = m_current_block;
+    m_outer_last_declared = m_last_declared;
+    swapScopes();
+    m_variables.clear();
+    m_symbol_indices.clear();
+    m_int_constants.clear();
+    m_float_constants.clear();
+
+    // The body may call the function itself.
+    m_function_indices.emplace(ast.name(node), (uint32_t)m_module.functions.size());
+    m_program = &m_module.add_function(ast.name(node));
+    m_current_block = m_program->add_block();
+    for (uint32_t i = 0; i < parameters.size(); ++i) {
+        DataType type = ast.type(parameters[i]);
+        IROperand value = m_program->new_temporary(type);
+        m_program->parameters.push_back(type);
+        emit(IROp::ARGUMENT, type, value, {});
+        m_program->blocks[m_current_block].instructions.back().count = (uint16_t)i;
+        m_variables[ast.name(parameters[i])] = value;
+    }
+}
+
+// Ends the function with its value, as the return type, and goes back to
+// the top level.
+void IRGenerator::emitReturn(const AST& ast, NodeIndex node) {
+    NodeIndex function = ast.rhs(node);
+    IROperand value = convert(m_values[ast.lhs(node)], ast.type(ast.lhs(node)), ast.type(function));
+    m_program->blocks[m_current_block].terminator = {IRTerminator::RETURN, value, {NO_BLOCK, NO_BLOCK}};
+
+    swapScopes();
+    m_program = &m_module.functions[0];
+    m_current_block = m_outer_block;
+    m_last_declared = m_outer_last_declared;
+}
@@ -1,37 +1,109 @@
 #pragma once
 
 #include "AST.h"
+#include "Arena.h"
 #include "IR.h"
+#include <memory_resource>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
 
-// This visitor walks the AST and generates a linear sequence of Three-Address Code.
-class IRGenerator : public ASTVisitor {
+// This pass walks the AST and generates Three-Address Code in SSA form,
+// organized into basic blocks.
+//
+// Every 'let' is a statement of the top level or of a function body, never
+// nested deeper, so each variable's definition dominates everything after it
+// in its scope: the generator simply remembers which temporary currently
+// holds each name. Control flow only comes from the short-circuit operators
+// && and ||, which split the current block and merge their two outcomes
+// with a phi.
+//
+// Each function definition becomes an IRProgram of its own in the module
+// (see IRModule in IR.h). Its parameters are ARGUMENT instructions at the
+// start of its entry block, and its return statement ends its last block.
+class IRGenerator {
 public:
-    IRProgram generate(const std::vector<std::unique_ptr<StatementNode>>& statements);
-
-    // We only need to visit nodes that generate code.
-    void visit(const LetStatementNode& node) override;
-    void visit(const ExpressionStatementNode& node) override;
-    void visit(const BinaryOpNode& node) override;
-    void visit(const IntegerLiteralNode& node) override;
-    void visit(const FloatLiteralNode& node) override;
-    void visit(const IdentifierNode& node) override;
-    void visit(const CastNode& node) override;
-    void visit(const FunctionCallNode& node) override;
-
-    // We don't have these yet, but for completeness
-    // void visit(const FunctionCallNode& node) override {}
-    // void visit(const CastNode& node) override {}
-    // void visit(const BlockStatementNode& node) override {}
-    // void visit(const IfStatementNode& node) override {}
-    // void visit(const WhileStatementNode& node) override {}
+    // Instructions and the top level's tables are allocated from the session
+    // arena; each function's from an arena of its own.
+    explicit IRGenerator(Arena& arena);
+
+    // Generates the whole program in `ast`.
+    IRModule generate(const AST& ast);
+
+    // Incremental generation, for a program that arrives a few statements at
+    // a time (see Pipeline.h): each call to add() appends the code for the
+    // statements in `ast`, which follow those of the previous calls, and
+    // finish() returns the completed program. Nothing refers to an AST
+    // after add() returns, so it can be freed right away.
+    void add(const AST& ast);
+    IRModule finish();
 
 private:
-    IRProgram m_program;
-    int m_temp_counter = 0;
+    IRModule m_module;
+    IRProgram* m_program;           // The part being generated: the top level, or a function
+    BlockIndex m_current_block = 0; // Where new instructions go
+
+    // Where the result of each expression node can be found once its code has
+    // been emitted: a constant, a symbol or a temporary.
+    std::pmr::vector<IROperand> m_values;
+
+    // Interning tables, so each name and literal gets exactly one index.
+    std::pmr::unordered_map<std::string_view, IROperand> m_variables; // Current value of each name
+    std::pmr::unordered_map<std::string_view, uint32_t> m_symbol_indices;
+    std::pmr::unordered_map<long long, uint32_t> m_int_constants;
+    std::pmr::unordered_map<uint64_t, uint32_t> m_float_constants; // Keyed by the double's bits
+
+    // The most recently declared name. The program exits with its value.
+    std::string_view m_last_declared;
+
+    // Each function defined so far, by its index in the module.
+    std::pmr::unordered_map<std::string_view, uint32_t> m_function_indices;
+
+    // The top level's state, set aside while a function is generated. The
+    // interning tables are swapped with these, so both sets keep their
+    // buckets from one function to the next.
+    std::pmr::unordered_map<std::string_view, IROperand> m_outer_variables;
+    std::pmr::unordered_map<std::string_view, uint32_t> m_outer_symbol_indices;
+    std::pmr::unordered_map<long long, uint32_t> m_outer_int_constants;
+    std::pmr::unordered_map<uint64_t, uint32_t> m_outer_float_constants;
+    BlockIndex m_outer_block = 0;
+    std::string_view m_outer_last_declared;
+
+    // --- Short-circuit operators ---
+    // For each && or || node, the first node (in post-order) of its right
+    // operand is marked, so the walk knows where to split the block.
+    std::pmr::vector<NodeIndex> m_short_circuit_at; // Empty if the program has none
+
+    // A && or || whose right operand is being generated.
+    struct PendingLogical {
+        NodeIndex node;
+        BlockIndex decided; // Ends with the branch on the left operand
+    };
+    std::vector<PendingLogical> m_logical_stack;
+
+    // Helpers that hand out operands.
+    IROperand int_constant(long long value);
+    IROperand float_constant(double value);
+    IROperand resolve_name(std::string_view name);
+    IROperand zero(DataType type);
+
+    // Helpers that emit conversions.
+    IROperand convert(IROperand value, DataType from, DataType to);
+    IROperand truth_value(IROperand value, DataType type);
+
+    void emit(IROp op, DataType type, IROperand result, IROperand arg1, IROperand arg2 = {});
 
-    // Helper to create new temporary variable names like "t0", "t1", etc.
-    std::string new_temporary();
+    void findShortCircuits(const AST& ast);
 
-    // When visiting an expression, the result of that expression will be stored here.
-    IROperand m_last_operand;
-};
\ No newline at end of file
+    // One handler per node kind that generates code.
+    void emitLet(const AST& ast, NodeIndex node);
+    void emitUnaryOp(const AST& ast, NodeIndex node);
+    void emitBinaryOp(const AST& ast, NodeIndex node);
+    void beginLogicalRhs(const AST& ast, NodeIndex node);
+    void emitLogicalOp(const AST& ast, NodeIndex node);
+    void emitCast(const AST& ast, NodeIndex node);
+    void emitFunctionCall(const AST& ast, NodeIndex node);
+    void beginFunction(const AST& ast, NodeIndex node);
+    void emitReturn(const AST& ast, NodeIndex node);
+    void swapScopes();
+};
@@ -0,0 +1,228 @@
+#include "Bytecode.h"
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <stdexcept>
+#include <vector>
+
+// --- Native functions ---
+
+// runtime.c's functions, built in so a program runs without a C toolchain.
+static int my_func(int a, double b) {
+    return a + (int)b;
+}
+
+NativeTable::NativeTable() {
+    add("my_func", reinterpret_cast<void*>(&my_func));
+}
+
+// A native function called with every argument slot filled. Under the
+// System V ABI the integer and float registers are assigned independently,
+// and the stack arguments follow in order whatever their type, so a
+// function with any mix of long and double parameters that fit the slots
+// finds its arguments where this signature puts them; it ignores the rest.
+using IntFunction = int64_t (*)(int64_t, int64_t, int64_t, int64_t, int64_t, int64_t,
+                                double, double, double, double, double, double, double, double);
+using FloatFunction = double (*)(int64_t, int64_t, int64_t, int64_t, int64_t, int64_t,
+                                 double, double, double, double, double, double, double, double);
+using IntFunctionWithStack = int64_t (*)(int64_t, int64_t, int64_t, int64_t, int64_t, int64_t,
+                                         double, double, double, double, double, double, double, double,
+                                         int64_t, int64_t, int64_t, int64_t, int64_t, int64_t, int64_t, int64_t);
+using FloatFunctionWithStack = double (*)(int64_t, int64_t, int64_t, int64_t, int64_t, int64_t,
+                                          double, double, double, double, double, double, double, double,
+                                          int64_t, int64_t, int64_t, int64_t, int64_t, int64_t, int64_t, int64_t);
+static_assert(BytecodeProgram::INT_SLOTS == 6 && BytecodeProgram::FLOAT_SLOTS == 8 && BytecodeProgram::STACK_SLOTS == 8,
+              "The native call signatures spell out every slot");
+
+template <typename Result, typename Function, typename FunctionWithStack>
+static Result call_native(void* address, const BytecodeValue* args, bool uses_stack) {
+    const BytecodeValue* d = args + BytecodeProgram::INT_SLOTS;
+    if (!uses_stack) {
+        return reinterpret_cast<Function>(address)(args[0].i, args[1].i, args[2].i, args[3].i, args[4].i, args[5].i,
+                                                   d[0].f, d[1].f, d[2].f, d[3].f, d[4].f, d[5].f, d[6].f, d[7].f);
+    }
+    const BytecodeValue* s = d + BytecodeProgram::FLOAT_SLOTS;
+    return reinterpret_cast<FunctionWithStack>(address)(args[0].i, args[1].i, args[2].i, args[3].i, args[4].i, args[5].i,
+                                                        d[0].f, d[1].f, d[2].f, d[3].f, d[4].f, d[5].f, d[6].f, d[7].f,
+                                                        s[0].i, s[1].i, s[2].i, s[3].i, s[4].i, s[5].i, s[6].i, s[7].i);
+}
+
+// --- The interpreter ---
+// Threaded dispatch: every handler ends by jumping straight to the next
+// instruction's handler through a table of label addresses (a GNU
+// extension), instead of going back to a central switch. Each handler then
+// has its own indirect branch, which the CPU predicts separately.
+//
+// The register files of the functions being run sit one after another in
+// one growing stack, so a call allocates nothing once the stack is deep
+// enough; `r` points at the current function's.
+
+int64_t run_bytecode(const BytecodeProgram& program) {
+    // A call waiting for its function to return.
+    struct Frame {
+        const BytecodeInstr* call; // The CALL_FUNCTION, whose dst receives the result
+        size_t base;               // The caller's register file, in `stack`
+        size_t top;                // Just past it
+    };
+    const BytecodeProgram::Function& top_level = program.functions[0];
+    std::vector<BytecodeValue> stack(program.registers.begin() + top_level.first_register,
+                                     program.registers.begin() + top_level.first_register + top_level.register_count);
+    std::vector<Frame> frames;
+    size_t base = 0;
+    size_t top = stack.size();
+    BytecodeValue* r = stack.data();
+    std::vector<BytecodeValue> argument_area(program.argument_slots);
+    BytecodeValue* args = argument_area.data();
+    BytecodeValue result;
+    void* const* natives = program.natives.data();
+    const BytecodeInstr* pc = program.code.data();
+
+    // In BytecodeOp order.
+    static const void* const HANDLERS[] = {
+        &&MOVE, &&ADD_INT, &&SUB_INT, &&MUL_INT, &&DIV_INT,
+        &&ADD_FLOAT, &&SUB_FLOAT, &&MUL_FLOAT, &&DIV_FLOAT,
+        &&EQ_INT, &&NE_INT, &&LT_INT, &&LE_INT, &&GT_INT, &&GE_INT,
+        &&EQ_FLOAT, &&NE_FLOAT, &&LT_FLOAT, &&LE_FLOAT, &&GT_FLOAT, &&GE_FLOAT,
+        &&INT_TO_FLOAT, &&FLOAT_TO_INT, &&ARG, &&CALL_INT, &&CALL_FLOAT, &&CALL_FUNCTION, &&ARGUMENT,
+        &&JUMP, &&JUMP_IF_TRUE, &&JUMP_IF_FALSE, &&RETURN_INT, &&RETURN_FLOAT,
+    };
+    static_assert(std::size(HANDLERS) == (size_t)BytecodeOp::COUNT, "Every opcode needs a handler");
+
+#define DISPATCH() goto* HANDLERS[(size_t)pc->op]
+#define NEXT()   \
+    do {         \
+        ++pc;    \
+        DISPATCH(); \
+    } while (0)
+// Integer arithmetic wraps around, so it is done on unsigned values.
+#define INT_BINARY(op) \
+    r[pc->dst].i = (int64_t)((uint64_t)r[pc->a].i op (uint64_t)r[pc->b].i); \
+    NEXT()
+#define FLOAT_BINARY(op) \
+    r[pc->dst].f = r[pc->a].f op r[pc->b].f; \
+    NEXT()
+#define COMPARE(field, op) \
+    r[pc->dst].i = r[pc->a].field op r[pc->b].field; \
+    NEXT()
+
+    DISPATCH();
+
+MOVE:
+    r[pc->dst] = r[pc->a];
+    NEXT();
+ADD_INT:
+    INT_BINARY(+);
+SUB_INT:
+    INT_BINARY(-);
+MUL_INT:
+    INT_BINARY(*);
+DIV_INT: {
+    int64_t x = r[pc->a].i;
+    int64_t y = r[pc->b].i;
+    if (y == 0 || (x == INT64_MIN && y == -1)) {
+        throw std::runtime_error(y == 0 ? "Runtime Error: division by zero." : "Runtime Error: division overflow.");
+    }
+    r[pc->dst].i = x / y;
+    NEXT();
+}
+ADD_FLOAT:
+    FLOAT_BINARY(+);
+SUB_FLOAT:
+    FLOAT_BINARY(-);
+MUL_FLOAT:
+    FLOAT_BINARY(*);
+DIV_FLOAT:
+    FLOAT_BINARY(/);
+EQ_INT:
+    COMPARE(i, ==);
+NE_INT:
+    COMPARE(i, !=);
+LT_INT:
+    COMPARE(i, <);
+LE_INT:
+    COMPARE(i, <=);
+GT_INT:
+    COMPARE(i, >);
+GE_INT:
+    COMPARE(i, >=);
+EQ_FLOAT:
+    COMPARE(f, ==);
+NE_FLOAT:
+    COMPARE(f, !=);
+LT_FLOAT:
+    COMPARE(f, <);
+LE_FLOAT:
+    COMPARE(f, <=);
+GT_FLOAT:
+    COMPARE(f, >);
+GE_FLOAT:
+    COMPARE(f, >=);
+INT_TO_FLOAT:
+    r[pc->dst].f = (double)r[pc->a].i;
+    NEXT();
+FLOAT_TO_INT:
+    r[pc->dst].i = truncate_to_int(r[pc->a].f);
+    NEXT();
+ARG:
+    args[pc->dst] = r[pc->a];
+    NEXT();
+CALL_INT:
+    r[pc->dst].i = call_native<int64_t, IntFunction, IntFunctionWithStack>(natives[pc->a], args, pc->b != 0);
+    NEXT();
+CALL_FLOAT:
+    r[pc->dst].f = call_native<double, FloatFunction, FloatFunctionWithStack>(natives[pc->a], args, pc->b != 0);
+    NEXT();
+CALL_FUNCTION: {
+    const BytecodeProgram::Function& function = program.functions[pc->a];
+    frames.push_back({pc, base, top});
+    base = top;
+    top = base + function.register_count;
+    if (stack.size() < top) stack.resize(std::max(top, 2 * stack.size()));
+    std::copy_n(program.registers.begin() + function.first_register, function.register_count, stack.begin() + base);
+    r = stack.data() + base;
+    pc = program.code.data() + function.entry;
+    DISPATCH();
+}
+ARGUMENT:
+    r[pc->dst] = args[pc->a];
+    NEXT();
+JUMP:
+    pc = program.code.data() + pc->a;
+    DISPATCH();
+JUMP_IF_TRUE:
+    if (r[pc->a].i != 0) {
+        pc = program.code.data() + pc->b;
+        DISPATCH();
+    }
+    NEXT();
+JUMP_IF_FALSE:
+    if (r[pc->a].i == 0) {
+        pc = program.code.data() + pc->b;
+        DISPATCH();
+    }
+    NEXT();
+RETURN_INT:
+    if (frames.empty()) return r[pc->a].i;
+    result = r[pc->a];
+    goto RETURN_TO_CALLER;
+RETURN_FLOAT:
+    if (frames.empty()) return truncate_to_int(r[pc->a].f);
+    result = r[pc->a];
+    goto RETURN_TO_CALLER;
+RETURN_TO_CALLER: {
+    Frame frame = frames.back();
+    frames.pop_back();
+    base = frame.base;
+    top = frame.top;
+    r = stack.data() + base;
+    pc = frame.call;
+    r[pc->dst] = result;
+    NEXT();
+}
+
+#undef COMPARE
+#undef FLOAT_BINARY
+#undef INT_BINARY
+#undef NEXT
+#undef DISPATCH
+}
@@ -0,0 +1,124 @@
+#include "Jit.h"
+#include "X86Encoder.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <dlfcn.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+JitSymbols::~JitSymbols() {
+    for (void* library : m_libraries) dlclose(library);
+}
+
+void JitSymbols::open(const std::string& path) {
+    void* library = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (!library) {
+        throw std::runtime_error("JIT Error: could not load '" + path + "': " + dlerror());
+    }
+    m_libraries.push_back(library);
+}
+
+void* JitSymbols::find(std::string_view name) const {
+    std::string symbol(name); // dlsym wants a terminated string
+    for (void* library : m_libraries) {
+        if (void* address = dlsym(library, symbol.c_str())) return address;
+    }
+    return dlsym(RTLD_DEFAULT, symbol.c_str());
+}
+
+// jmp qword [rip + 2], two int3s of padding, then the 8-byte address.
+static constexpr uint8_t STUB_JUMP[] = {0xFF, 0x25, 0x02, 0x00, 0x00, 0x00, 0xCC, 0xCC};
+static constexpr size_t STUB_SIZE = 16;
+
+static size_t align_up(size_t value, size_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+JitCode JitCode::load(const MachineCode& code, const JitSymbols& symbols) {
+    EncodedCode encoded = encode_x86(code);
+
+    // --- Layout: code, then the stubs, then the literals ---
+    size_t stubs_offset = align_up(encoded.text.size(), STUB_SIZE);
+    size_t literals_offset = stubs_offset + STUB_SIZE * code.symbols.size();
+    size_t end = literals_offset + sizeof(uint64_t) * code.literals.size();
+    size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+
+    JitCode jit;
+    jit.m_size = align_up(std::max<size_t>(end, 1), page_size);
+    void* memory = mmap(nullptr, jit.m_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+        throw std::runtime_error(std::string("JIT Error: could not map memory: ") + std::strerror(errno));
+    }
+    jit.m_memory = memory;
+    uint8_t* base = static_cast<uint8_t*>(memory);
+
+    std::memcpy(base, encoded.text.data(), encoded.text.size());
+    std::memset(base + encoded.text.size(), 0xCC, stubs_offset - encoded.text.size());
+    std::vector<void*> functions(code.symbols.size());
+    for (size_t i = 0; i < code.symbols.size(); ++i) {
+        functions[i] = symbols.find(code.symbols[i]);
+        if (!functions[i]) {
+            throw std::runtime_error("JIT Error: undefined function '" + std::string(code.symbols[i]) + "'.");
+        }
+        uint8_t* stub = base + stubs_offset + STUB_SIZE * i;
+        std::memcpy(stub, STUB_JUMP, sizeof(STUB_JUMP));
+        std::memcpy(stub + sizeof(STUB_JUMP), &functions[i], sizeof(void*));
+    }
+    std::memcpy(base + literals_offset, code.literals.data(), sizeof(uint64_t) * code.literals.size());
+
+    // --- Relocations ---
+    for (const CodeRelocation& relocation : encoded.relocations) {
+        uint8_t* field = base + relocation.offset;
+        uintptr_t target;
+        if (relocation.kind == CodeRelocation::LITERAL) {
+            target = (uintptr_t)(base + literals_offset + sizeof(uint64_t) * relocation.index);
+        } else {
+            target = (uintptr_t)functions[relocation.index];
+            int64_t direct = (int64_t)(target + relocation.addend - (uintptr_t)field);
+            if (direct != (int32_t)direct) {
+                target = (uintptr_t)(base + stubs_offset + STUB_SIZE * relocation.index);
+            }
+        }
+        int32_t value = (int32_t)(int64_t)(target + relocation.addend - (uintptr_t)field);
+        std::memcpy(field, &value, sizeof(value));
+    }
+
+    if (mprotect(memory, jit.m_size, PROT_READ | PROT_EXEC) != 0) {
+        throw std::runtime_error(std::string("JIT Error: could not make the code executable: ") + std::strerror(errno));
+    }
+    return jit;
+}
+
+JitCode::JitCode(JitCode&& other) noexcept {
+    *this = std::move(other);
+}
+
+JitCode& JitCode::operator=(JitCode&& other) noexcept {
+    if (this != &other) {
+        release();
+        m_memory = other.m_memory;
+        m_size = other.m_size;
+        other.m_memory = nullptr;
+        other.m_size = 0;
+    }
+    return *this;
+}
+
+JitCode::~JitCode() {
+    release();
+}
+
+void JitCode::release() {
+    if (m_memory) {
+        munmap(m_memory, m_size);
+        m_memory = nullptr;
+    }
+    m_size = 0;
+}
+
+int64_t JitCode::run() const {
+    auto entry = reinterpret_cast<int64_t (*)()>(m_memory);
+    return entry();
+}
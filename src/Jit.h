@@ -0,0 +1,61 @@
+#pragma once
+
+#include "MachineCode.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Where the JIT finds the external functions a program calls: in the
+// shared libraries added with open() (e.g. a runtime.so built from
+// runtime.c), in order, then in the compiler's own process.
+class JitSymbols {
+public:
+    JitSymbols() = default;
+    JitSymbols(const JitSymbols&) = delete;
+    JitSymbols& operator=(const JitSymbols&) = delete;
+    ~JitSymbols();
+
+    // Loads a shared library. Throws std::runtime_error if it can't be loaded.
+    void open(const std::string& path);
+
+    // The address of `name`, or nullptr if nothing defines it.
+    void* find(std::string_view name) const;
+
+private:
+    std::vector<void*> m_libraries; // dlopen handles
+};
+
+// A program encoded into executable memory in the compiler's own process,
+// so it can be run without writing, assembling or linking anything.
+//
+// The code, a stub per external function and the float literals share one
+// mapping, which is written first and then made read-only and executable.
+// A call goes straight to its function when that is within reach of a
+// rel32, and otherwise through the function's stub (jmp [rip + address]).
+class JitCode {
+public:
+    // Encodes `code`, which must have been generated with
+    // CodeGenOptions::callable, and resolves its calls with `symbols`.
+    // Throws std::runtime_error for a function nothing defines.
+    static JitCode load(const MachineCode& code, const JitSymbols& symbols);
+
+    JitCode(JitCode&& other) noexcept;
+    JitCode& operator=(JitCode&& other) noexcept;
+    JitCode(const JitCode&) = delete;
+    JitCode& operator=(const JitCode&) = delete;
+    ~JitCode();
+
+    // Runs the program and returns its result, the value a native build
+    // would exit with (before the kernel truncates it to 8 bits).
+    int64_t run() const;
+
+    size_t size() const { return m_size; }
+
+private:
+    JitCode() = default;
+    void release();
+
+    void* m_memory = nullptr;
+    size_t m_size = 0; // Of the mapping
+};
@@ -1,25 +1,41 @@
 #include "Lexer.h"
-#include <map>
+#include "CharClass.h"
+#include "CharScan.h"
+#include <charconv>
 
-// Keywords mapping
-static const std::map<std::string, TokenType> keywords = {
-    {"let", TokenType::LET}
-};
+// Character classification, punctuation and keyword lookup all go through the
+// compile-time tables in CharClass.h. Runs of whitespace, identifier
+// characters and digits are skipped with the vectorized scanners in CharScan.h.
 
-Lexer::Lexer(const std::string& source) : m_source(source) {}
+Lexer::Lexer(std::string_view source, Arena& arena)
+    : m_arena(arena), m_source(source) {}
 
-std::vector<Token> Lexer::tokenize() {
-    std::vector<Token> tokens;
-    while (!isAtEnd()) {
-        m_start = m_current;
-        Token token = scanToken();
+Lexer::Lexer(std::string_view source, Arena& arena, size_t begin, size_t end)
+    : m_arena(arena), m_source(source.substr(0, end)), m_start(begin), m_current(begin) {}
+
+TokenList Lexer::tokenize() {
+    TokenList tokens(&m_arena);
+    // Most tokens are a few characters long; reserving up front avoids
+    // leaving a trail of abandoned buffers in the arena as the vector grows.
+    tokens.reserve((m_source.length() - m_current) / 4 + 1);
+    while (true) {
+        Token token = next();
         tokens.push_back(token);
+        if (token.type == TokenType::END_OF_FILE) break; // One final EOF token
     }
-    // Add one final EOF token
-    tokens.push_back({TokenType::END_OF_FILE, "", m_line, (int)m_source.length()});
     return tokens;
 }
 
+Token Lexer::next() {
+    m_token_count++;
+    if (isAtEnd()) {
+        m_start = m_current = m_source.length();
+        return makeToken(TokenType::END_OF_FILE);
+    }
+    m_start = m_current;
+    return scanToken(); // Returns END_OF_FILE if only whitespace was left
+}
+
 bool Lexer::isAtEnd() const{
     return m_current >= m_source.length();
 }
@@ -31,31 +47,42 @@ char Lexer::advance() {
 }
 
 Token Lexer::makeToken(TokenType type) {
-    std::string lexeme = m_source.substr(m_start, m_current - m_start);
-    return {type, lexeme, m_line, (int)m_start};
+    size_t length = m_current - m_start;
+    Token token;
+    token.offset = (uint32_t)m_start;
+    token.length = (uint16_t)length;
+    token.type = type;
+    token.reserved = 0;
+    token.int_value = 0;
+    // Lexemes longer than a token can describe are reported as errors.
+    if (length > UINT16_MAX) {
+        token.length = UINT16_MAX;
+        token.type = TokenType::UNKNOWN;
+    }
+    return token;
 }
 
-Token Lexer::makeErrorToken(const std::string& message) {
-    return {TokenType::UNKNOWN, message, m_line, (int)m_start};
+// The lexeme of an error token is the text that could not be recognized.
+Token Lexer::makeErrorToken() {
+    return makeToken(TokenType::UNKNOWN);
 }
 
+// Lines aren't tracked here; SourceBuffer::locate() recovers them from token
+// offsets when needed, so newlines are just more whitespace.
 void Lexer::skipWhitespace() {
-    while (true) {
-        char c = m_source[m_current];
-        switch (c) {
-            case ' ':
-            case '\r':
-            case '\t':
-                advance();
-                break;
-            case '\n':
-                m_line++;
-                advance();
-                break;
-            default:
-                return;
-        }
+    m_current = scanRun(char_scanners().spaces, m_current, CHAR_SPACE);
+}
+
+size_t Lexer::scanRun(const char* (*scanner)(const char*, const char*), size_t from, uint8_t charClass) const {
+    // Most runs are only a character or two long (a single space, a short
+    // name, a small number). Check those directly through the class table
+    // and only hand longer runs to the vector scanner.
+    const char* data = m_source.data();
+    size_t length = m_source.length();
+    for (size_t i = 0; i < 2; ++i, ++from) {
+        if (from >= length || !is_char_class(data[from], charClass)) return from;
     }
+    return scanner(data + from, data + length) - data;
 }
 char Lexer::peek() const {
     if (m_current >= m_source.length()) return '\0'; // Return null terminator if at the end
@@ -67,31 +94,37 @@ char Lexer::peekNext() const {
     if (m_current + 1 >= m_source.length()) return '\0';
     return m_source[m_current + 1];
 }
+// Numbers are decoded here, once, with std::from_chars, so the parser can
+// take the value straight from the token.
 Token Lexer::scanNumber() {
-    while (isdigit(peek())) advance();
+    m_current = scanRun(char_scanners().digits, m_current, CHAR_DIGIT);
+
+    const char* first = m_source.data() + m_start;
 
     // Look for a fractional part.
-    if (peek() == '.' && isdigit(peekNext())) {
+    if (peek() == '.' && is_char_class(peekNext(), CHAR_DIGIT)) {
         // Consume the "."
         advance();
 
-        while (isdigit(peek())) advance();
-        return makeToken(TokenType::FLOAT_LITERAL);
+        m_current = scanRun(char_scanners().digits, m_current, CHAR_DIGIT);
+        Token token = makeToken(TokenType::FLOAT_LITERAL);
+        auto result = std::from_chars(first, m_source.data() + m_current, token.float_value);
+        if (result.ec != std::errc()) return makeErrorToken();
+        return token;
     }
 
-    return makeToken(TokenType::INTEGER_LITERAL);
+    Token token = makeToken(TokenType::INTEGER_LITERAL);
+    auto result = std::from_chars(first, m_source.data() + m_current, token.int_value);
+    if (result.ec != std::errc()) return makeErrorToken(); // Doesn't fit in 64 bits
+    return token;
 }
 
 Token Lexer::identifier() {
-    while (isalnum(m_source[m_current]) || m_source[m_current] == '_') advance();
+    m_current = scanRun(char_scanners().identifier, m_current, CHAR_IDENT);
 
-    std::string text = m_source.substr(m_start, m_current - m_start);
-    auto it = keywords.find(text);
-    if (it != keywords.end()) {
-        return makeToken(it->second); // It's a keyword
-    }
-
-    return makeToken(TokenType::IDENTIFIER);
+    // Either a keyword (found through the perfect hash) or an IDENTIFIER.
+    std::string_view text = m_source.substr(m_start, m_current - m_start);
+    return makeToken(lookup_keyword(text));
 }
 
 
@@ -102,27 +135,18 @@ Token Lexer::scanToken() {
     if (isAtEnd()) return makeToken(TokenType::END_OF_FILE);
 
     char c = advance();
-
-    if (isalpha(c) || c == '_') return identifier();
-    if (isdigit(c)) return scanNumber(); // Make sure this calls scanNumber()
-
-    switch (c) {
-        case '(': return makeToken(TokenType::LEFT_PAREN);
-        case ')': return makeToken(TokenType::RIGHT_PAREN);
-        case '{': return makeToken(TokenType::LEFT_BRACE);
-        case '}': return makeToken(TokenType::RIGHT_BRACE);
-        case '[': return makeToken(TokenType::LEFT_BRACKET);
-        case ']': return makeToken(TokenType::RIGHT_BRACKET);
-        case ',': return makeToken(TokenType::COMMA);
-        case '.': return makeToken(TokenType::DOT);
-        case ':': return makeToken(TokenType::COLON);
-        case ';': return makeToken(TokenType::SEMICOLON);
-        case '=': return makeToken(TokenType::EQUALS);
-        case '+': return makeToken(TokenType::PLUS);
-        case '-': return makeToken(TokenType::MINUS);
-        case '*': return makeToken(TokenType::STAR);
-        case '/': return makeToken(TokenType::SLASH);
+    uint8_t charClass = CHAR_CLASSES[(unsigned char)c];
+
+    if (charClass & CHAR_IDENT_START) return identifier();
+    if (charClass & CHAR_DIGIT) return scanNumber();
+    if (charClass & CHAR_PAIR) {
+        TokenType pair = punctuation_pair(c, peek());
+        if (pair != TokenType::UNKNOWN) {
+            advance();
+            return makeToken(pair);
+        }
     }
+    if (charClass & CHAR_PUNCT) return makeToken(PUNCTUATION_TOKENS[(unsigned char)c]);
 
-    return makeErrorToken("Unexpected character.");
+    return makeErrorToken(); // Unexpected character.
 }
\ No newline at end of file
@@ -1,33 +1,65 @@
 #pragma once
 
-#include <string>
+#include <memory_resource>
+#include <string_view>
 #include <vector>
+#include "Arena.h"
+#include "ThreadPool.h"
 #include "Token.h"
 
+// Token lists live in the compilation-session arena.
+using TokenList = std::pmr::vector<Token>;
+
 class Lexer {
 public:
-    // Constructor: takes the source code to be tokenized
-    Lexer(const std::string& source);
+    // Constructor: takes the source code to be tokenized. The text is not
+    // copied; tokens refer to it by offset, so it must outlive them.
+    Lexer(std::string_view source, Arena& arena);
+
+    // Tokenizes only the characters in [begin, end) of `source`. Token
+    // offsets are still relative to the start of `source`.
+    Lexer(std::string_view source, Arena& arena, size_t begin, size_t end);
 
     // The main function that generates all tokens from the source
-    std::vector<Token> tokenize();
+    TokenList tokenize();
+
+    // Streaming interface: scans and returns just the next token. Once the
+    // source is exhausted, every further call returns END_OF_FILE.
+    Token next();
+
+    // How many tokens have been produced so far, in either mode.
+    size_t tokenCount() const { return m_token_count; }
 
 private:
-    std::string m_source;
+    Arena& m_arena;
+    std::string_view m_source;
     size_t m_start = 0;
     size_t m_current = 0;
-    int m_line = 1;
+    size_t m_token_count = 0;
 
     // Helper methods
     bool isAtEnd() const;
     char advance();
     Token makeToken(TokenType type);
-    Token makeErrorToken(const std::string& message);
+    Token makeErrorToken();
     void skipWhitespace();
     Token scanToken();
     Token identifier();
     Token scanNumber();
     char peek() const;                      // Safely look at the current character
     char peekNext() const;                  // Safely look at the next character
-    Token number();
-};
\ No newline at end of file
+
+    // Skips the run of `charClass` characters starting at `from`, using a
+    // CharScanners function for long runs, and returns where the run ends.
+    size_t scanRun(const char* (*scanner)(const char*, const char*), size_t from, uint8_t charClass) const;
+};
+
+// Tokenizes `source` on a thread pool and returns exactly the tokens that
+// Lexer::tokenize() would.
+//
+// The source is split into chunks right after a ';'. No token can contain a
+// ';', so every chunk starts at a token boundary (possibly after whitespace).
+// Chunks are lexed concurrently into their own arenas and then concatenated
+// in order into one list in `arena`. Tokens store absolute offsets, so no
+// line or column fix-up is needed when stitching.
+TokenList tokenize_parallel(std::string_view source, Arena& arena, ThreadPool& pool);
@@ -0,0 +1,503 @@
+#include "MachineCode.h"
+#include <algorithm>
+#include <charconv>
+#include <string>
+#include <unordered_map>
+
+static const char* register_name32(Register reg) {
+    static const char* const NAMES[] = {
+        "eax", "ecx", "edx", "ebx", "esp", "ebp", "esi", "edi",
+        "r8d", "r9d", "r10d", "r11d", "r12d", "r13d", "r14d", "r15d",
+    };
+    return NAMES[(int)reg];
+}
+
+static const char* register_name8(Register reg) {
+    static const char* const NAMES[] = {
+        "al", "cl", "dl", "bl", "spl", "bpl", "sil", "dil",
+        "r8b", "r9b", "r10b", "r11b", "r12b", "r13b", "r14b", "r15b",
+    };
+    return NAMES[(int)reg];
+}
+
+static const char* condition_suffix(Condition condition) {
+    switch (condition) {
+        case Condition::EQ: return "e";
+        case Condition::NE: return "ne";
+        case Condition::LT: return "l";
+        case Condition::LE: return "le";
+        case Condition::GT: return "g";
+        case Condition::GE: return "ge";
+        case Condition::A:  return "a";
+        case Condition::AE: return "ae";
+        case Condition::P:  return "p";
+        case Condition::NP: return "np";
+    }
+    return "?";
+}
+
+static const char* mnemonic(MachineOp op) {
+    switch (op) {
+        case MachineOp::MOV:     return "mov";
+        case MachineOp::MOVZX:   return "movzx";
+        case MachineOp::LEA:     return "lea";
+        case MachineOp::ADD:     return "add";
+        case MachineOp::SUB:     return "sub";
+        case MachineOp::IMUL:    return "imul";
+        case MachineOp::IDIV:    return "idiv";
+        case MachineOp::XOR:     return "xor";
+        case MachineOp::NEG:     return "neg";
+        case MachineOp::SHL:     return "shl";
+        case MachineOp::SHR:     return "shr";
+        case MachineOp::SAR:     return "sar";
+        case MachineOp::CQO:     return "cqo";
+        case MachineOp::AND:     return "and";
+        case MachineOp::OR:      return "or";
+        case MachineOp::MOVSD:   return "movsd";
+        case MachineOp::MOVQ:    return "movq";
+        case MachineOp::ADDSD:   return "addsd";
+        case MachineOp::SUBSD:   return "subsd";
+        case MachineOp::MULSD:   return "mulsd";
+        case MachineOp::DIVSD:   return "divsd";
+        case MachineOp::XORPD:   return "xorpd";
+        case MachineOp::UCOMISD: return "ucomisd";
+        case MachineOp::CVTSI2SD:     return "cvtsi2sd";
+        case MachineOp::CVTTSD2SI:    return "cvttsd2si";
+        case MachineOp::VFMADD231SD:  return "vfmadd231sd";
+        case MachineOp::VFMSUB231SD:  return "vfmsub231sd";
+        case MachineOp::VFNMADD231SD: return "vfnmadd231sd";
+        case MachineOp::CMP:     return "cmp";
+        case MachineOp::TEST:    return "test";
+        case MachineOp::JMP:     return "jmp";
+        case MachineOp::PUSH:    return "push";
+        case MachineOp::POP:     return "pop";
+        case MachineOp::CALL:    return "call";
+        case MachineOp::SYSCALL: return "syscall";
+        case MachineOp::RET:     return "ret";
+        default:                 return "?";
+    }
+}
+
+// --- Effects ---
+
+uint32_t registers_read_by(const MachineOperand& operand) {
+    switch (operand.kind) {
+        case MachineOperand::REGISTER:
+            return register_bit(operand.reg);
+        case MachineOperand::MEMORY:
+            return register_bit(operand.reg) | (operand.scale != 0 ? register_bit(operand.index) : 0);
+        default:
+            return 0;
+    }
+}
+
+static constexpr uint32_t ALL_XMM = 0xFFFF0000u;
+
+// Registers a called function may overwrite.
+static constexpr uint32_t CALLER_SAVED =
+    register_bit(Register::RAX) | register_bit(Register::RCX) | register_bit(Register::RDX) |
+    register_bit(Register::RSI) | register_bit(Register::RDI) | register_bit(Register::R8) |
+    register_bit(Register::R9) | register_bit(Register::R10) | register_bit(Register::R11) | ALL_XMM;
+
+// Registers that may carry arguments into a call.
+static constexpr uint32_t ARGUMENT_REGISTERS =
+    register_bit(Register::RDI) | register_bit(Register::RSI) | register_bit(Register::RDX) |
+    register_bit(Register::RCX) | register_bit(Register::R8) | register_bit(Register::R9) | 0x00FF0000u; // xmm0-7
+
+MachineEffects effects_of(const MachineInstr& instr) {
+    MachineEffects effects;
+    const MachineOperand& dst = instr.dst;
+    const MachineOperand& src = instr.src;
+
+    // A register destination is written; a memory destination reads its base.
+    auto written = [&](const MachineOperand& operand) {
+        if (operand.kind == MachineOperand::REGISTER) {
+            effects.writes |= register_bit(operand.reg);
+        } else {
+            effects.reads |= registers_read_by(operand);
+        }
+    };
+
+    switch (instr.op) {
+        case MachineOp::NOP:
+            break;
+        case MachineOp::LABEL:
+        case MachineOp::JMP:
+            effects.barrier = true;
+            break;
+        case MachineOp::JCC:
+            effects.barrier = true;
+            effects.reads_flags = true;
+            break;
+        case MachineOp::MOV:
+        case MachineOp::MOVZX:
+        case MachineOp::LEA:
+        case MachineOp::MOVSD: // Only the low half of a destination xmm register, which is all we use
+        case MachineOp::MOVQ:
+        case MachineOp::CVTSI2SD:
+        case MachineOp::CVTTSD2SI:
+            effects.reads |= registers_read_by(src);
+            written(dst);
+            break;
+        case MachineOp::XORPD:
+        case MachineOp::ADDSD:
+        case MachineOp::SUBSD:
+        case MachineOp::MULSD:
+        case MachineOp::DIVSD:
+            if (instr.op == MachineOp::XORPD && src == dst) { // Zeroing doesn't read
+                effects.writes |= registers_read_by(dst);
+                break;
+            }
+            effects.reads |= registers_read_by(dst) | registers_read_by(src);
+            written(dst);
+            break;
+        case MachineOp::VFMADD231SD:
+        case MachineOp::VFMSUB231SD:
+        case MachineOp::VFNMADD231SD:
+            effects.reads |= registers_read_by(dst) | registers_read_by(src) | registers_read_by(instr.src2);
+            written(dst);
+            break;
+        case MachineOp::UCOMISD:
+            effects.reads |= registers_read_by(dst) | registers_read_by(src);
+            effects.writes_flags = true;
+            break;
+        case MachineOp::XOR:
+            if (dst.kind == MachineOperand::REGISTER && src == dst) { // Zeroing doesn't read
+                effects.writes |= register_bit(dst.reg);
+                effects.writes_flags = true;
+                break;
+            }
+            [[fallthrough]];
+        case MachineOp::IMUL:
+            if (dst.kind == MachineOperand::NONE) { // rdx:rax = rax * src
+                effects.reads |= register_bit(Register::RAX) | registers_read_by(src);
+                effects.writes |= register_bit(Register::RAX) | register_bit(Register::RDX);
+                effects.writes_flags = true;
+                break;
+            }
+            [[fallthrough]];
+        case MachineOp::ADD:
+        case MachineOp::SUB:
+        case MachineOp::AND:
+        case MachineOp::OR:
+        case MachineOp::NEG:
+        case MachineOp::SHL:
+        case MachineOp::SHR:
+        case MachineOp::SAR:
+            effects.reads |= registers_read_by(dst) | registers_read_by(src);
+            written(dst);
+            effects.writes_flags = true;
+            break;
+        case MachineOp::CQO:
+            effects.reads |= register_bit(Register::RAX);
+            effects.writes |= register_bit(Register::RDX);
+            break;
+        case MachineOp::IDIV:
+            effects.reads |= register_bit(Register::RAX) | register_bit(Register::RDX) | registers_read_by(src);
+            effects.writes |= register_bit(Register::RAX) | register_bit(Register::RDX);
+            effects.writes_flags = true;
+            break;
+        case MachineOp::CMP:
+        case MachineOp::TEST:
+            effects.reads |= registers_read_by(dst) | registers_read_by(src);
+            effects.writes_flags = true;
+            break;
+        case MachineOp::SETCC:
+            effects.reads |= registers_read_by(dst); // Only the low byte changes
+            effects.writes |= registers_read_by(dst);
+            effects.reads_flags = true;
+            break;
+        case MachineOp::PUSH:
+            effects.reads |= registers_read_by(src) | register_bit(Register::RSP);
+            effects.writes |= register_bit(Register::RSP);
+            effects.uses_stack = true;
+            break;
+        case MachineOp::POP:
+            effects.reads |= register_bit(Register::RSP);
+            effects.writes |= register_bit(Register::RSP);
+            written(dst);
+            effects.uses_stack = true;
+            break;
+        case MachineOp::CALL:
+            effects.reads |= registers_read_by(dst) | ARGUMENT_REGISTERS | register_bit(Register::RSP);
+            effects.writes |= CALLER_SAVED;
+            effects.writes_flags = true;
+            effects.uses_stack = true;
+            effects.barrier = true;
+            break;
+        case MachineOp::SYSCALL:
+            effects.reads |= register_bit(Register::RAX) | register_bit(Register::RDI);
+            effects.writes |= register_bit(Register::RAX) | register_bit(Register::RCX) | register_bit(Register::R11);
+            effects.barrier = true;
+            break;
+        case MachineOp::RET:
+            // The result, and the callee-saved registers the epilogue restored.
+            effects.reads |= register_bit(Register::RAX) | register_bit(Register::XMM0) | register_bit(Register::RSP) |
+                             ~CALLER_SAVED;
+            effects.uses_stack = true;
+            effects.barrier = true;
+            break;
+    }
+    return effects;
+}
+
+// --- NASM output ---
+// Text is appended to a buffer that is flushed in large chunks: going
+// through the stream for every operand is several times slower.
+
+namespace {
+
+class NasmWriter {
+public:
+    NasmWriter(std::ostream& os, const MachineCode& code) : m_os(os), m_code(code) { m_buffer.reserve(FLUSH_AT + 256); }
+    ~NasmWriter() { flush(); }
+
+    void append(std::string_view text) { m_buffer.append(text); }
+
+    void append(int64_t value) {
+        char digits[24];
+        auto [end, error] = std::to_chars(digits, digits + sizeof(digits), value);
+        m_buffer.append(digits, end);
+    }
+
+    void operand(const MachineOperand& operand, bool sized) {
+        switch (operand.kind) {
+            case MachineOperand::NONE:
+                break;
+            case MachineOperand::REGISTER:
+                append(register_name(operand.reg));
+                break;
+            case MachineOperand::IMMEDIATE:
+                append(operand.value);
+                break;
+            case MachineOperand::MEMORY:
+                if (sized) append("qword ");
+                append("[");
+                append(register_name(operand.reg));
+                if (operand.scale != 0) {
+                    append("+");
+                    append(register_name(operand.index));
+                    if (operand.scale != 1) {
+                        append("*");
+                        append((int64_t)operand.scale);
+                    }
+                }
+                if (operand.value > 0) append("+");
+                if (operand.value != 0) append(operand.value);
+                append("]");
+                break;
+            case MachineOperand::LABEL:
+                append(".L");
+                append(operand.value);
+                break;
+            case MachineOperand::SYMBOL:
+                append(m_code.symbols[operand.value]);
+                break;
+            case MachineOperand::LITERAL:
+                // ..@ labels aren't local to the preceding function label.
+                if (sized) append("qword ");
+                append("[rel ..@LC");
+                append(operand.value);
+                append("]");
+                break;
+            case MachineOperand::FUNCTION:
+                append(m_code.functions[operand.value]);
+                break;
+        }
+    }
+
+    void instruction(const MachineInstr& instr) {
+        switch (instr.op) {
+            case MachineOp::NOP:
+                return;
+            case MachineOp::LABEL:
+                if (instr.dst.kind == MachineOperand::FUNCTION) {
+                    append("\n");
+                    append(m_code.functions[instr.dst.value]);
+                    append(":\n");
+                    return;
+                }
+                append("\n.L");
+                append(instr.dst.value);
+                append(":\n");
+                return;
+            case MachineOp::SETCC:
+                append("    set");
+                append(condition_suffix(instr.condition));
+                append(" ");
+                append(register_name8(instr.dst.reg));
+                append("\n");
+                return;
+            case MachineOp::JCC:
+                append("    j");
+                append(condition_suffix(instr.condition));
+                append(" ");
+                operand(instr.dst, false);
+                append("\n");
+                flushIfFull();
+                return;
+            case MachineOp::MOVZX:
+                append("    movzx ");
+                append(register_name(instr.dst.reg));
+                append(", ");
+                append(register_name8(instr.src.reg));
+                append("\n");
+                return;
+            case MachineOp::XOR:
+                if (instr.dst.kind == MachineOperand::REGISTER && instr.src == instr.dst) {
+                    // The 32-bit form zeroes the whole register and is shorter.
+                    append("    xor ");
+                    append(register_name32(instr.dst.reg));
+                    append(", ");
+                    append(register_name32(instr.dst.reg));
+                    append("\n");
+                    return;
+                }
+                break;
+            default:
+                break;
+        }
+
+        append("    ");
+        append(mnemonic(instr.op));
+        bool sized = instr.op != MachineOp::LEA;
+        if (instr.dst.kind != MachineOperand::NONE) {
+            append(" ");
+            operand(instr.dst, sized);
+        }
+        if (instr.src.kind != MachineOperand::NONE) {
+            append(instr.dst.kind != MachineOperand::NONE ? ", " : " ");
+            operand(instr.src, sized);
+        }
+        if (instr.src2.kind != MachineOperand::NONE) {
+            append(", ");
+            operand(instr.src2, sized);
+        }
+        append("\n");
+        flushIfFull();
+    }
+
+    void flush() {
+        m_os.write(m_buffer.data(), (std::streamsize)m_buffer.size());
+        m_buffer.clear();
+    }
+
+private:
+    static constexpr size_t FLUSH_AT = 1 << 16;
+
+    std::ostream& m_os;
+    const MachineCode& m_code;
+    std::string m_buffer;
+
+    void flushIfFull() {
+        if (m_buffer.size() >= FLUSH_AT) flush();
+    }
+};
+
+} // namespace
+
+void write_nasm(std::ostream& os, const MachineCode& code) {
+    NasmWriter writer(os, code);
+
+    // --- Boilerplate Assembly Header ---
+    writer.append("section .text\n");
+    for (std::string_view symbol : code.symbols) {
+        writer.append("extern ");
+        writer.append(symbol);
+        writer.append("\n");
+    }
+    writer.append("\n");
+    writer.append("global _start\n");
+    for (std::string_view function : code.functions) {
+        writer.append("global ");
+        writer.append(function);
+        writer.append("\n");
+    }
+    writer.append("\n");
+    writer.append("_start:\n");
+
+    for (const MachineInstr& instr : code.instructions) {
+        writer.instruction(instr);
+    }
+
+    // --- Float constants, as raw bits so they round-trip exactly ---
+    if (!code.literals.empty()) {
+        writer.append("\nsection .rodata\n");
+        writer.append("align 8\n");
+        char hex[24];
+        for (size_t i = 0; i < code.literals.size(); ++i) {
+            writer.append("..@LC");
+            writer.append((int64_t)i);
+            writer.append(": dq 0x");
+            auto [end, error] = std::to_chars(hex, hex + sizeof(hex), code.literals[i], 16);
+            writer.append(std::string_view(hex, end - hex));
+            writer.append("\n");
+        }
+    }
+}
+
+MachineCode link_machine_code(std::vector<MachineCode>& parts, const std::vector<std::string_view>& names) {
+    MachineCode linked;
+    std::unordered_map<std::string_view, uint32_t> functions;
+    for (size_t i = 1; i < parts.size(); ++i) {
+        functions.emplace(names[i], (uint32_t)linked.functions.size());
+        linked.functions.push_back(names[i]);
+    }
+    size_t instruction_count = 0;
+    for (const MachineCode& part : parts) instruction_count += part.instructions.size() + 1;
+    linked.instructions.reserve(instruction_count);
+
+    std::unordered_map<std::string_view, uint32_t> symbol_indices;
+    std::unordered_map<uint64_t, uint32_t> literal_indices;
+    std::vector<MachineOperand> symbols; // What each of the part's symbols became
+    std::vector<uint32_t> literals;      // Where each of the part's literals went
+    int64_t label_base = 0;
+    for (size_t i = 0; i < parts.size(); ++i) {
+        MachineCode& part = parts[i];
+        symbols.clear();
+        for (std::string_view name : part.symbols) {
+            auto function = functions.find(name);
+            if (function != functions.end()) {
+                symbols.push_back(MachineOperand::function(function->second));
+                continue;
+            }
+            auto [it, inserted] = symbol_indices.try_emplace(name, (uint32_t)linked.symbols.size());
+            if (inserted) linked.symbols.push_back(name);
+            symbols.push_back(MachineOperand::symbol(it->second));
+        }
+        literals.clear();
+        for (uint64_t bits : part.literals) {
+            auto [it, inserted] = literal_indices.try_emplace(bits, (uint32_t)linked.literals.size());
+            if (inserted) linked.literals.push_back(bits);
+            literals.push_back(it->second);
+        }
+
+        if (i != 0) {
+            linked.instructions.push_back(
+                {MachineOp::LABEL, Condition::EQ, MachineOperand::function((uint32_t)i - 1), {}, {}});
+        }
+        int64_t labels = 0;
+        for (MachineInstr instr : part.instructions) {
+            for (MachineOperand* operand : {&instr.dst, &instr.src, &instr.src2}) {
+                switch (operand->kind) {
+                    case MachineOperand::LABEL:
+                        labels = std::max(labels, operand->value + 1);
+                        operand->value += label_base;
+                        break;
+                    case MachineOperand::SYMBOL:
+                        *operand = symbols[operand->value];
+                        break;
+                    case MachineOperand::LITERAL:
+                        operand->value = literals[operand->value];
+                        break;
+                    default:
+                        break;
+                }
+            }
+            linked.instructions.push_back(instr);
+        }
+        label_base += labels;
+        part = MachineCode();
+    }
+    return linked;
+}
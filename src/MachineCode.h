@@ -0,0 +1,153 @@
+#pragma once
+
+#include "IR.h" // For BlockIndex
+#include "RegisterAllocator.h" // For Register
+#include <cstdint>
+#include <iostream>
+#include <string_view>
+#include <vector>
+
+// The x86-64 instructions the backend emits. The code generator builds a
+// list of these instead of writing text directly, so later passes (the
+// peephole optimizer) can inspect and rewrite them before they are printed.
+enum class MachineOp : uint8_t {
+    NOP,     // Deleted by a pass; never printed
+    LABEL,   // dst: LABEL, or FUNCTION where that function starts
+    MOV,     // dst = src
+    MOVZX,   // dst = zero-extended low byte of register src
+    LEA,     // dst = address of MEMORY src
+    ADD,     // dst += src
+    SUB,     // dst -= src
+    IMUL,    // dst *= src; without a dst, rdx:rax = rax * src (the full 128-bit product)
+    IDIV,    // rax = rdx:rax / src, rdx = remainder
+    XOR,     // dst ^= src (printed in its 32-bit form when zeroing a register)
+    NEG,     // dst = -dst
+    SHL,     // dst <<= immediate src
+    SHR,     // dst >>= immediate src, shifting in zeros
+    SAR,     // dst >>= immediate src, shifting in the sign bit
+    CQO,     // rdx = the sign of rax, filling every bit
+    AND,     // dst &= src
+    OR,      // dst |= src
+    // Scalar double-precision SSE2; dst is an xmm register unless noted.
+    MOVSD,     // dst = src (either may be memory, not both)
+    MOVQ,      // dst = src, between a general-purpose and an xmm register
+    ADDSD,     // dst += src
+    SUBSD,     // dst -= src
+    MULSD,     // dst *= src
+    DIVSD,     // dst /= src
+    XORPD,     // dst ^= src (zeroing when they are the same register)
+    UCOMISD,   // flags = compare dst with src, as unsigned integer flags (NaN sets ZF, PF and CF)
+    CVTSI2SD,  // dst = (double) integer src
+    CVTTSD2SI, // general-purpose dst = (int64) src, truncating
+    // FMA3, with a third operand src2: dst = ±(src * src2) ± dst, rounded once.
+    VFMADD231SD,  // dst = src * src2 + dst
+    VFMSUB231SD,  // dst = src * src2 - dst
+    VFNMADD231SD, // dst = -(src * src2) + dst
+    CMP,     // flags = dst - src
+    TEST,    // flags = dst & src
+    SETCC,   // low byte of dst = condition
+    JMP,     // dst: LABEL
+    JCC,     // dst: LABEL, taken if the condition holds
+    PUSH,    // src
+    POP,     // dst
+    CALL,    // dst: SYMBOL, FUNCTION or REGISTER
+    SYSCALL,
+    RET,
+};
+
+// The condition of a SETCC or JCC: signed comparisons, then the unsigned
+// and parity conditions that ucomisd results are tested with.
+enum class Condition : uint8_t { EQ, NE, LT, LE, GT, GE, A, AE, P, NP };
+
+struct MachineOperand {
+    enum Kind : uint8_t {
+        NONE,
+        REGISTER,  // reg
+        IMMEDIATE, // value
+        MEMORY,    // qword [reg + index * scale + value]
+        LABEL,     // A block, by index (value)
+        SYMBOL,    // An external name, by index into MachineCode::symbols (value)
+        LITERAL,   // A qword in the read-only data, by index into MachineCode::literals (value)
+        FUNCTION,  // A function of the program, by index into MachineCode::functions (value)
+    };
+    Kind kind = NONE;
+    Register reg = Register::RAX;
+    Register index = Register::RAX; // MEMORY only, when scale isn't 0
+    uint8_t scale = 0;              // 0 (no index), 1, 2, 4 or 8
+    int64_t value = 0;
+
+    static MachineOperand of(Register reg) { return {REGISTER, reg}; }
+    static MachineOperand immediate(int64_t value) { return {IMMEDIATE, Register::RAX, Register::RAX, 0, value}; }
+    static MachineOperand memory(Register base, int32_t displacement) {
+        return {MEMORY, base, Register::RAX, 0, displacement};
+    }
+    // [base + index * scale + displacement], for lea.
+    static MachineOperand address(Register base, Register index, uint8_t scale, int32_t displacement) {
+        return {MEMORY, base, index, scale, displacement};
+    }
+    static MachineOperand label(BlockIndex block) { return {LABEL, Register::RAX, Register::RAX, 0, block}; }
+    static MachineOperand symbol(uint32_t index) { return {SYMBOL, Register::RAX, Register::RAX, 0, index}; }
+    static MachineOperand literal(uint32_t index) { return {LITERAL, Register::RAX, Register::RAX, 0, index}; }
+    static MachineOperand function(uint32_t index) { return {FUNCTION, Register::RAX, Register::RAX, 0, index}; }
+
+    bool is_register(Register r) const { return kind == REGISTER && reg == r; }
+    bool is_xmm_register() const { return kind == REGISTER && is_xmm(reg); }
+    bool is_memory() const { return kind == MEMORY || kind == LITERAL; }
+
+    // The factories leave unused fields zero, so a plain comparison works.
+    bool operator==(const MachineOperand& other) const {
+        return kind == other.kind && reg == other.reg && index == other.index && scale == other.scale &&
+               value == other.value;
+    }
+    bool operator!=(const MachineOperand& other) const { return !(*this == other); }
+};
+
+struct MachineInstr {
+    MachineOp op;
+    Condition condition = Condition::EQ; // SETCC and JCC only
+    MachineOperand dst;
+    MachineOperand src;
+    MachineOperand src2; // FMA only
+};
+
+// A whole program's machine code, in layout order: the top-level code, then
+// each function from its LABEL on.
+struct MachineCode {
+    std::vector<MachineInstr> instructions;
+    std::vector<std::string_view> symbols;   // External names used by CALL
+    std::vector<uint64_t> literals;          // The bits of each float constant, deduplicated
+    std::vector<std::string_view> functions; // Names of the program's functions (after linking)
+};
+
+// Joins separately generated parts into one program, in order: `parts[0]`
+// is the top-level code and `parts[i]` the function called `names[i]`.
+// Each function gets a LABEL, block labels are renumbered so they stay
+// unique, calls of the program's own functions become CALLs of a FUNCTION,
+// and the symbols and literals of the parts are merged, each kept once. The
+// parts are left empty.
+MachineCode link_machine_code(std::vector<MachineCode>& parts, const std::vector<std::string_view>& names);
+
+// What an instruction reads and writes, for passes that move or delete
+// instructions. Registers are bit masks indexed by Register.
+struct MachineEffects {
+    uint32_t reads = 0;
+    uint32_t writes = 0;
+    bool reads_flags = false;
+    bool writes_flags = false;
+    bool uses_stack = false; // Pushes, pops or calls
+    bool barrier = false;    // Labels, jumps, calls and syscalls: control may come or go
+};
+
+MachineEffects effects_of(const MachineInstr& instr);
+
+constexpr uint32_t register_bit(Register reg) {
+    return 1u << (int)reg;
+}
+
+// The registers an operand reads: a register itself, or a memory operand's
+// base and index.
+uint32_t registers_read_by(const MachineOperand& operand);
+
+// Writes the program as NASM assembly, with the _start boilerplate, a global
+// label for each function and the float literals in .rodata.
+void write_nasm(std::ostream& os, const MachineCode& code);
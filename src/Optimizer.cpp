@@ -0,0 +1,9 @@
+#include "Optimizer.h"
+
+void optimize_ir(IRProgram& program, OptimizationStats& stats) {
+    // Folding first makes more expressions identical for value numbering.
+    propagate_constants(program, stats);
+    number_values(program, stats);
+    // Last, so it sweeps up what the other passes left unused.
+    eliminate_dead_code(program, stats);
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "IR.h"
+#include <cstddef>
+
+// Counters of what the optimization passes changed, for --stats.
+struct OptimizationStats {
+    size_t constants_folded = 0;     // Instructions and phis replaced by a constant
+    size_t branches_folded = 0;      // Branches turned into jumps
+    size_t blocks_removed = 0;       // Blocks found to be unreachable
+    size_t redundant_eliminated = 0; // Instructions and phis that recomputed an available value
+    size_t copies_propagated = 0;    // Copies (and single-operand phis) removed
+    size_t dead_eliminated = 0;      // Instructions and phis whose result was never used
+    size_t blocks_merged = 0;        // Blocks appended to their only predecessor
+
+    OptimizationStats& operator+=(const OptimizationStats& other) {
+        constants_folded += other.constants_folded;
+        branches_folded += other.branches_folded;
+        blocks_removed += other.blocks_removed;
+        redundant_eliminated += other.redundant_eliminated;
+        copies_propagated += other.copies_propagated;
+        dead_eliminated += other.dead_eliminated;
+        blocks_merged += other.blocks_merged;
+        return *this;
+    }
+};
+
+// The passes below work on SSA form and keep it valid.
+
+// Sparse conditional constant propagation (Wegman and Zadeck): finds every
+// temporary whose value is known at compile time, following constants
+// through 'let's, phis and branches, and only considering blocks that can
+// actually run. Those temporaries are replaced by constants, branches on a
+// known condition become jumps, and blocks that can't be reached are removed.
+//
+// Folding follows the run-time semantics: integers wrap around in 64 bits,
+// division truncates toward zero, and a division that would trap (by zero,
+// or of the most negative integer by -1) is left for run time. Casting a
+// float to int truncates toward zero, and a value out of range becomes the
+// most negative integer, as cvttsd2si does.
+void propagate_constants(IRProgram& program, OptimizationStats& stats);
+
+// Global value numbering: walks the dominator tree with a scoped hash table
+// of (opcode, type, operands), so an instruction that recomputes a value
+// already available in a dominating block is deleted and its uses take the
+// earlier result. Commutative operations and mirrored comparisons are
+// normalized first, so `a * b` matches `b * a` and `a > b` matches `b < a`.
+// Calls are never merged, since they may have side effects.
+void number_values(IRProgram& program, OptimizationStats& stats);
+
+// Copy propagation and dead code elimination. Uses of a copy (including a
+// phi with a single operand) are pointed at its source. Then everything
+// that doesn't contribute to a call, a branch or the program's result is
+// deleted. CALLs and their PARAMs are always kept, since a call may have
+// side effects, and so is an integer division that might trap (one whose
+// divisor isn't a constant other than 0 and -1), so that removing it
+// doesn't change what the program does. Finally, blocks that are only reached by a jump from one
+// predecessor are merged into it.
+void eliminate_dead_code(IRProgram& program, OptimizationStats& stats);
+
+// Runs every optimization pass in order.
+void optimize_ir(IRProgram& program, OptimizationStats& stats);
@@ -0,0 +1,80 @@
+#include "Lexer.h"
+#include <cstring>
+#include <future>
+#include <vector>
+
+namespace {
+
+// Below this size a chunk isn't worth a task of its own.
+constexpr size_t MIN_CHUNK_SIZE = 256 * 1024;
+
+// Chooses chunk boundaries: each chunk ends just after a ';' (or at the end
+// of the source). Returns the start offsets followed by source.size().
+std::vector<size_t> split_at_statements(std::string_view source, size_t chunk_count) {
+    std::vector<size_t> bounds{0};
+    size_t target = source.size() / chunk_count;
+    if (target < MIN_CHUNK_SIZE) target = MIN_CHUNK_SIZE;
+
+    size_t position = 0;
+    while (source.size() - position > target) {
+        const void* semicolon = std::memchr(source.data() + position + target, ';',
+                                            source.size() - position - target);
+        if (!semicolon) break;
+        position = static_cast<const char*>(semicolon) - source.data() + 1;
+        bounds.push_back(position);
+    }
+    if (bounds.back() != source.size()) bounds.push_back(source.size());
+    return bounds;
+}
+
+// The tokens of one chunk, in the chunk's own arena.
+struct Chunk {
+    Arena arena;
+    TokenList tokens{&arena};
+};
+
+} // namespace
+
+TokenList tokenize_parallel(std::string_view source, Arena& arena, ThreadPool& pool) {
+    // A few chunks per thread smooths out uneven chunks.
+    std::vector<size_t> bounds = split_at_statements(source, pool.size() * 4);
+    size_t chunk_count = bounds.size() - 1;
+    if (chunk_count <= 1) {
+        return Lexer(source, arena).tokenize();
+    }
+
+    // 1. Lex every chunk concurrently.
+    std::vector<Chunk> chunks(chunk_count);
+    std::vector<std::future<void>> lexed;
+    lexed.reserve(chunk_count);
+    for (size_t i = 0; i < chunk_count; ++i) {
+        lexed.push_back(pool.submit([&, i] {
+            Chunk& chunk = chunks[i];
+            chunk.tokens = Lexer(source, chunk.arena, bounds[i], bounds[i + 1]).tokenize();
+            chunk.tokens.pop_back(); // Each chunk ends with its own END_OF_FILE
+        }));
+    }
+    for (auto& done : lexed) done.get();
+
+    // 2. Stitch: every chunk is copied to its final position in parallel.
+    std::vector<size_t> starts(chunk_count + 1, 0);
+    for (size_t i = 0; i < chunk_count; ++i) {
+        starts[i + 1] = starts[i] + chunks[i].tokens.size();
+    }
+    TokenList tokens(&arena);
+    tokens.resize(starts[chunk_count] + 1);
+
+    std::vector<std::future<void>> copied;
+    copied.reserve(chunk_count);
+    for (size_t i = 0; i < chunk_count; ++i) {
+        copied.push_back(pool.submit([&, i] {
+            std::memcpy(tokens.data() + starts[i], chunks[i].tokens.data(),
+                        chunks[i].tokens.size() * sizeof(Token));
+        }));
+    }
+    for (auto& done : copied) done.get();
+
+    // 3. The single END_OF_FILE token, exactly as the sequential lexer makes it.
+    tokens.back() = Lexer(source, arena, source.size(), source.size()).next();
+    return tokens;
+}
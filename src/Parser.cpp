@@ -1,131 +1,322 @@
 #include "Parser.h"
-// In src/Parser.cpp
+#include <array>
+
+namespace {
+
+// How tightly each operator binds to its operands. Higher binds tighter, and
+// 0 means the token can't be used that way. Every infix operator here is
+// left-associative.
+struct BindingPower {
+    uint8_t prefix; // As a unary operator, e.g. `-x`
+    uint8_t infix;  // As a binary operator, e.g. `x - y`
+};
+
+enum : uint8_t {
+    POWER_NONE = 0,
+    POWER_LOGICAL_OR,     // ||
+    POWER_LOGICAL_AND,    // &&
+    POWER_EQUALITY,       // == !=
+    POWER_COMPARISON,     // < <= > >=
+    POWER_ADDITIVE,       // + -
+    POWER_MULTIPLICATIVE, // * /
+    POWER_PREFIX,         // - ! and casts
+};
+
+constexpr std::array<BindingPower, 256> make_binding_powers() {
+    std::array<BindingPower, 256> table{};
+    auto entry = [&](TokenType type) -> BindingPower& { return table[(uint8_t)type]; };
+    entry(TokenType::OR_OR).infix = POWER_LOGICAL_OR;
+    entry(TokenType::AND_AND).infix = POWER_LOGICAL_AND;
+    entry(TokenType::EQUAL_EQUAL).infix = POWER_EQUALITY;
+    entry(TokenType::BANG_EQUAL).infix = POWER_EQUALITY;
+    entry(TokenType::LESS).infix = POWER_COMPARISON;
+    entry(TokenType::LESS_EQUAL).infix = POWER_COMPARISON;
+    entry(TokenType::GREATER).infix = POWER_COMPARISON;
+    entry(TokenType::GREATER_EQUAL).infix = POWER_COMPARISON;
+    entry(TokenType::PLUS).infix = POWER_ADDITIVE;
+    entry(TokenType::MINUS).infix = POWER_ADDITIVE;
+    entry(TokenType::STAR).infix = POWER_MULTIPLICATIVE;
+    entry(TokenType::SLASH).infix = POWER_MULTIPLICATIVE;
+    entry(TokenType::MINUS).prefix = POWER_PREFIX;
+    entry(TokenType::BANG).prefix = POWER_PREFIX;
+    return table;
+}
 
-// In src/Parser.cpp
+constexpr std::array<BindingPower, 256> BINDING_POWERS = make_binding_powers();
+
+} // namespace
 
-std::unique_ptr<ExpressionNode> Parser::parsePrimary() {
-    if (match({TokenType::FLOAT_LITERAL})) {
-        double value = std::stod(previous().lexeme);
-        return std::make_unique<FloatLiteralNode>(value);
+// Literals and identifiers, the leaves of every expression. Brackets, casts
+// and operators around them are handled by parseExpression().
+NodeIndex Parser::parsePrimary() {
+    // Literal values were already decoded by the lexer.
+    if (match(TokenType::FLOAT_LITERAL)) {
+        return m_ast.add_float(previous().float_value, previous().offset);
     }
-    if (match({TokenType::INTEGER_LITERAL})) {
-        long long value = std::stoll(previous().lexeme);
-        return std::make_unique<IntegerLiteralNode>(value);
+    if (match(TokenType::INTEGER_LITERAL)) {
+        return m_ast.add_integer(previous().int_value, previous().offset);
     }
-    if (match({TokenType::IDENTIFIER})) {
-        // This is just a plain identifier, not a call or cast
-        return std::make_unique<IdentifierNode>(previous().lexeme);
+    if (match(TokenType::IDENTIFIER)) {
+        // A plain name; a following '(' makes it the callee of a call.
+        return m_ast.add_identifier(lexeme(previous()), previous().offset);
     }
 
-    if (match({TokenType::LEFT_PAREN})) {
-        // --- THIS IS THE NEW, SMARTER LOGIC ---
-        // Check if this is a cast: (IDENTIFIER) ...
-        if (peek().type == TokenType::IDENTIFIER && m_tokens[m_current + 1].type == TokenType::RIGHT_PAREN) {
-            // Check if the identifier is a known type name
-            if (known_type_names.count(peek().lexeme) > 0) {
-                advance(); // Consume the identifier (the type name)
-                const Token type_token = previous();
-                DataType targetType = (type_token.lexeme == "int") ? DataType::INT : DataType::FLOAT;
-
-                consume(TokenType::RIGHT_PAREN, "Expected ')' after type name in cast.");
-                
-                // Parse the expression to be casted. IMPORTANT: Use parseCall() to allow (int)my_func()
-                std::unique_ptr<ExpressionNode> exprToCast = parseCall();
-                return std::make_unique<CastNode>(targetType, std::move(exprToCast));
-            }
-        }
-        
-        // If it's not a cast, it's a normal grouped expression.
-        std::unique_ptr<ExpressionNode> expr = parseExpression();
-        consume(TokenType::RIGHT_PAREN, "Expected ')' after expression.");
-        return expr;
-    }
+    throw std::runtime_error(errorAt("Unexpected token when expecting an expression."));
+}
 
-    throw std::runtime_error("Parser Error: Unexpected token '" + peek().lexeme + "' when expecting an expression.");
+// True if the tokens after a '(' spell a cast, "(int)" or "(float)".
+bool Parser::isCastAhead() const {
+    return peek().type == TokenType::IDENTIFIER && m_tokens.peek(1).type == TokenType::RIGHT_PAREN &&
+           known_type_names.count(lexeme(peek())) > 0;
 }
-// In src/Parser.cpp
 
-std::unique_ptr<ExpressionNode> Parser::parseMultiplication() {
-    // MODIFIED: 调用 parseCall() 而不是 parsePrimary()
-    std::unique_ptr<ExpressionNode> expr = parseCall();
+NodeIndex Parser::popOperand() {
+    NodeIndex operand = m_operands.back();
+    m_operands.pop_back();
+    return operand;
+}
 
-    while (match({TokenType::STAR, TokenType::SLASH})) {
-        const Token op = previous();
-        // MODIFIED: 调用 parseCall() 而不是 parsePrimary()
-        std::unique_ptr<ExpressionNode> right = parseCall();
-        expr = std::make_unique<BinaryOpNode>(op.type, std::move(expr), std::move(right));
+// Builds the node for the pending prefix, infix or cast operator on top of
+// the stack from the operands it applies to.
+void Parser::reduceOperator() {
+    PendingOperator pending = m_operators.back();
+    m_operators.pop_back();
+
+    NodeIndex operand = popOperand();
+    switch (pending.kind) {
+        case PendingOperator::PREFIX:
+            m_operands.push_back(m_ast.add_unary(pending.op, operand, pending.position));
+            break;
+        case PendingOperator::CAST:
+            m_operands.push_back(m_ast.add_cast(pending.target, operand, pending.position));
+            break;
+        case PendingOperator::INFIX: {
+            NodeIndex left = popOperand();
+            m_operands.push_back(m_ast.add_binary(pending.op, left, operand, pending.position));
+            break;
+        }
+        case PendingOperator::GROUP:
+        case PendingOperator::CALL:
+            break; // Brackets are closed by parseExpression() itself
     }
-
-    return expr;
 }
-// In src/Parser.cpp
 
-std::unique_ptr<ExpressionNode> Parser::parseAddition() {
-    // The left-hand side can be a full multiplication/division expression.
-    std::unique_ptr<ExpressionNode> expr = parseMultiplication();
+// Precedence climbing without recursion. Operands and the operators still
+// waiting for them live on two explicit stacks, so nesting depth (parentheses,
+// prefix operators, calls inside calls) is limited only by memory.
+//
+// The loop alternates between two positions:
+//   - operand position: prefix operators, casts and '(' are pushed until a
+//     literal or identifier arrives;
+//   - operator position: calls are applied to the operand just parsed, then
+//     every pending operator that binds at least as tightly as the next
+//     infix operator is reduced (which makes infix operators left-
+//     associative). A token that isn't an operator closes the innermost
+//     bracket, or ends the expression when no bracket is open.
+// Nodes are still created after their children, as the AST requires.
+NodeIndex Parser::parseExpression() {
+    m_operators.clear();
+    m_operands.clear();
 
-    while (match({TokenType::PLUS, TokenType::MINUS})) {
-        const Token op = previous();
-        std::unique_ptr<ExpressionNode> right = parseMultiplication();
-        expr = std::make_unique<BinaryOpNode>(op.type, std::move(expr), std::move(right));
-    }
+    while (true) {
+        // --- Operand position ---
+        const Token token = peek();
+        if (BINDING_POWERS[(uint8_t)token.type].prefix != POWER_NONE) {
+            advance();
+            m_operators.push_back({PendingOperator::PREFIX, BINDING_POWERS[(uint8_t)token.type].prefix,
+                                   token.type, DataType::UNKNOWN, token.offset, 0, NO_NODE});
+            continue;
+        }
+        if (match(TokenType::LEFT_PAREN)) {
+            if (isCastAhead()) {
+                const Token type_token = advance(); // The type name
+                DataType target = (lexeme(type_token) == "int") ? DataType::INT : DataType::FLOAT;
+                consume(TokenType::RIGHT_PAREN, "Expected ')' after type name in cast.");
+                // A cast binds like a prefix operator, so (int)my_func() casts the
+                // call's result and (int)-x casts the negation.
+                m_operators.push_back({PendingOperator::CAST, POWER_PREFIX, TokenType::CAST, target,
+                                       type_token.offset, 0, NO_NODE});
+            } else {
+                m_operators.push_back({PendingOperator::GROUP, POWER_NONE, TokenType::LEFT_PAREN,
+                                       DataType::UNKNOWN, token.offset, 0, NO_NODE});
+            }
+            continue;
+        }
+        m_operands.push_back(parsePrimary());
+
+        // --- Operator position ---
+        // Stays here until an operator or ',' calls for another operand.
+        while (true) {
+            if (match(TokenType::LEFT_PAREN)) {
+                // A call of whatever was just parsed: f(x), f(x)(y), (g)(x).
+                uint32_t position = previous().offset;
+                NodeIndex callee = popOperand();
+                if (match(TokenType::RIGHT_PAREN)) {
+                    m_operands.push_back(m_ast.add_call(callee, nullptr, 0, position));
+                    continue;
+                }
+                m_operators.push_back({PendingOperator::CALL, POWER_NONE, TokenType::CALL, DataType::UNKNOWN,
+                                       position, (uint32_t)m_argument_stack.size(), callee});
+                break; // Parse the first argument
+            }
 
-    return expr;
-}
+            const Token op = peek();
+            uint8_t power = BINDING_POWERS[(uint8_t)op.type].infix;
+            while (!m_operators.empty() && m_operators.back().kind != PendingOperator::GROUP &&
+                   m_operators.back().kind != PendingOperator::CALL && m_operators.back().power >= power) {
+                reduceOperator();
+            }
+            if (power != POWER_NONE) {
+                advance();
+                m_operators.push_back({PendingOperator::INFIX, power, op.type, DataType::UNKNOWN,
+                                       op.offset, 0, NO_NODE});
+                break; // Parse the right operand
+            }
 
-// And define the top-level expression parser to start the chain.
-std::unique_ptr<ExpressionNode> Parser::parseExpression() {
-    // For now, the lowest precedence level is addition.
-    // In the future, this could be assignment, e.g., `return parseAssignment();`
-    return parseAddition();
+            // Not an operator: close the innermost bracket, or finish.
+            if (m_operators.empty()) {
+                return popOperand(); // Stops at ';' (checked by the caller) and the like
+            }
+            PendingOperator bracket = m_operators.back();
+            if (bracket.kind == PendingOperator::GROUP) {
+                consume(TokenType::RIGHT_PAREN, "Expected ')' after expression.");
+                m_operators.pop_back();
+                continue; // The grouped value is now an ordinary operand
+            }
+
+            // The innermost bracket is a call's argument list. Nested calls
+            // share m_argument_stack, so building one never allocates a vector.
+            m_argument_stack.push_back(popOperand());
+            if (match(TokenType::COMMA)) break; // Parse the next argument
+
+            consume(TokenType::RIGHT_PAREN, "Expected ')' after arguments.");
+            m_operators.pop_back();
+            NodeIndex call = m_ast.add_call(bracket.callee, m_argument_stack.data() + bracket.argument_base,
+                                            (uint32_t)(m_argument_stack.size() - bracket.argument_base),
+                                            bracket.position);
+            m_argument_stack.resize(bracket.argument_base);
+            m_operands.push_back(call);
+        }
+    }
 }
 // In src/Parser.cpp
 
 // An ExpressionStatement is just an expression followed by a semicolon.
-std::unique_ptr<StatementNode> Parser::parseExpressionStatement() {
-    std::unique_ptr<ExpressionNode> expr = parseExpression();
+NodeIndex Parser::parseExpressionStatement() {
+    uint32_t position = peek().offset;
+    NodeIndex expr = parseExpression();
     consume(TokenType::SEMICOLON, "Expected ';' after expression.");
-    return std::make_unique<ExpressionStatementNode>(std::move(expr));
+    return m_ast.add_expression_statement(expr, position);
 }
 
-std::unique_ptr<StatementNode> Parser::parseLetStatement() {
+NodeIndex Parser::parseLetStatement() {
     // The 'let' keyword has already been consumed by parseStatement().
     const Token nameToken = consume(TokenType::IDENTIFIER, "Expected variable name after 'let'.");
-    auto name = std::make_unique<IdentifierNode>(nameToken.lexeme);
 
     consume(TokenType::EQUALS, "Expected '=' after variable name.");
 
-    std::unique_ptr<ExpressionNode> initializer = parseExpression();
+    NodeIndex initializer = parseExpression();
     
     consume(TokenType::SEMICOLON, "Expected ';' after variable declaration.");
     
-    return std::make_unique<LetStatementNode>(std::move(name), std::move(initializer));
+    return m_ast.add_let(lexeme(nameToken), initializer, nameToken.offset);
+}
+
+// A type name after ':' in a function's signature.
+DataType Parser::parseTypeName(const std::string& message) {
+    if (!check(TokenType::IDENTIFIER) || known_type_names.count(lexeme(peek())) == 0) {
+        throw std::runtime_error(errorAt(message));
+    }
+    return (lexeme(advance()) == "int") ? DataType::INT : DataType::FLOAT;
+}
+
+// fn name(a: int, b: float): float { statements... return value; }
+//
+// The body is the same let and expression statements as the top level, and
+// must end with its one return statement.
+NodeIndex Parser::parseFunction() {
+    // The 'fn' keyword has already been consumed by parseStatement().
+    const Token nameToken = consume(TokenType::IDENTIFIER, "Expected function name after 'fn'.");
+    consume(TokenType::LEFT_PAREN, "Expected '(' after function name.");
+    m_parameters.clear();
+    if (!check(TokenType::RIGHT_PAREN)) {
+        do {
+            const Token parameterToken = consume(TokenType::IDENTIFIER, "Expected parameter name.");
+            consume(TokenType::COLON, "Expected ':' after parameter name.");
+            DataType type = parseTypeName("Expected parameter type ('int' or 'float').");
+            m_parameters.push_back(m_ast.add_parameter(lexeme(parameterToken), type, parameterToken.offset));
+        } while (match(TokenType::COMMA));
+    }
+    consume(TokenType::RIGHT_PAREN, "Expected ')' after parameters.");
+    consume(TokenType::COLON, "Expected ':' and a return type after the parameters.");
+    DataType return_type = parseTypeName("Expected return type ('int' or 'float').");
+    consume(TokenType::LEFT_BRACE, "Expected '{' before function body.");
+
+    // Created before its body; see AST.h.
+    NodeIndex function = m_ast.add_function(lexeme(nameToken), return_type, nameToken.offset);
+
+    m_body.clear();
+    while (!check(TokenType::RETURN)) {
+        if (isAtEnd() || check(TokenType::RIGHT_BRACE)) {
+            throw std::runtime_error(errorAt("Expected 'return' at the end of the function body."));
+        }
+        if (check(TokenType::FN)) {
+            throw std::runtime_error(errorAt("Functions can only be defined at the top level."));
+        }
+        m_body.push_back(match(TokenType::LET) ? parseLetStatement() : parseExpressionStatement());
+    }
+    uint32_t position = advance().offset; // 'return'
+    NodeIndex value = parseExpression();
+    consume(TokenType::SEMICOLON, "Expected ';' after return value.");
+    m_body.push_back(m_ast.add_return(value, function, position));
+    consume(TokenType::RIGHT_BRACE, "Expected '}' after the return statement; it must come last in a function.");
+
+    m_ast.set_function_body(function, m_parameters.data(), (uint32_t)m_parameters.size(), m_body.data(),
+                            (uint32_t)m_body.size());
+    return function;
 }
 
 // This is the dispatcher that chooses the correct statement parser.
-std::unique_ptr<StatementNode> Parser::parseStatement() {
-    if (match({TokenType::LET})) {
+NodeIndex Parser::parseStatement() {
+    if (match(TokenType::LET)) {
         return parseLetStatement();
     }
+    if (match(TokenType::FN)) {
+        return parseFunction();
+    }
+    if (check(TokenType::RETURN)) {
+        throw std::runtime_error(errorAt("'return' can only be used inside a function."));
+    }
 
     // If no other statement type matches, assume it's an expression statement.
     return parseExpressionStatement();
 }
 
-Parser::Parser(const std::vector<Token>& tokens) : m_tokens(tokens) {}
+Parser::Parser(const TokenList& tokens, SourceBuffer source, Arena& arena, std::ostream& diagnostics)
+    : m_tokens(tokens), m_source(source), m_arena(arena), m_ast(&arena), m_diagnostics(diagnostics) {
+    // Each token produces at most about one node, so this avoids regrowing
+    // the AST's arrays while parsing.
+    m_ast.reserve(tokens.size());
+}
+
+Parser::Parser(Lexer& lexer, SourceBuffer source, Arena& arena, std::ostream& diagnostics)
+    : m_tokens(lexer), m_source(source), m_arena(arena), m_ast(&arena), m_diagnostics(diagnostics) {
+    // The token count isn't known yet; estimate it from the source size.
+    m_ast.reserve(source.size() / 4 + 1);
+}
 
-std::vector<std::unique_ptr<StatementNode>> Parser::parse() {
-    std::vector<std::unique_ptr<StatementNode>> statements;
+AST Parser::parse() {
     while (!isAtEnd()) {
         try {
-            statements.push_back(parseStatement());
+            m_ast.add_statement(parseStatement());
         } catch (const std::runtime_error& e) {
             // 这里可以添加错误恢复逻辑，但现在我们先简单打印并退出
-            std::cerr << e.what() << std::endl;
-            return {}; // 或者根据需要处理
+            m_diagnostics << e.what() << std::endl;
+            m_had_error = true;
+            return AST(&m_arena); // 或者根据需要处理
         }
     }
-    return statements;
+    return std::move(m_ast);
 }
 
 
@@ -136,17 +327,16 @@ bool Parser::isAtEnd() const {
 }
 
 const Token& Parser::peek() const {
-    return m_tokens[m_current];
+    return m_tokens.peek();
 }
 
 const Token& Parser::previous() const {
-    // m_current 总是在下一个token，所以前一个在 m_current - 1
-    return m_tokens[m_current - 1];
+    return m_tokens.previous();
 }
 
 Token Parser::advance() {
     if (!isAtEnd()) {
-        m_current++;
+        m_tokens.advance();
     }
     return previous();
 }
@@ -156,54 +346,21 @@ bool Parser::check(TokenType type) const {
     return peek().type == type;
 }
 
-bool Parser::match(const std::vector<TokenType>& types) {
-    for (TokenType type : types) {
-        if (check(type)) {
-            advance();
-            return true;
-        }
-    }
-    return false;
+bool Parser::match(TokenType type) {
+    if (!check(type)) return false;
+    advance();
+    return true;
 }
 
 Token Parser::consume(TokenType type, const std::string& message) {
     if (check(type)) {
         return advance();
     }
-    throw std::runtime_error("Parser Error: " + message + " (at token '" + peek().lexeme + "')");
+    throw std::runtime_error(errorAt(message));
 }
 
-// 在 src/Parser.cpp 中
-
-// NEW: 实现 parseCall 函数
-std::unique_ptr<ExpressionNode> Parser::parseCall() {
-    // 先解析一个 primary 表达式，这可能是个函数名
-    std::unique_ptr<ExpressionNode> expr = parsePrimary();
-
-    // 循环检查后面是否跟随着'(', 以支持 f(x)() 这种调用
-    while (true) {
-        if (match({TokenType::LEFT_PAREN})) {
-            // 如果是'(', 说明这是一个函数调用
-            std::vector<std::unique_ptr<ExpressionNode>> args = parseArguments();
-            expr = std::make_unique<FunctionCallNode>(std::move(expr), std::move(args));
-        } else {
-            break; // 不是函数调用，退出循环
-        }
-    }
-    return expr;
-}
-
-// NEW: 实现参数列表的辅助解析函数
-std::vector<std::unique_ptr<ExpressionNode>> Parser::parseArguments() {
-    std::vector<std::unique_ptr<ExpressionNode>> args;
-    
-    // 如果括号内不是空的
-    if (!check(TokenType::RIGHT_PAREN)) {
-        do {
-            args.push_back(parseExpression());
-        } while (match({TokenType::COMMA})); // 循环解析用逗号分隔的参数
-    }
-    
-    consume(TokenType::RIGHT_PAREN, "Expected ')' after arguments.");
-    return args;
+std::string Parser::errorAt(const std::string& message) const {
+    SourceLocation location = m_source.locate(peek().offset);
+    return "Parser Error: " + message + " (at token '" + std::string(lexeme(peek())) + "', line " +
+           std::to_string(location.line) + ", column " + std::to_string(location.column) + ")";
 }
@@ -4,40 +4,89 @@
 
 #include "Token.h"
 #include "AST.h" // We need the AST node definitions
+#include "Arena.h"
+#include "Lexer.h"
+#include "Source.h"
+#include "TokenStream.h"
 #include <vector>
-#include <memory>
 #include <iostream>
 #include <string>
+#include <string_view>
 #include <unordered_set>
 
 class Parser {
 public:
-    // The constructor takes the list of tokens generated by the Lexer.
-    explicit Parser(const std::vector<Token>& tokens);
+    // The constructor takes the list of tokens generated by the Lexer, the
+    // source buffer they point into, and the arena that the AST's arrays are
+    // allocated from. Syntax errors are reported to `diagnostics`.
+    Parser(const TokenList& tokens, SourceBuffer source, Arena& arena, std::ostream& diagnostics = std::cerr);
+
+    // Streaming mode: tokens are pulled from the Lexer as they are needed
+    // instead of being tokenized up front (see TokenStream).
+    Parser(Lexer& lexer, SourceBuffer source, Arena& arena, std::ostream& diagnostics = std::cerr);
 
     // This is the main entry point for the parser.
-    // It will parse the entire sequence of tokens and return a list of statements,
-    // which represents the complete program's AST.
-    std::vector<std::unique_ptr<StatementNode>> parse();
-    const std::unordered_set<std::string> known_type_names = {"int", "float"};
+    // It will parse the entire sequence of tokens and return the complete
+    // program's AST, whose statements() list the top-level statements.
+    AST parse();
+
+    // True if parse() stopped because of a syntax error.
+    bool hadError() const { return m_had_error; }
+    const std::unordered_set<std::string_view> known_type_names = {"int", "float"};
 
 private:
     // --- State ---
-    const std::vector<Token>& m_tokens; // The token stream we're parsing
-    size_t m_current = 0;               // A cursor pointing to the next token to be consumed
+    TokenStream m_tokens;               // The token stream we're parsing
+    SourceBuffer m_source;              // The text the tokens point into
+    Arena& m_arena;                     // Backs the AST's arrays
+    AST m_ast;                          // The tree being built
+    std::ostream& m_diagnostics;        // Where syntax errors are reported
+    bool m_had_error = false;
+
+    // An operator, cast or bracket whose operands haven't all been parsed yet.
+    struct PendingOperator {
+        enum Kind : uint8_t { PREFIX, INFIX, CAST, GROUP, CALL } kind;
+        uint8_t power;          // Binding power; brackets have none
+        TokenType op;           // PREFIX, INFIX: the operator token
+        DataType target;        // CAST: the target type
+        uint32_t position;      // Source offset of the node to build
+        uint32_t argument_base; // CALL: where its arguments start in m_argument_stack
+        NodeIndex callee;       // CALL: the function being called
+    };
+
+    // The explicit stacks that replace recursion in parseExpression(). They
+    // keep their capacity from one expression to the next.
+    std::vector<PendingOperator> m_operators;
+    std::vector<NodeIndex> m_operands;
+
+    // Arguments of the calls currently being parsed. Nested calls share this
+    // stack, so collecting arguments doesn't allocate a vector per call.
+    std::vector<NodeIndex> m_argument_stack;
+
+    // The parameters and statements of the function being parsed. Functions
+    // don't nest, so one of each is enough.
+    std::vector<NodeIndex> m_parameters;
+    std::vector<NodeIndex> m_body;
 
     // --- Grammar Rule Methods ---
-    // Each of these methods corresponds to a rule in our language's grammar.
-    // They are the core of our recursive descent parser.
-    std::unique_ptr<StatementNode> parseStatement();
-    std::unique_ptr<StatementNode> parseLetStatement();
-    std::unique_ptr<StatementNode> parseExpressionStatement();
-    std::vector<std::unique_ptr<ExpressionNode>> parseArguments();
-    std::unique_ptr<ExpressionNode> parseCall(); // <-- ADD
-    std::unique_ptr<ExpressionNode> parseExpression();
-    std::unique_ptr<ExpressionNode> parseAddition();
-    std::unique_ptr<ExpressionNode> parseMultiplication();
-    std::unique_ptr<ExpressionNode> parsePrimary();
+    // Statements are parsed by recursive descent. Expressions are parsed by
+    // precedence climbing (a Pratt parser): one loop driven by the binding
+    // powers in Parser.cpp handles every prefix and infix operator, so a new
+    // operator is a new table entry rather than a new grammar method. That
+    // loop keeps its state on explicit stacks instead of recursing, so
+    // arbitrarily deep expressions can't overflow the native stack.
+    NodeIndex parseStatement();
+    NodeIndex parseFunction();
+    DataType parseTypeName(const std::string& message);
+    NodeIndex parseLetStatement();
+    NodeIndex parseExpressionStatement();
+    NodeIndex parseExpression();
+    NodeIndex parsePrimary();
+
+    // Helpers for parseExpression().
+    bool isCastAhead() const;
+    NodeIndex popOperand();
+    void reduceOperator();
 
     // --- Utility/Helper Methods ---
     // These are small tools that the grammar methods use to navigate
@@ -58,9 +107,15 @@ private:
     // Checks if the current token is of a specific type.
     bool check(TokenType type) const;
 
-    // Checks if the current token is one of several types.
-    // If it is, it consumes the token and returns true. Otherwise, returns false.
-    bool match(const std::vector<TokenType>& types);
+    // If the current token has the given type, consumes it and returns true.
+    // Otherwise, returns false.
+    bool match(TokenType type);
+
+    // The text of a token.
+    std::string_view lexeme(const Token& token) const { return m_source.lexeme(token); }
+
+    // Builds an error message that quotes the current token and its location.
+    std::string errorAt(const std::string& message) const;
 
     // Consumes the current token, but throws an error if it's not the expected type.
     // This is used for mandatory parts of the grammar (like a closing ';').
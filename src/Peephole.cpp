@@ -0,0 +1,276 @@
+#include "Peephole.h"
+#include <algorithm>
+
+// How far (in instructions) a pattern looks ahead for the other half of a
+// pair, or to prove a register or the flags dead.
+static constexpr size_t WINDOW = 32;
+
+// The rounds over the whole program; each round can expose new matches for
+// the next (a folded move becomes `mov X, X`, and so on).
+static constexpr int MAX_ROUNDS = 4;
+
+// Registers the code generator only uses within a single IR instruction or
+// terminator, so they are never live at a label or jump.
+static constexpr uint32_t SCRATCH = register_bit(Register::RAX) | register_bit(Register::RDX) |
+                                    register_bit(Register::R11) | register_bit(Register::XMM14) |
+                                    register_bit(Register::XMM15);
+
+static bool fits_imm32(int64_t value) {
+    return value >= INT32_MIN && value <= INT32_MAX;
+}
+
+static bool is_block_boundary(MachineOp op) {
+    return op == MachineOp::LABEL || op == MachineOp::JMP || op == MachineOp::JCC;
+}
+
+// Whether `mov dst, src` is encodable.
+static bool is_legal_move(const MachineOperand& dst, const MachineOperand& src) {
+    if (dst.kind == MachineOperand::REGISTER) return true;
+    if (dst.kind != MachineOperand::MEMORY) return false;
+    if (src.kind == MachineOperand::IMMEDIATE) return fits_imm32(src.value);
+    return src.kind == MachineOperand::REGISTER;
+}
+
+// Every stack slot is a distinct qword off rbp or rsp (whichever the frame
+// is addressed from), so two slots can only overlap if they are the same
+// slot. Memory off any other base might be anywhere.
+static bool may_alias(const MachineOperand& a, const MachineOperand& b) {
+    bool a_stack = a.reg == Register::RBP || a.reg == Register::RSP;
+    if (a_stack && a.reg == b.reg && a.scale == 0 && b.scale == 0) return a.value == b.value;
+    return true;
+}
+
+static bool writes_memory(const MachineInstr& instr, const MachineOperand& memory) {
+    switch (instr.op) {
+        case MachineOp::CMP:
+        case MachineOp::TEST:
+            return false;
+        default:
+            return instr.dst.kind == MachineOperand::MEMORY && may_alias(instr.dst, memory);
+    }
+}
+
+// Whether `instr` may change the value of `operand` (a register or memory).
+static bool clobbers(const MachineInstr& instr, const MachineEffects& effects, const MachineOperand& operand) {
+    switch (operand.kind) {
+        case MachineOperand::REGISTER:
+            return effects.writes & register_bit(operand.reg);
+        case MachineOperand::MEMORY:
+            return (effects.writes & registers_read_by(operand)) || writes_memory(instr, operand);
+        default:
+            return false;
+    }
+}
+
+namespace {
+
+class Peephole {
+public:
+    Peephole(MachineCode& code, PeepholeStats& stats) : m_instructions(code.instructions), m_stats(stats) {}
+
+    void run() {
+        for (int round = 0; round < MAX_ROUNDS; ++round) {
+            bool changed = false;
+            for (size_t i = 0; i < m_instructions.size(); ++i) {
+                if (m_instructions[i].op == MachineOp::NOP) continue;
+                changed |= removeRedundantMove(i) || foldMove(i) || forwardStore(i) || useZeroIdiom(i) ||
+                           eliminatePushPop(i);
+            }
+            if (!changed) break;
+        }
+        m_instructions.erase(std::remove_if(m_instructions.begin(), m_instructions.end(),
+                                            [](const MachineInstr& instr) { return instr.op == MachineOp::NOP; }),
+                             m_instructions.end());
+    }
+
+private:
+    std::vector<MachineInstr>& m_instructions;
+    PeepholeStats& m_stats;
+
+    // The next instruction after `i` that hasn't been deleted, or size().
+    size_t next(size_t i) const {
+        do {
+            ++i;
+        } while (i < m_instructions.size() && m_instructions[i].op == MachineOp::NOP);
+        return i;
+    }
+
+    void erase(size_t i) { m_instructions[i].op = MachineOp::NOP; }
+
+    // Whether the value of `reg` after instruction `i` is never read.
+    bool isDeadAfter(size_t i, Register reg) const {
+        uint32_t bit = register_bit(reg);
+        size_t seen = 0;
+        for (size_t k = next(i); k < m_instructions.size(); k = next(k)) {
+            if (++seen > WINDOW) return false;
+            MachineEffects effects = effects_of(m_instructions[k]);
+            if (effects.reads & bit) return false;
+            if (effects.writes & bit) return true;
+            if (is_block_boundary(m_instructions[k].op)) return (SCRATCH & bit) != 0;
+        }
+        return true; // The program has ended
+    }
+
+    // Whether the flags after instruction `i` are never read. Conditions
+    // are always tested right after they are set, so the flags are dead at
+    // any label, jump or call.
+    bool flagsDeadAfter(size_t i) const {
+        size_t seen = 0;
+        for (size_t k = next(i); k < m_instructions.size(); k = next(k)) {
+            if (++seen > WINDOW) return false;
+            MachineEffects effects = effects_of(m_instructions[k]);
+            if (effects.reads_flags) return false;
+            if (effects.writes_flags || effects.barrier) return true;
+        }
+        return true;
+    }
+
+    // mov X, X is deleted; so is the second move of mov A, B / mov B, A.
+    // The same goes for movsd.
+    bool removeRedundantMove(size_t i) {
+        const MachineInstr& instr = m_instructions[i];
+        if (instr.op != MachineOp::MOV && instr.op != MachineOp::MOVSD) return false;
+        if (instr.dst == instr.src) {
+            erase(i);
+            ++m_stats.redundant_moves;
+            return true;
+        }
+        size_t j = next(i);
+        if (j == m_instructions.size()) return false;
+        const MachineInstr& following = m_instructions[j];
+        if (following.op == instr.op && following.dst == instr.src && following.src == instr.dst) {
+            erase(j);
+            ++m_stats.redundant_moves;
+            return true;
+        }
+        return false;
+    }
+
+    // mov S, X / mov R, S becomes mov R, X when nothing reads S afterwards
+    // (movzx S, al / mov R, S likewise becomes movzx R, al).
+    bool foldMove(size_t i) {
+        const MachineInstr& instr = m_instructions[i];
+        if ((instr.op != MachineOp::MOV && instr.op != MachineOp::MOVZX) ||
+            instr.dst.kind != MachineOperand::REGISTER) {
+            return false;
+        }
+        size_t j = next(i);
+        if (j == m_instructions.size()) return false;
+        MachineInstr& following = m_instructions[j];
+        if (following.op != MachineOp::MOV || following.src != instr.dst || following.dst == instr.dst) return false;
+
+        bool legal = instr.op == MachineOp::MOV ? is_legal_move(following.dst, instr.src)
+                                                : following.dst.kind == MachineOperand::REGISTER;
+        if (!legal || !isDeadAfter(j, instr.dst.reg)) return false;
+
+        following.op = instr.op;
+        following.src = instr.src;
+        erase(i);
+        ++m_stats.redundant_moves;
+        return true;
+    }
+
+    // After mov [m], r, later reads of [m] read r instead, until r or [m]
+    // changes. A stored immediate is forwarded the same way.
+    bool forwardStore(size_t i) {
+        const MachineInstr& store = m_instructions[i];
+        if (store.op != MachineOp::MOV || store.dst.kind != MachineOperand::MEMORY) return false;
+        const MachineOperand slot = store.dst;
+        const MachineOperand value = store.src;
+        if (value.kind == MachineOperand::REGISTER && value.reg == slot.reg) return false;
+
+        bool changed = false;
+        size_t seen = 0;
+        for (size_t k = next(i); k < m_instructions.size() && ++seen <= WINDOW; k = next(k)) {
+            MachineInstr& instr = m_instructions[k];
+            MachineEffects effects = effects_of(instr);
+            if (effects.barrier) break;
+
+            switch (instr.op) {
+                case MachineOp::IMUL:
+                case MachineOp::IDIV:
+                    // The one-operand forms take no immediate.
+                    if (instr.dst.kind == MachineOperand::NONE && value.kind != MachineOperand::REGISTER) break;
+                    [[fallthrough]];
+                case MachineOp::MOV:
+                case MachineOp::ADD:
+                case MachineOp::SUB:
+                case MachineOp::XOR:
+                case MachineOp::CMP:
+                case MachineOp::PUSH:
+                    if (instr.src == slot) {
+                        instr.src = value;
+                        ++m_stats.forwarded_loads;
+                        changed = true;
+                    }
+                    // cmp [m], imm becomes cmp r, imm.
+                    if (instr.op == MachineOp::CMP && instr.dst == slot && value.kind == MachineOperand::REGISTER) {
+                        instr.dst = value;
+                        ++m_stats.forwarded_loads;
+                        changed = true;
+                    }
+                    break;
+                default:
+                    break;
+            }
+
+            if (clobbers(instr, effects, value) || writes_memory(instr, slot)) break;
+            if (effects.writes & register_bit(slot.reg)) break; // The slot itself moved
+        }
+        return changed;
+    }
+
+    // mov reg, 0 becomes the shorter xor reg, reg, which also breaks any
+    // dependency on the old value, as long as nothing reads the flags it sets.
+    bool useZeroIdiom(size_t i) {
+        MachineInstr& instr = m_instructions[i];
+        if (instr.op != MachineOp::MOV || instr.dst.kind != MachineOperand::REGISTER ||
+            instr.src != MachineOperand::immediate(0) || !flagsDeadAfter(i)) {
+            return false;
+        }
+        instr.op = MachineOp::XOR;
+        instr.src = instr.dst;
+        ++m_stats.zero_idioms;
+        return true;
+    }
+
+    // push X ... pop R becomes mov R, X at the pop, when X doesn't change in
+    // between and every push and pop in between is balanced.
+    bool eliminatePushPop(size_t i) {
+        const MachineInstr& push = m_instructions[i];
+        if (push.op != MachineOp::PUSH) return false;
+        const MachineOperand value = push.src;
+
+        size_t depth = 0;
+        size_t seen = 0;
+        for (size_t k = next(i); k < m_instructions.size() && ++seen <= WINDOW; k = next(k)) {
+            MachineInstr& instr = m_instructions[k];
+            MachineEffects effects = effects_of(instr);
+            if (effects.barrier) return false;
+
+            if (instr.op == MachineOp::POP && depth == 0) {
+                if (!is_legal_move(instr.dst, value)) return false;
+                instr.op = MachineOp::MOV;
+                instr.src = value;
+                erase(i);
+                ++m_stats.push_pop_pairs;
+                return true;
+            }
+            if (instr.op == MachineOp::PUSH) {
+                ++depth;
+            } else if (instr.op == MachineOp::POP) {
+                --depth;
+            } else if (effects.writes & register_bit(Register::RSP)) {
+                return false;
+            }
+            if (clobbers(instr, effects, value)) return false;
+        }
+        return false;
+    }
+};
+
+} // namespace
+
+void run_peephole(MachineCode& code, PeepholeStats& stats) {
+    Peephole(code, stats).run();
+}
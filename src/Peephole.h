@@ -0,0 +1,34 @@
+#pragma once
+
+#include "MachineCode.h"
+#include <cstddef>
+
+// How often each peephole pattern fired, for --stats.
+struct PeepholeStats {
+    size_t redundant_moves = 0; // Moves deleted or folded into the instruction that produced the value
+    size_t forwarded_loads = 0; // Reloads of a stack slot replaced by the register just stored to it
+    size_t zero_idioms = 0;     // `mov reg, 0` turned into `xor reg, reg`
+    size_t push_pop_pairs = 0;  // A push and its matching pop turned into one move
+
+    PeepholeStats& operator+=(const PeepholeStats& other) {
+        redundant_moves += other.redundant_moves;
+        forwarded_loads += other.forwarded_loads;
+        zero_idioms += other.zero_idioms;
+        push_pop_pairs += other.push_pop_pairs;
+        return *this;
+    }
+};
+
+// Rewrites short sequences of machine instructions into cheaper equivalent
+// ones, repeating until no pattern applies:
+//
+//   mov X, X                        (deleted)
+//   mov A, B / mov B, A             (the second move is deleted)
+//   mov S, X / mov R, S             mov R, X        if scratch S is dead after
+//   mov [m], r ... mov r2, [m]      mov r2, r       if neither r nor [m] changed
+//   mov reg, 0                      xor reg, reg    if the flags are dead
+//   push X ... pop R                mov R, X        if X didn't change
+//
+// Patterns only look within a basic block and a short window of
+// instructions, so the pass stays linear.
+void run_peephole(MachineCode& code, PeepholeStats& stats);
@@ -0,0 +1,174 @@
+#include "Pipeline.h"
+#include "AST.h"
+#include "ASTPrinter.h"
+#include "IRGenerator.h"
+#include "Lexer.h"
+#include "Parser.h"
+#include "SemanticAnalyzer.h"
+#include "SpscQueue.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <sstream>
+
+namespace {
+
+// A batch is cut at the first ';' or '}' outside any function after this
+// many tokens, so it always holds whole statements and whole functions.
+// Large enough that handing a batch over costs next to nothing, small
+// enough that a few in flight take little memory.
+constexpr size_t BATCH_TOKENS = 8192;
+
+// Batches waiting between two stages. A stage that gets this far ahead of
+// the next one waits for it.
+constexpr size_t QUEUE_CAPACITY = 4;
+
+// The tokens of one batch, in an arena of their own so they can be freed
+// before the rest of the batch.
+struct TokenChunk {
+    Arena arena;
+    TokenList tokens{&arena};
+};
+
+// A few statements on their way through the pipeline.
+struct Batch {
+    std::unique_ptr<TokenChunk> tokens = std::make_unique<TokenChunk>(); // Freed once parsed
+    Arena arena;                                                       // Backs the AST
+    AST ast{&arena};
+};
+
+// A null batch marks the end of the program.
+using BatchQueue = SpscQueue<std::unique_ptr<Batch>, QUEUE_CAPACITY>;
+
+} // namespace
+
+bool generate_ir_pipelined(SourceBuffer source, Arena& arena, IRModule& module, PipelineStats& stats,
+                           bool print_ast, std::ostream& out, std::ostream& err) {
+    BatchQueue lexed;   // Lexer -> parser
+    BatchQueue parsed;  // Parser -> type checker
+    BatchQueue checked; // Type checker -> IR generator
+
+    // Set after a syntax error: nothing later in the file can matter, so the
+    // lexer stops early.
+    std::atomic<bool> stop{false};
+
+    // Each stage's outcome, read once all of them are done.
+    bool syntax_failed = false;
+    std::ostringstream syntax_error;
+    std::exception_ptr semantic_error;
+    std::ostringstream warnings;
+    std::ostringstream ast_text;
+    std::exception_ptr ir_error;
+
+    ThreadPool pool(3);
+
+    // 1. Lexing: cuts the token stream into batches of whole statements.
+    // Each batch ends with an END_OF_FILE token of its own, just past its
+    // last ';' or '}', so the parser sees a complete program. Braces only
+    // enclose function bodies, so counting them is enough to stay out of one.
+    std::future<void> lexing = pool.submit([&] {
+        Arena unused; // Lexer::next() allocates nothing
+        Lexer lexer(source.text(), unused);
+        auto batch = std::make_unique<Batch>();
+        batch->tokens->tokens.reserve(BATCH_TOKENS + BATCH_TOKENS / 8);
+        int depth = 0;
+        while (!stop.load(std::memory_order_relaxed)) {
+            Token token = lexer.next();
+            batch->tokens->tokens.push_back(token);
+            if (token.type == TokenType::END_OF_FILE) {
+                lexed.push(std::move(batch));
+                break;
+            }
+            if (token.type == TokenType::LEFT_BRACE) ++depth;
+            if (token.type == TokenType::RIGHT_BRACE) --depth;
+            if ((token.type == TokenType::SEMICOLON || token.type == TokenType::RIGHT_BRACE) && depth <= 0 &&
+                batch->tokens->tokens.size() >= BATCH_TOKENS) {
+                Token end = token;
+                end.offset += end.length;
+                end.length = 0;
+                end.type = TokenType::END_OF_FILE;
+                batch->tokens->tokens.push_back(end);
+                lexed.push(std::move(batch));
+                batch = std::make_unique<Batch>();
+                batch->tokens->tokens.reserve(BATCH_TOKENS + BATCH_TOKENS / 8);
+            }
+        }
+        stats.tokens = lexer.tokenCount();
+        lexed.push(nullptr);
+    });
+
+    // 2. Parsing. After a syntax error the remaining batches are only drained.
+    std::future<void> parsing = pool.submit([&] {
+        while (std::unique_ptr<Batch> batch = lexed.pop()) {
+            if (syntax_failed) continue;
+            Parser parser(batch->tokens->tokens, source, batch->arena, syntax_error);
+            batch->ast = parser.parse();
+            if (parser.hadError()) {
+                syntax_failed = true;
+                stop.store(true, std::memory_order_relaxed);
+                continue;
+            }
+            stats.batches++;
+            stats.nodes += batch->ast.size();
+            stats.peak_batch_bytes = std::max(stats.peak_batch_bytes,
+                                              batch->tokens->arena.bytes_reserved() + batch->arena.bytes_reserved());
+            batch->tokens.reset();
+            parsed.push(std::move(batch));
+        }
+        parsed.push(nullptr);
+    });
+
+    // 3. Type checking. A semantic error is kept for later rather than
+    // reported: the phases run one after another would report a syntax error
+    // anywhere in the file instead, so the parser carries on regardless.
+    std::future<void> checking = pool.submit([&] {
+        Arena symbols;
+        TypeChecker typeChecker(symbols, warnings);
+        ASTPrinter printer(ast_text);
+        while (std::unique_ptr<Batch> batch = parsed.pop()) {
+            if (semantic_error) continue;
+            try {
+                typeChecker.analyze(batch->ast);
+                if (print_ast) printer.printStatements(batch->ast);
+            } catch (...) {
+                semantic_error = std::current_exception();
+                continue;
+            }
+            checked.push(std::move(batch));
+        }
+        checked.push(nullptr);
+    });
+
+    // 4. IR generation, on this thread. Each batch's AST is freed as soon
+    // as its code is generated.
+    IRGenerator irGenerator(arena);
+    while (std::unique_ptr<Batch> batch = checked.pop()) {
+        if (ir_error) continue;
+        try {
+            irGenerator.add(batch->ast);
+        } catch (...) {
+            ir_error = std::current_exception();
+        }
+    }
+    lexing.get();
+    parsing.get();
+    checking.get();
+
+    if (syntax_failed) {
+        err << syntax_error.str();
+        return false;
+    }
+    out << warnings.str();
+    if (semantic_error) std::rethrow_exception(semantic_error);
+    if (print_ast) {
+        ASTPrinter printer(out);
+        printer.printHeader();
+        out << ast_text.str();
+        printer.printFooter();
+    }
+    if (ir_error) std::rethrow_exception(ir_error);
+    module = irGenerator.finish();
+    return true;
+}
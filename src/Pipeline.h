@@ -0,0 +1,35 @@
+#pragma once
+
+#include "Arena.h"
+#include "IR.h"
+#include "Source.h"
+#include <cstddef>
+#include <iostream>
+
+// What the pipelined front end saw, for --stats.
+struct PipelineStats {
+    size_t tokens = 0;         // Including the final END_OF_FILE, as Lexer::tokenCount() counts them
+    size_t nodes = 0;          // AST nodes, over all batches
+    size_t batches = 0;
+    size_t peak_batch_bytes = 0; // The most any one batch's tokens and AST took up
+};
+
+// Lexes, parses, type-checks and generates IR for `source` as a pipeline:
+// each of the four phases runs on its own thread, and the program flows
+// through them in batches of whole top-level statements and functions,
+// handed from one phase to the next over bounded lock-free queues (see
+// SpscQueue.h). While the IR generator works on one batch, the type checker
+// can check the next, the parser parse the one after and the lexer scan
+// further still.
+//
+// Each batch's tokens and AST live in arenas of their own: the tokens are
+// freed as soon as they are parsed and the AST as soon as its IR exists,
+// so only the IR grows with the size of the program. Only the top level's IR
+// is allocated from `arena`; each function's has an arena of its own.
+//
+// The outcome is the same as running the phases one after another: returns
+// false after writing the first syntax error to `err`; otherwise writes the
+// type checker's warnings (and, with `print_ast`, the AST) to `out`, then
+// throws the first semantic error, if any.
+bool generate_ir_pipelined(SourceBuffer source, Arena& arena, IRModule& module, PipelineStats& stats,
+                           bool print_ast, std::ostream& out, std::ostream& err);
@@ -0,0 +1,350 @@
+#include "RegisterAllocator.h"
+#include <algorithm>
+#include <iterator>
+
+const char* register_name(Register reg) {
+    static const char* const NAMES[] = {
+        "rax", "rcx", "rdx", "rbx", "rsp", "rbp", "rsi", "rdi",
+        "r8",  "r9",  "r10", "r11", "r12", "r13", "r14", "r15",
+        "xmm0", "xmm1", "xmm2",  "xmm3",  "xmm4",  "xmm5",  "xmm6",  "xmm7",
+        "xmm8", "xmm9", "xmm10", "xmm11", "xmm12", "xmm13", "xmm14", "xmm15",
+    };
+    return NAMES[(int)reg];
+}
+
+bool is_caller_saved(Register reg) {
+    switch (reg) {
+        case Register::RBX:
+        case Register::RSP:
+        case Register::RBP:
+        case Register::R12:
+        case Register::R13:
+        case Register::R14:
+        case Register::R15:
+            return false;
+        default:
+            return true;
+    }
+}
+
+namespace {
+
+// The registers handed out, caller-saved first: values that don't live
+// across a call take those, leaving the callee-saved ones for values that do.
+constexpr Register ALLOCATABLE[] = {
+    Register::RCX, Register::RSI, Register::RDI, Register::R8,  Register::R9,  Register::R10,
+    Register::RBX, Register::R12, Register::R13, Register::R14, Register::R15,
+};
+
+// The xmm registers handed out to floats. xmm0-7 carry float arguments, so
+// they come last.
+constexpr Register ALLOCATABLE_XMM[] = {
+    Register::XMM8, Register::XMM9, Register::XMM10, Register::XMM11, Register::XMM12, Register::XMM13,
+    Register::XMM0, Register::XMM1, Register::XMM2,  Register::XMM3,  Register::XMM4,  Register::XMM5,
+    Register::XMM6, Register::XMM7,
+};
+
+struct LiveInterval {
+    uint32_t temp;
+    uint32_t start; // Position of the first definition, or of the start of the first block it's live into
+    uint32_t end;   // Position of the last use, or of the end of the last block it's live out of
+};
+
+class LinearScan {
+public:
+    explicit LinearScan(const IRProgram& program) : m_program(program) {}
+
+    RegisterAllocation run() {
+        m_result.locations.resize(m_program.temp_count);
+        numberPositions();
+        collectHints();
+        buildIntervals();
+        scan();
+        return std::move(m_result);
+    }
+
+private:
+    const IRProgram& m_program;
+    RegisterAllocation m_result;
+
+    // Block b's instructions are at m_block_start[b] + i, and its terminator
+    // at m_block_start[b] + instructions.size(), the block's last position.
+    std::vector<uint32_t> m_block_start;
+    std::vector<uint32_t> m_call_positions; // Sorted
+    std::vector<Register> m_hints;          // Preferred register of each temporary, RAX for none
+    std::vector<LiveInterval> m_intervals;
+
+    uint32_t blockEnd(BlockIndex b) const {
+        return m_block_start[b] + (uint32_t)m_program.blocks[b].instructions.size();
+    }
+
+    void numberPositions() {
+        m_block_start.resize(m_program.blocks.size());
+        uint32_t position = 0;
+        for (BlockIndex b = 0; b < m_program.blocks.size(); ++b) {
+            m_block_start[b] = position;
+            const auto& instructions = m_program.blocks[b].instructions;
+            for (uint32_t i = 0; i < instructions.size(); ++i) {
+                if (instructions[i].op == IROp::CALL) m_call_positions.push_back(position + i);
+            }
+            position += (uint32_t)instructions.size() + 1;
+        }
+    }
+
+    // A temporary passed as a register argument would rather be computed
+    // straight into that register, which saves the code generator a move
+    // at the call. Likewise a parameter would rather stay in the register
+    // it arrives in.
+    void collectHints() {
+        m_hints.assign(m_program.temp_count, Register::RAX);
+        if (!m_program.parameters.empty()) {
+            std::vector<Register> arrives_in(m_program.parameters.size(), Register::RAX);
+            size_t int_args = 0;
+            size_t float_args = 0;
+            for (size_t k = 0; k < m_program.parameters.size(); ++k) {
+                if (m_program.parameters[k] == DataType::FLOAT) {
+                    if (float_args < std::size(FLOAT_ARGUMENT_REGISTERS)) arrives_in[k] = FLOAT_ARGUMENT_REGISTERS[float_args++];
+                } else {
+                    if (int_args < std::size(INTEGER_ARGUMENT_REGISTERS)) arrives_in[k] = INTEGER_ARGUMENT_REGISTERS[int_args++];
+                }
+            }
+            for (const IRInstruction& instr : m_program.blocks[0].instructions) {
+                if (instr.op != IROp::ARGUMENT) break;
+                m_hints[instr.result.index()] = arrives_in[instr.count];
+            }
+        }
+        for (const IRBlock& block : m_program.blocks) {
+            for (size_t i = 0; i < block.instructions.size(); ++i) {
+                const IRInstruction& call = block.instructions[i];
+                if (call.op != IROp::CALL) continue;
+                size_t int_args = 0;
+                size_t float_args = 0;
+                for (size_t k = i; k-- > i - call.count;) { // The last PARAM is the first argument
+                    const IRInstruction& param = block.instructions[k];
+                    Register reg = Register::RAX;
+                    if (param.type == DataType::FLOAT) {
+                        if (float_args < std::size(FLOAT_ARGUMENT_REGISTERS)) reg = FLOAT_ARGUMENT_REGISTERS[float_args++];
+                    } else {
+                        if (int_args < std::size(INTEGER_ARGUMENT_REGISTERS)) reg = INTEGER_ARGUMENT_REGISTERS[int_args++];
+                    }
+                    if (param.arg1.kind() == IROperand::TEMP && m_hints[param.arg1.index()] == Register::RAX) {
+                        m_hints[param.arg1.index()] = reg;
+                    }
+                }
+            }
+        }
+    }
+
+    // Liveness one temporary at a time: from every use that isn't preceded
+    // by a definition in its own block, the temporary is live into that
+    // block, and out of each predecessor; the walk continues through
+    // predecessors that don't define it. Each block is visited at most once
+    // per temporary, so the work is proportional to the size of the live
+    // ranges.
+    void buildIntervals() {
+        // Definitions and uses of each temporary, grouped by temporary.
+        struct Occurrence {
+            uint32_t temp;
+            BlockIndex block;
+            uint32_t position;
+            bool is_def;
+        };
+        std::vector<Occurrence> occurrences;
+
+        // The code generator moves every argument out of the register (or
+        // stack slot) it arrived in before the first other instruction, all
+        // at once, so the arguments are all live until then.
+        if (!m_program.blocks.empty()) {
+            const auto& entry = m_program.blocks[0].instructions;
+            uint32_t arguments = 0;
+            while (arguments < entry.size() && entry[arguments].op == IROp::ARGUMENT) ++arguments;
+            for (uint32_t i = 0; i < arguments; ++i) {
+                occurrences.push_back({entry[i].result.index(), 0, m_block_start[0] + arguments, false});
+            }
+        }
+
+        for (BlockIndex b = 0; b < m_program.blocks.size(); ++b) {
+            const IRBlock& block = m_program.blocks[b];
+            for (uint32_t i = 0; i < block.instructions.size(); ++i) {
+                const IRInstruction& instr = block.instructions[i];
+                uint32_t position = m_block_start[b] + i;
+                forEachUse(instr, [&](IROperand operand) {
+                    if (operand.kind() == IROperand::TEMP) occurrences.push_back({operand.index(), b, position, false});
+                });
+                if (instr.result.kind() == IROperand::TEMP) {
+                    occurrences.push_back({instr.result.index(), b, position, true});
+                }
+            }
+            if (block.terminator.value.kind() == IROperand::TEMP) {
+                occurrences.push_back({block.terminator.value.index(), b, blockEnd(b), false});
+            }
+        }
+        std::stable_sort(occurrences.begin(), occurrences.end(),
+                         [](const Occurrence& a, const Occurrence& b) { return a.temp < b.temp; });
+
+        // Per-block scratch arrays, stamped with the temporary being
+        // processed (plus one) so they never need clearing.
+        std::vector<uint32_t> defined_in(m_program.blocks.size(), 0);
+        std::vector<uint32_t> first_def(m_program.blocks.size(), 0);
+        std::vector<uint32_t> live_in(m_program.blocks.size(), 0);
+        std::vector<BlockIndex> worklist;
+
+        for (size_t first = 0; first < occurrences.size();) {
+            uint32_t temp = occurrences[first].temp;
+            uint32_t stamp = temp + 1;
+            size_t last = first;
+            while (last < occurrences.size() && occurrences[last].temp == temp) ++last;
+
+            LiveInterval interval{temp, UINT32_MAX, 0};
+            for (size_t i = first; i < last; ++i) {
+                const Occurrence& occurrence = occurrences[i];
+                interval.start = std::min(interval.start, occurrence.position);
+                interval.end = std::max(interval.end, occurrence.position);
+                if (occurrence.is_def && defined_in[occurrence.block] != stamp) {
+                    defined_in[occurrence.block] = stamp;
+                    first_def[occurrence.block] = occurrence.position;
+                }
+            }
+
+            for (size_t i = first; i < last; ++i) {
+                const Occurrence& use = occurrences[i];
+                if (use.is_def) continue;
+                if (defined_in[use.block] == stamp && first_def[use.block] < use.position) continue;
+                if (live_in[use.block] == stamp) continue;
+                live_in[use.block] = stamp;
+                worklist.push_back(use.block);
+            }
+            while (!worklist.empty()) {
+                BlockIndex block = worklist.back();
+                worklist.pop_back();
+                interval.start = std::min(interval.start, m_block_start[block]);
+                for (BlockIndex pred : m_program.blocks[block].predecessors) {
+                    interval.end = std::max(interval.end, blockEnd(pred)); // Live out of pred
+                    if (defined_in[pred] != stamp && live_in[pred] != stamp) {
+                        live_in[pred] = stamp;
+                        worklist.push_back(pred);
+                    }
+                }
+            }
+            m_intervals.push_back(interval);
+            first = last;
+        }
+
+        std::sort(m_intervals.begin(), m_intervals.end(), [](const LiveInterval& a, const LiveInterval& b) {
+            return a.start != b.start ? a.start < b.start : a.temp < b.temp;
+        });
+    }
+
+    bool crossesCall(const LiveInterval& interval) const {
+        auto call = std::upper_bound(m_call_positions.begin(), m_call_positions.end(), interval.start);
+        return call != m_call_positions.end() && *call < interval.end;
+    }
+
+    void scan() {
+        struct Active {
+            uint32_t start;
+            uint32_t end;
+            uint32_t temp;
+        };
+        auto later = [](const Active& a, const Active& b) { return a.end > b.end; };
+        std::vector<Active> active;        // Intervals holding a register (at most one per register)
+        std::vector<Active> active_spills; // Intervals holding a stack slot, a min-heap on `end`
+        std::vector<uint32_t> free_slots;
+        std::vector<uint32_t> slot_free_since; // Where each slot's last occupant ended
+        bool register_free[32];
+        std::fill(std::begin(register_free), std::end(register_free), false);
+        for (Register reg : ALLOCATABLE) register_free[(int)reg] = true;
+        for (Register reg : ALLOCATABLE_XMM) register_free[(int)reg] = true;
+
+        // A temporary has one location for its whole interval, so one spilled
+        // while active needs a slot nobody has used since it started.
+        auto assignSlot = [&](uint32_t temp, uint32_t start, uint32_t end) {
+            uint32_t slot = m_result.spill_slots;
+            for (size_t i = free_slots.size(); i-- > 0;) {
+                if (slot_free_since[free_slots[i]] <= start) {
+                    slot = free_slots[i];
+                    free_slots.erase(free_slots.begin() + i);
+                    break;
+                }
+            }
+            if (slot == m_result.spill_slots) {
+                ++m_result.spill_slots;
+                slot_free_since.push_back(0);
+            }
+            m_result.locations[temp] = {TempLocation::STACK, Register::RAX, slot};
+            active_spills.push_back({start, end, temp});
+            std::push_heap(active_spills.begin(), active_spills.end(), later);
+            ++m_result.spilled;
+        };
+
+        for (const LiveInterval& interval : m_intervals) {
+            // Expire everything that ended before this interval starts (an
+            // interval ending where this one starts is only read there, so
+            // its register can receive the new value).
+            size_t kept = 0;
+            for (const Active& a : active) {
+                if (a.end <= interval.start) {
+                    register_free[(int)m_result.locations[a.temp].reg] = true;
+                } else {
+                    active[kept++] = a;
+                }
+            }
+            active.resize(kept);
+            while (!active_spills.empty() && active_spills.front().end <= interval.start) {
+                uint32_t slot = m_result.locations[active_spills.front().temp].slot;
+                free_slots.push_back(slot);
+                slot_free_since[slot] = active_spills.front().end;
+                std::pop_heap(active_spills.begin(), active_spills.end(), later);
+                active_spills.pop_back();
+            }
+
+            bool is_float = m_program.temp_types[interval.temp] == DataType::FLOAT;
+            bool callee_saved_only = crossesCall(interval);
+            auto allowed = [&](Register reg) {
+                return is_xmm(reg) == is_float && (!callee_saved_only || !is_caller_saved(reg));
+            };
+
+            Register chosen = m_hints[interval.temp];
+            bool found = register_free[(int)chosen] && allowed(chosen); // rax is never free
+            const Register* candidates = is_float ? ALLOCATABLE_XMM : ALLOCATABLE;
+            size_t candidate_count = is_float ? std::size(ALLOCATABLE_XMM) : std::size(ALLOCATABLE);
+            for (size_t i = 0; i < candidate_count && !found; ++i) {
+                Register reg = candidates[i];
+                if (register_free[(int)reg] && allowed(reg)) {
+                    chosen = reg;
+                    found = true;
+                    break;
+                }
+            }
+
+            if (!found) {
+                // Spill whichever interval ends last: the new one, or an
+                // active one holding a register this interval may use.
+                size_t victim = active.size();
+                for (size_t i = 0; i < active.size(); ++i) {
+                    if (!allowed(m_result.locations[active[i].temp].reg)) continue;
+                    if (victim == active.size() || active[i].end > active[victim].end) victim = i;
+                }
+                if (victim == active.size() || active[victim].end <= interval.end) {
+                    assignSlot(interval.temp, interval.start, interval.end);
+                    continue;
+                }
+                chosen = m_result.locations[active[victim].temp].reg;
+                Active spilled = active[victim];
+                active.erase(active.begin() + victim);
+                assignSlot(spilled.temp, spilled.start, spilled.end);
+            }
+
+            register_free[(int)chosen] = false;
+            m_result.locations[interval.temp] = {TempLocation::REGISTER, chosen, 0};
+            m_result.registers_used |= 1u << (int)chosen;
+            active.push_back({interval.start, interval.end, interval.temp});
+        }
+    }
+};
+
+} // namespace
+
+RegisterAllocation allocate_registers(const IRProgram& program) {
+    return LinearScan(program).run();
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "IR.h"
+#include <cstdint>
+#include <vector>
+
+// The x86-64 general-purpose registers, numbered as the instruction
+// encoding numbers them, followed by the SSE registers (xmm0 is 16).
+enum class Register : uint8_t {
+    RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+    R8, R9, R10, R11, R12, R13, R14, R15,
+    XMM0, XMM1, XMM2, XMM3, XMM4, XMM5, XMM6, XMM7,
+    XMM8, XMM9, XMM10, XMM11, XMM12, XMM13, XMM14, XMM15,
+};
+
+constexpr bool is_xmm(Register reg) {
+    return reg >= Register::XMM0;
+}
+
+// The full name of a register, e.g. "rax" or "xmm3".
+const char* register_name(Register reg);
+
+// True for the registers a called function may overwrite (System V ABI),
+// which includes every xmm register.
+bool is_caller_saved(Register reg);
+
+// The registers the System V ABI passes the first integer and float
+// arguments of a call in, in order.
+constexpr Register INTEGER_ARGUMENT_REGISTERS[] = {
+    Register::RDI, Register::RSI, Register::RDX, Register::RCX, Register::R8, Register::R9,
+};
+constexpr Register FLOAT_ARGUMENT_REGISTERS[] = {
+    Register::XMM0, Register::XMM1, Register::XMM2, Register::XMM3,
+    Register::XMM4, Register::XMM5, Register::XMM6, Register::XMM7,
+};
+
+// Where a temporary lives for its whole lifetime: a register, or one of the
+// 8-byte stack slots, numbered from 0 (the code generator lays out the frame).
+struct TempLocation {
+    enum Kind : uint8_t { NONE, REGISTER, STACK }; // NONE: the temporary is never used
+    Kind kind = NONE;
+    Register reg = Register::RAX;
+    uint32_t slot = 0;
+};
+
+// The result of register allocation for one program.
+struct RegisterAllocation {
+    std::vector<TempLocation> locations; // Indexed by temporary
+    uint32_t spill_slots = 0;            // Stack slots needed for spilled temporaries
+    uint32_t spilled = 0;                // Temporaries that didn't get a register
+    uint32_t registers_used = 0;         // Bit mask, by Register number
+};
+
+// Linear-scan register allocation (Poletto and Sarkar) for a program that is
+// out of SSA form.
+//
+// Blocks are laid out in index order and every instruction gets a position.
+// Liveness is computed per temporary by walking backwards from each use to
+// its definitions, and gives each temporary one live interval covering all
+// the positions where it may be live. Intervals are then scanned in order of
+// their start: each gets a free register, or, when none is left, whichever of
+// it and the active interval that ends last is spilled to a stack slot.
+// Stack slots are reused once the spilled interval has ended. A temporary
+// passed to a call prefers the register the ABI passes that argument in.
+//
+// Integer temporaries get general-purpose registers and float temporaries
+// (see IRProgram::temp_types) get xmm registers; each class is scanned with
+// its own registers. rax, rdx, r11, xmm14 and xmm15 are never allocated; the
+// code generator uses them as scratch registers. A value that is live across
+// a CALL only gets one of the callee-saved registers (rbx, r12-r15), so calls
+// never clobber it. No xmm register survives a call, so a float that lives
+// across one is always spilled.
+RegisterAllocation allocate_registers(const IRProgram& program);
@@ -0,0 +1,397 @@
+#include "SSA.h"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+// --- Def-use chains ---
+
+DefUseChains::DefUseChains(const IRProgram& program)
+    : m_definitions(program.temp_count),
+      m_defined(program.temp_count, 0),
+      m_redefined(program.temp_count, 0),
+      m_use_offsets(program.temp_count + 1, 0) {
+    auto define = [&](IROperand result, IRLocation location) {
+        if (result.kind() != IROperand::TEMP || result.index() >= program.temp_count) return;
+        if (m_defined[result.index()]) m_redefined[result.index()] = 1;
+        m_definitions[result.index()] = location;
+        m_defined[result.index()] = 1;
+    };
+
+    // Calls `use(operand, location)` for every operand read anywhere.
+    auto forEachUseIn = [&](auto&& use) {
+        for (BlockIndex b = 0; b < program.blocks.size(); ++b) {
+            const IRBlock& block = program.blocks[b];
+            for (uint32_t i = 0; i < block.phis.size(); ++i) {
+                for (IROperand incoming : block.phis[i].incoming) use(incoming, IRLocation{b, i, IRLocation::PHI});
+            }
+            for (uint32_t i = 0; i < block.instructions.size(); ++i) {
+                forEachUse(block.instructions[i], [&](IROperand operand) {
+                    use(operand, IRLocation{b, i, IRLocation::INSTRUCTION});
+                });
+            }
+            use(block.terminator.value, IRLocation{b, 0, IRLocation::TERMINATOR});
+        }
+    };
+    auto isTemp = [&](IROperand operand) {
+        return operand.kind() == IROperand::TEMP && operand.index() < program.temp_count;
+    };
+
+    // 1. Definitions, and how many uses each temporary has.
+    for (BlockIndex b = 0; b < program.blocks.size(); ++b) {
+        const IRBlock& block = program.blocks[b];
+        for (uint32_t i = 0; i < block.phis.size(); ++i) {
+            define(block.phis[i].result, {b, i, IRLocation::PHI});
+        }
+        for (uint32_t i = 0; i < block.instructions.size(); ++i) {
+            define(block.instructions[i].result, {b, i, IRLocation::INSTRUCTION});
+        }
+    }
+    forEachUseIn([&](IROperand operand, IRLocation) {
+        if (isTemp(operand)) ++m_use_offsets[operand.index() + 1];
+    });
+
+    // 2. Prefix sums give each temporary its slice of m_uses; fill them in.
+    for (uint32_t t = 0; t < program.temp_count; ++t) {
+        m_use_offsets[t + 1] += m_use_offsets[t];
+    }
+    m_uses.resize(m_use_offsets[program.temp_count]);
+    std::vector<uint32_t> next(m_use_offsets.begin(), m_use_offsets.end() - 1);
+    forEachUseIn([&](IROperand operand, IRLocation location) {
+        if (isTemp(operand)) m_uses[next[operand.index()]++] = location;
+    });
+}
+
+// --- Verifier ---
+
+namespace {
+
+class Verifier {
+public:
+    explicit Verifier(const IRProgram& program) : m_program(program) {}
+
+    void run() {
+        if (m_program.blocks.empty()) fail("the program has no blocks");
+        checkStructure();
+        if (m_program.in_ssa) checkSSA();
+    }
+
+private:
+    const IRProgram& m_program;
+    std::string m_where; // Describes what is being checked, for messages
+
+    [[noreturn]] void fail(const std::string& message) const {
+        throw std::runtime_error("IR Verifier: " + message + (m_where.empty() ? "" : " (" + m_where + ")"));
+    }
+
+    void checkOperand(IROperand operand, bool allow_none) const {
+        switch (operand.kind()) {
+            case IROperand::NONE:
+                if (!allow_none) fail("missing operand");
+                return;
+            case IROperand::TEMP:
+                if (operand.index() >= m_program.temp_count) fail("temporary out of range");
+                return;
+            case IROperand::CONSTANT:
+                if (operand.index() >= m_program.constants.size()) fail("constant out of range");
+                return;
+            case IROperand::SYMBOL:
+                if (operand.index() >= m_program.symbols.size()) fail("symbol out of range");
+                return;
+        }
+        fail("operand has an invalid kind");
+    }
+
+    void checkStructure() {
+        // The predecessor lists every block should have, from the terminators.
+        std::vector<std::vector<BlockIndex>> expected(m_program.blocks.size());
+
+        for (BlockIndex b = 0; b < m_program.blocks.size(); ++b) {
+            const IRBlock& block = m_program.blocks[b];
+            m_where = "b" + std::to_string(b);
+
+            if (!block.phis.empty() && !m_program.in_ssa) fail("phi outside SSA form");
+            for (const IRPhi& phi : block.phis) {
+                if (phi.result.kind() != IROperand::TEMP) fail("phi result is not a temporary");
+                checkOperand(phi.result, false);
+                if (phi.incoming.size() != block.predecessors.size()) {
+                    fail("phi has " + std::to_string(phi.incoming.size()) + " incoming values but the block has " +
+                         std::to_string(block.predecessors.size()) + " predecessors");
+                }
+                for (IROperand incoming : phi.incoming) checkOperand(incoming, false);
+            }
+
+            uint32_t pending_params = 0;
+            bool arguments_allowed = b == 0; // Until the first other instruction
+            for (size_t i = 0; i < block.instructions.size(); ++i) {
+                const IRInstruction& instr = block.instructions[i];
+                m_where = "b" + std::to_string(b) + ", instruction " + std::to_string(i);
+                if (instr.op == IROp::PARAM) {
+                    if (instr.result.kind() != IROperand::NONE) fail("PARAM has a result");
+                    checkOperand(instr.arg1, false);
+                    ++pending_params;
+                    continue;
+                }
+                if (instr.result.kind() != IROperand::TEMP) fail("result is not a temporary");
+                checkOperand(instr.result, false);
+                if (instr.op == IROp::ARGUMENT) {
+                    if (!arguments_allowed) fail("ARGUMENT after the start of the entry block");
+                    if (instr.count >= m_program.parameters.size()) fail("ARGUMENT beyond the parameters");
+                    if (instr.type != m_program.parameters[instr.count]) fail("ARGUMENT has the wrong type");
+                    continue;
+                }
+                arguments_allowed = false;
+                forEachUse(instr, [&](IROperand operand) { checkOperand(operand, false); });
+                if (instr.op == IROp::CALL) {
+                    if (instr.count != pending_params) fail("CALL is not preceded by exactly its PARAMs");
+                    pending_params = 0;
+                } else if (pending_params != 0) {
+                    fail("PARAM not followed by its CALL");
+                }
+            }
+
+            m_where = "b" + std::to_string(b) + ", terminator";
+            if (pending_params != 0) fail("PARAM not followed by its CALL");
+            const IRTerminator& terminator = block.terminator;
+            switch (terminator.kind) {
+                case IRTerminator::NONE:
+                    fail("block is not terminated");
+                case IRTerminator::BRANCH:
+                    checkOperand(terminator.value, false);
+                    break;
+                case IRTerminator::RETURN:
+                    checkOperand(terminator.value, true);
+                    break;
+                case IRTerminator::JUMP:
+                    break;
+            }
+            for (uint32_t k = 0; k < terminator.successor_count(); ++k) {
+                if (terminator.targets[k] >= m_program.blocks.size()) fail("branch target out of range");
+                expected[terminator.targets[k]].push_back(b);
+            }
+        }
+
+        for (BlockIndex b = 0; b < m_program.blocks.size(); ++b) {
+            m_where = "b" + std::to_string(b);
+            std::vector<BlockIndex> actual(m_program.blocks[b].predecessors.begin(),
+                                           m_program.blocks[b].predecessors.end());
+            std::sort(actual.begin(), actual.end());
+            std::sort(expected[b].begin(), expected[b].end());
+            if (actual != expected[b]) fail("predecessor list doesn't match the CFG edges");
+        }
+        m_where.clear();
+    }
+
+    void checkSSA() {
+        DefUseChains chains(m_program);
+        DominatorTree dominators(m_program);
+
+        for (uint32_t t = 0; t < m_program.temp_count; ++t) {
+            m_where = "t" + std::to_string(t);
+            if (chains.redefined(t)) fail("temporary is defined more than once");
+            if (chains.uses(t).size() == 0) continue;
+            if (!chains.defined(t)) fail("temporary is used but never defined");
+
+            const IRLocation& def = chains.definition(t);
+            for (const IRLocation& use : chains.uses(t)) {
+                if (!dominators.reachable(use.block)) continue; // Dead code can't misbehave
+                if (!definitionReaches(dominators, def, use, t)) {
+                    fail("use in b" + std::to_string(use.block) + " is not dominated by the definition in b" +
+                         std::to_string(def.block));
+                }
+            }
+        }
+        m_where.clear();
+    }
+
+    bool definitionReaches(const DominatorTree& dominators, const IRLocation& def, const IRLocation& use,
+                           uint32_t temp) const {
+        if (use.where == IRLocation::PHI) {
+            // Each incoming value must be available at the end of the
+            // predecessor it comes from.
+            const IRBlock& block = m_program.blocks[use.block];
+            const IRPhi& phi = block.phis[use.index];
+            for (size_t i = 0; i < phi.incoming.size(); ++i) {
+                if (phi.incoming[i] == IROperand::temp(temp) &&
+                    !dominators.dominates(def.block, block.predecessors[i])) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        if (def.block != use.block) return dominators.dominates(def.block, use.block);
+
+        // Same block: phis come first, then instructions in order.
+        if (def.where == IRLocation::PHI || use.where == IRLocation::TERMINATOR) return true;
+        return def.index < use.index;
+    }
+};
+
+} // namespace
+
+void verify_ir(const IRProgram& program) {
+    Verifier(program).run();
+}
+
+// --- CFG cleanup ---
+
+size_t remove_unreachable_blocks(IRProgram& program) {
+    if (program.blocks.empty()) return 0;
+
+    std::vector<uint8_t> reachable(program.blocks.size(), 0);
+    std::vector<BlockIndex> stack{0};
+    reachable[0] = 1;
+    while (!stack.empty()) {
+        const IRTerminator& terminator = program.blocks[stack.back()].terminator;
+        stack.pop_back();
+        for (uint32_t k = 0; k < terminator.successor_count(); ++k) {
+            if (!reachable[terminator.targets[k]]) {
+                reachable[terminator.targets[k]] = 1;
+                stack.push_back(terminator.targets[k]);
+            }
+        }
+    }
+
+    // Keep as many slots for each predecessor as it has edges to the block.
+    std::vector<uint8_t> remaining(program.blocks.size(), 0);
+    std::vector<uint32_t> kept;
+    for (BlockIndex b = 0; b < program.blocks.size(); ++b) {
+        if (!reachable[b]) continue;
+        IRBlock& block = program.blocks[b];
+
+        for (BlockIndex pred : block.predecessors) {
+            const IRTerminator& terminator = program.blocks[pred].terminator;
+            uint8_t edges = 0;
+            if (reachable[pred]) {
+                for (uint32_t k = 0; k < terminator.successor_count(); ++k) edges += terminator.targets[k] == b;
+            }
+            remaining[pred] = edges;
+        }
+        kept.clear();
+        for (uint32_t slot = 0; slot < block.predecessors.size(); ++slot) {
+            BlockIndex pred = block.predecessors[slot];
+            if (remaining[pred] > 0) {
+                --remaining[pred];
+                kept.push_back(slot);
+            }
+        }
+        if (kept.size() == block.predecessors.size()) continue;
+
+        auto compact = [&](auto& list) {
+            for (uint32_t i = 0; i < kept.size(); ++i) list[i] = list[kept[i]];
+            list.resize(kept.size());
+        };
+        compact(block.predecessors);
+        for (IRPhi& phi : block.phis) compact(phi.incoming);
+    }
+
+    std::vector<BlockIndex> renumbered(program.blocks.size(), NO_BLOCK);
+    BlockIndex count = 0;
+    for (BlockIndex b = 0; b < program.blocks.size(); ++b) {
+        if (reachable[b]) renumbered[b] = count++;
+    }
+    size_t removed = program.blocks.size() - count;
+    if (removed == 0) return 0;
+
+    for (BlockIndex b = 0; b < program.blocks.size(); ++b) {
+        if (!reachable[b]) continue;
+        IRBlock& block = program.blocks[b];
+        for (uint32_t k = 0; k < block.terminator.successor_count(); ++k) {
+            block.terminator.targets[k] = renumbered[block.terminator.targets[k]];
+        }
+        for (BlockIndex& pred : block.predecessors) pred = renumbered[pred];
+        if (renumbered[b] != b) program.blocks[renumbered[b]] = std::move(block);
+    }
+    while (program.blocks.size() > count) program.blocks.pop_back(); // IRBlock isn't default-constructible
+    return removed;
+}
+
+// --- Leaving SSA form ---
+
+// Splits every critical edge into a block that has phis, so each phi copy
+// can be placed on exactly one edge.
+static void splitCriticalEdges(IRProgram& program) {
+    BlockIndex original_count = (BlockIndex)program.blocks.size();
+    for (BlockIndex b = 0; b < original_count; ++b) {
+        if (program.blocks[b].phis.empty() || program.blocks[b].predecessors.size() < 2) continue;
+
+        for (size_t i = 0; i < program.blocks[b].predecessors.size(); ++i) {
+            BlockIndex pred = program.blocks[b].predecessors[i];
+            if (program.blocks[pred].terminator.successor_count() < 2) continue;
+
+            BlockIndex middle = program.add_block(); // May move the blocks
+
+            // Retarget one edge pred -> b (a branch could target b twice;
+            // the first target still pointing at b is this edge).
+            IRTerminator& terminator = program.blocks[pred].terminator;
+            for (BlockIndex& target : terminator.targets) {
+                if (target == b) {
+                    target = middle;
+                    break;
+                }
+            }
+            program.blocks[middle].terminator = {IRTerminator::JUMP, {}, {b, NO_BLOCK}};
+            program.blocks[middle].predecessors.push_back(pred);
+            program.blocks[b].predecessors[i] = middle;
+        }
+    }
+}
+
+// Appends `dest_i = src_i` for all i to `block` as if they happened at once.
+// A copy is safe to emit once no other pending copy still reads its
+// destination; if every pending copy is blocked they form a cycle, which is
+// broken by saving one destination in a fresh temporary.
+static void emitParallelCopies(IRProgram& program, BlockIndex block, std::vector<IRInstruction>& copies) {
+    auto readByOthers = [&](size_t j) {
+        for (size_t k = 0; k < copies.size(); ++k) {
+            if (k != j && copies[k].arg1 == copies[j].result) return true;
+        }
+        return false;
+    };
+
+    while (!copies.empty()) {
+        size_t ready = copies.size();
+        for (size_t j = 0; j < copies.size(); ++j) {
+            if (!readByOthers(j)) {
+                ready = j;
+                break;
+            }
+        }
+
+        if (ready == copies.size()) {
+            // A cycle: save copies[0]'s destination and read it from there.
+            IROperand saved = program.new_temporary(copies[0].type);
+            IROperand overwritten = copies[0].result;
+            program.blocks[block].instructions.push_back({IROp::COPY, copies[0].type, 0, saved, overwritten, {}});
+            for (IRInstruction& copy : copies) {
+                if (copy.arg1 == overwritten) copy.arg1 = saved;
+            }
+            ready = 0;
+        }
+
+        program.blocks[block].instructions.push_back(copies[ready]);
+        copies.erase(copies.begin() + ready);
+    }
+}
+
+void lower_out_of_ssa(IRProgram& program) {
+    if (!program.in_ssa) return;
+    splitCriticalEdges(program);
+
+    std::vector<IRInstruction> copies;
+    for (BlockIndex b = 0; b < program.blocks.size(); ++b) {
+        if (program.blocks[b].phis.empty()) continue;
+
+        for (size_t i = 0; i < program.blocks[b].predecessors.size(); ++i) {
+            copies.clear();
+            for (const IRPhi& phi : program.blocks[b].phis) {
+                if (phi.incoming[i] != phi.result) {
+                    copies.push_back({IROp::COPY, phi.type, 0, phi.result, phi.incoming[i], {}});
+                }
+            }
+            emitParallelCopies(program, program.blocks[b].predecessors[i], copies);
+        }
+        program.blocks[b].phis.clear();
+    }
+    program.in_ssa = false;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "Dominators.h"
+#include "IR.h"
+#include <vector>
+
+// Where a temporary is defined or used inside an IRProgram.
+struct IRLocation {
+    enum Where : uint8_t { PHI, INSTRUCTION, TERMINATOR };
+    BlockIndex block;
+    uint32_t index; // Into the block's phis or instructions (unused for TERMINATOR)
+    Where where;
+};
+
+// A run of locations, as returned by DefUseChains::uses().
+struct IRLocationRange {
+    const IRLocation* first = nullptr;
+    const IRLocation* last = nullptr;
+
+    const IRLocation* begin() const { return first; }
+    const IRLocation* end() const { return last; }
+    size_t size() const { return last - first; }
+};
+
+// Def-use chains of an SSA program: for every temporary, the one place that
+// defines it and every place that uses it. The uses of all temporaries are
+// stored back to back in one array (compressed sparse rows). A phi's use of
+// its i-th incoming value is recorded at the phi itself.
+//
+// Like DominatorTree, this is a snapshot of the program when it was built.
+class DefUseChains {
+public:
+    explicit DefUseChains(const IRProgram& program);
+
+    bool defined(uint32_t temp) const { return m_defined[temp]; }
+    const IRLocation& definition(uint32_t temp) const { return m_definitions[temp]; }
+    IRLocationRange uses(uint32_t temp) const {
+        return {m_uses.data() + m_use_offsets[temp], m_uses.data() + m_use_offsets[temp + 1]};
+    }
+
+    // True if `temp` is defined more than once (never the case in valid SSA).
+    bool redefined(uint32_t temp) const { return m_redefined[temp]; }
+
+private:
+    std::vector<IRLocation> m_definitions;
+    std::vector<uint8_t> m_defined;
+    std::vector<uint8_t> m_redefined;
+    std::vector<uint32_t> m_use_offsets; // temp_count + 1 entries
+    std::vector<IRLocation> m_uses;
+};
+
+// Checks that `program` is well formed, and throws std::runtime_error
+// describing the first problem found. Always checked: every block is
+// terminated, targets and operands are in range, predecessor lists match the
+// edges, and every CALL is directly preceded by its PARAMs. In SSA form,
+// also: each phi has one incoming value per predecessor, every temporary is
+// defined exactly once, and every use is dominated by its definition.
+void verify_ir(const IRProgram& program);
+
+// Removes the blocks that can't be reached from the entry block and
+// renumbers the rest, keeping their order. Predecessor slots (and the phi
+// operands that go with them) for edges that no terminator has any more are
+// dropped too. Returns the number of blocks removed.
+size_t remove_unreachable_blocks(IRProgram& program);
+
+// Leaves SSA form: each phi becomes a copy at the end of every predecessor.
+// Critical edges (from a block with several successors to a block with
+// several predecessors) are split first, so the copies run only on the edge
+// they belong to, and the copies for one edge are ordered (with a scratch
+// temporary if they form a cycle) to behave like the simultaneous
+// assignment the phis describe.
+void lower_out_of_ssa(IRProgram& program);
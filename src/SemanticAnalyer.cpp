@@ -1,69 +1,125 @@
 #include "SemanticAnalyzer.h"
+#include <stdexcept>
 
-void TypeChecker::analyze(const std::vector<std::unique_ptr<StatementNode>>& statements) {
-    for (const auto& stmt : statements) {
-        stmt->accept(*this);
+TypeChecker::TypeChecker(Arena& arena, std::ostream& diagnostics)
+    : m_variables(&arena), m_diagnostics(diagnostics), m_functions(&arena), m_parameter_types(&arena),
+      m_external_callees(&arena), m_outer_variables(&arena), m_function_names(&arena) {}
+
+// The AST stores children before their parents (see AST.h), so a single pass
+// over the node arrays visits every expression after its operands.
+void TypeChecker::analyze(AST& ast) {
+    for (NodeIndex node = 0; node < ast.size(); ++node) {
+        switch (ast.kind(node)) {
+            case NodeKind::LET_STATEMENT:   checkLet(ast, node); break;
+            case NodeKind::IDENTIFIER:      checkIdentifier(ast, node); break;
+            case NodeKind::UNARY_OP:        checkUnaryOp(ast, node); break;
+            case NodeKind::BINARY_OP:       checkBinaryOp(ast, node); break;
+            case NodeKind::CAST:            checkCast(ast, node); break;
+            case NodeKind::FUNCTION_CALL:   checkFunctionCall(ast, node); break;
+            case NodeKind::FUNCTION:        checkFunction(ast, node); break;
+            case NodeKind::RETURN_STATEMENT: checkReturn(ast, node); break;
+            // An expression statement has nothing to check beyond its expression.
+            case NodeKind::EXPRESSION_STATEMENT: checkStatementEnd(ast); break;
+
+            // Literals are the base cases. Their type is set when they are created.
+            case NodeKind::INTEGER_LITERAL:
+            case NodeKind::FLOAT_LITERAL:
+            // Parameters are declared by their function, which comes after them.
+            case NodeKind::PARAMETER:
+                break;
+        }
     }
 }
 
-// For a statement, we just need to analyze the expressions within it.
-void TypeChecker::visit(const LetStatementNode& node) {
-    node.initializer->accept(*this);
+// Remember the variable's type so later uses of it can be checked.
+// A variable can't share its name with a function: calls are by name, and
+// there are no function values to call through a variable.
+void TypeChecker::checkLet(AST& ast, NodeIndex node) {
+    checkStatementEnd(ast);
+    if (m_functions.count(ast.name(node)) != 0) {
+        throw std::runtime_error("Semantic Error: '" + std::string(ast.name(node)) +
+                                 "' is already a function and can't be declared as a variable.");
+    }
+    m_variables[ast.name(node)] = ast.type(ast.rhs(node));
 }
 
-void TypeChecker::visit(const ExpressionStatementNode& node) {
-    node.expression->accept(*this);
+// Variables get the type recorded by their 'let'. Anything we have not seen
+// declared (e.g. the name of an external function) is assumed to be an INT.
+// The name of a function of the program is only valid as a callee, which
+// the call itself settles (see m_function_names).
+void TypeChecker::checkIdentifier(AST& ast, NodeIndex node) {
+    auto it = m_variables.find(ast.name(node));
+    if (it == m_variables.end() && m_functions.count(ast.name(node)) != 0) {
+        m_function_names.push_back(node);
+    }
+    ast.set_type(node, (it != m_variables.end()) ? it->second : DataType::INT);
 }
 
-// Literals are the base cases for our recursion. Their type is already known.
-void TypeChecker::visit(const IntegerLiteralNode& node) {
-    // The type is set in the constructor, so there's nothing to do here.
+// Every function named in the statement just finished must have been called.
+void TypeChecker::checkStatementEnd(AST& ast) {
+    if (m_function_names.empty()) return;
+    throw std::runtime_error("Semantic Error: Function '" + std::string(ast.name(m_function_names.back())) +
+                             "' is used as a value; it can only be called.");
 }
 
-void TypeChecker::visit(const FloatLiteralNode& node) {
-    // The type is set in the constructor, so there's nothing to do here.
+// Negation keeps the operand's type; logical not always yields 0 or 1.
+void TypeChecker::checkUnaryOp(AST& ast, NodeIndex node) {
+    DataType operandType = ast.type(ast.lhs(node));
+    if (operandType != DataType::INT && operandType != DataType::FLOAT) {
+        throw std::runtime_error("Semantic Error: Incompatible type for unary operator.");
+    }
+    ast.set_type(node, ast.op(node) == TokenType::BANG ? DataType::INT : operandType);
 }
 
-// For now, we need to make an assumption about an identifier's type.
-// A real compiler would use a "symbol table" to look this up.
-void TypeChecker::visit(const IdentifierNode& node) {
-    // For testing purposes, let's assume any variable found is an INT.
-    const_cast<IdentifierNode&>(node).type = DataType::INT;
+// True for the operators that compare or combine their operands and yield
+// 0 or 1.
+static bool yieldsTruthValue(TokenType op) {
+    switch (op) {
+        case TokenType::AND_AND:
+        case TokenType::OR_OR:
+        case TokenType::EQUAL_EQUAL:
+        case TokenType::BANG_EQUAL:
+        case TokenType::LESS:
+        case TokenType::LESS_EQUAL:
+        case TokenType::GREATER:
+        case TokenType::GREATER_EQUAL:
+            return true;
+        default:
+            return false;
+    }
 }
 
 // This is the core logic for type checking expressions.
-void TypeChecker::visit(const BinaryOpNode& node) {
-    // 1. Recursively visit the left and right children to compute their types first.
-    node.left->accept(*this);
-    node.right->accept(*this);
+void TypeChecker::checkBinaryOp(AST& ast, NodeIndex node) {
+    DataType leftType = ast.type(ast.lhs(node));
+    DataType rightType = ast.type(ast.rhs(node));
 
-    DataType leftType = node.left->type;
-    DataType rightType = node.right->type;
-
-    // 2. Apply our language's type rules.
-    if (leftType == DataType::FLOAT || rightType == DataType::FLOAT) {
+    // Apply our language's type rules.
+    bool numeric = (leftType == DataType::INT || leftType == DataType::FLOAT) &&
+                   (rightType == DataType::INT || rightType == DataType::FLOAT);
+    if (numeric && yieldsTruthValue(ast.op(node))) {
+        // Comparisons and logical operators always produce an int truth value.
+        ast.set_type(node, DataType::INT);
+    }
+    else if (leftType == DataType::FLOAT || rightType == DataType::FLOAT) {
         // Type Promotion Rule: If either operand is a float, the result is a float.
-        const_cast<BinaryOpNode&>(node).type = DataType::FLOAT;
+        ast.set_type(node, DataType::FLOAT);
     }
     else if (leftType == DataType::INT && rightType == DataType::INT) {
         // If both are ints, the result is an int.
-        const_cast<BinaryOpNode&>(node).type = DataType::INT;
+        ast.set_type(node, DataType::INT);
     }
     else {
         // The types are incompatible (e.g., UNKNOWN or some future type like STRING).
         throw std::runtime_error("Semantic Error: Incompatible types for binary operator.");
     }
 }
-void TypeChecker::visit(const CastNode& node) {
-    // 1. First, recursively visit the inner expression to determine its original type.
-    // This will fill in the `.type` field of `node.expression`.
-    node.expression->accept(*this);
 
-    // 2. Get the original (source) type and the requested target type.
-    DataType sourceType = node.expression->type;
-    DataType targetType = node.targetType;
+void TypeChecker::checkCast(AST& ast, NodeIndex node) {
+    // The type of the cast expression was set to the target type by the parser.
+    DataType sourceType = ast.type(ast.lhs(node));
+    DataType targetType = ast.type(node);
 
-    // 3. (Optional but good practice) Validate the cast.
     // In our simple language with only INT and FLOAT, most casts are valid.
     // A more complex language would have much stricter rules here.
     if (sourceType == DataType::UNKNOWN || sourceType == DataType::VOID) {
@@ -74,27 +130,91 @@ void TypeChecker::visit(const CastNode& node) {
     if (sourceType == DataType::FLOAT && targetType == DataType::INT) {
         // This is a valid conversion, but may result in loss of precision.
         // A real-world compiler would typically emit a warning for the user.
-        std::cout << "Warning: Potential data loss on conversion from FLOAT to INT.\n";
+        m_diagnostics << "Warning: Potential data loss on conversion from FLOAT to INT.\n";
     }
+}
 
-    // 4. The type of the entire cast expression IS the target type.
-    // This is the main purpose of this function.
-    // We use const_cast because the visitor takes a const reference by default,
-    // but our specific job here is to intentionally modify the node's type field.
-    const_cast<CastNode&>(node).type = targetType;
+// Only a function can be called, by name. Calls of a function defined
+// earlier (or of the one being defined) are checked against its signature:
+// the arity must match, and each argument must convert to its parameter's
+// type the way a return value would. Any other name is an external
+// function, assumed to return an INT.
+void TypeChecker::checkFunctionCall(AST& ast, NodeIndex node) {
+    NodeIndex callee = ast.lhs(node);
+    if (ast.kind(callee) != NodeKind::IDENTIFIER) {
+        throw std::runtime_error("Semantic Error: Only a function can be called, by its name.");
+    }
+    std::string_view name = ast.name(callee);
+    if (m_variables.count(name) != 0) {
+        throw std::runtime_error("Semantic Error: '" + std::string(name) + "' is a variable, not a function.");
+    }
+    auto it = m_functions.find(name);
+    if (!m_function_names.empty() && m_function_names.back() == callee) m_function_names.pop_back();
+    if (it == m_functions.end()) {
+        m_external_callees.insert(name);
+        ast.set_type(node, DataType::INT);
+        return;
+    }
+
+    const FunctionSignature& signature = it->second;
+    NodeRange arguments = ast.arguments(node);
+    if (arguments.size() != signature.parameter_count) {
+        throw std::runtime_error("Semantic Error: Function '" + std::string(name) + "' takes " +
+                                 std::to_string(signature.parameter_count) + " argument(s) but is called with " +
+                                 std::to_string(arguments.size()) + ".");
+    }
+    for (uint32_t i = 0; i < arguments.size(); ++i) {
+        if (ast.type(arguments[i]) == DataType::FLOAT &&
+            m_parameter_types[signature.first_parameter + i] == DataType::INT) {
+            throw std::runtime_error("Semantic Error: Argument " + std::to_string(i + 1) + " of '" +
+                                     std::string(name) + "' is an INT, but a FLOAT is passed.");
+        }
+    }
+    ast.set_type(node, signature.return_type);
 }
-// In src/SemanticAnalyzer.cpp, inside the TypeChecker class
 
-void TypeChecker::visit(const FunctionCallNode& node) {
-    // 1. Recursively visit the callee and all arguments to ensure their types are computed first.
-    node.callee->accept(*this);
-    for (const auto& arg : node.arguments) {
-        arg->accept(*this);
+// Opens the function's scope: the body that follows sees its parameters and
+// the functions defined so far, including this one, but none of the top
+// level's variables.
+void TypeChecker::checkFunction(AST& ast, NodeIndex node) {
+    std::string_view name = ast.name(node);
+    if (m_functions.count(name) != 0) {
+        throw std::runtime_error("Semantic Error: Function '" + std::string(name) + "' is already defined.");
+    }
+    if (m_external_callees.count(name) != 0) {
+        throw std::runtime_error("Semantic Error: Function '" + std::string(name) +
+                                 "' is called before it is defined.");
+    }
+    if (m_variables.count(name) != 0) {
+        throw std::runtime_error("Semantic Error: '" + std::string(name) +
+                                 "' is already a variable and can't be defined as a function.");
+    }
+
+    m_variables.swap(m_outer_variables);
+    m_variables.clear();
+    NodeRange parameters = ast.parameters(node);
+    m_functions[name] = {ast.type(node), (uint32_t)m_parameter_types.size(), parameters.size()};
+    for (NodeIndex parameter : parameters) {
+        if (m_functions.count(ast.name(parameter)) != 0) {
+            throw std::runtime_error("Semantic Error: '" + std::string(ast.name(parameter)) +
+                                     "' is already a function and can't be declared as a parameter.");
+        }
+        if (!m_variables.emplace(ast.name(parameter), ast.type(parameter)).second) {
+            throw std::runtime_error("Semantic Error: Function '" + std::string(name) + "' has two parameters named '" +
+                                     std::string(ast.name(parameter)) + "'.");
+        }
+        m_parameter_types.push_back(ast.type(parameter));
     }
+}
 
-    // 2. Determine the function's return type.
-    // In a real compiler, you would look up node.callee in a symbol table
-    // to find its signature and return type.
-    // For now, as a placeholder, we'll just assume any function call returns an INT.
-    const_cast<FunctionCallNode&>(node).type = DataType::INT;
+// An INT return value is converted to a FLOAT return type; the other way
+// round would silently lose the fraction, so it takes an explicit cast.
+void TypeChecker::checkReturn(AST& ast, NodeIndex node) {
+    checkStatementEnd(ast);
+    NodeIndex function = ast.rhs(node);
+    if (ast.type(ast.lhs(node)) == DataType::FLOAT && ast.type(function) == DataType::INT) {
+        throw std::runtime_error("Semantic Error: Function '" + std::string(ast.name(function)) +
+                                 "' returns an INT, but the value returned is a FLOAT.");
+    }
+    m_variables.swap(m_outer_variables);
 }
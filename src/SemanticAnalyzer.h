@@ -1,22 +1,64 @@
 #pragma once
 
 #include "AST.h"
+#include "Arena.h"
 #include <iostream>
+#include <memory_resource>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 // The TypeChecker class will walk the AST and determine the type of each expression.
-class TypeChecker : public ASTVisitor {
+class TypeChecker {
 public:
-    // Run the analysis on a complete program (a list of statements).
+    // The checker's own bookkeeping (the symbol table) lives in the session
+    // arena. Warnings are written to `diagnostics`.
+    explicit TypeChecker(Arena& arena, std::ostream& diagnostics = std::cout);
     ~TypeChecker() = default;
-    void analyze(const std::vector<std::unique_ptr<StatementNode>>& statements);
-
-    // Override the visit method for each node type we have implemented.
-    void visit(const LetStatementNode& node) override;
-    void visit(const ExpressionStatementNode& node) override;
-    void visit(const FunctionCallNode& node) override;
-    void visit(const BinaryOpNode& node) override;
-    void visit(const IntegerLiteralNode& node) override;
-    void visit(const FloatLiteralNode& node) override;
-    void visit(const IdentifierNode& node) override;
-    void visit(const CastNode& node) override;
-};
\ No newline at end of file
+
+    // Run the analysis on a complete program, filling in the type of every node.
+    void analyze(AST& ast);
+
+private:
+    // Maps each variable declared with 'let' to the type of its initializer.
+    std::pmr::unordered_map<std::string_view, DataType> m_variables;
+    std::ostream& m_diagnostics;
+
+    // The functions defined so far. A function's parameter types are a run
+    // of m_parameter_types.
+    struct FunctionSignature {
+        DataType return_type;
+        uint32_t first_parameter;
+        uint32_t parameter_count;
+    };
+    std::pmr::unordered_map<std::string_view, FunctionSignature> m_functions;
+    std::pmr::vector<DataType> m_parameter_types;
+
+    // Names called as external functions. Defining one of them later would
+    // give the earlier calls a different meaning from the later ones.
+    std::pmr::unordered_set<std::string_view> m_external_callees;
+
+    // The top level's variables, set aside while a function body is checked:
+    // a body sees only its own parameters and variables.
+    std::pmr::unordered_map<std::string_view, DataType> m_outer_variables;
+
+    // Identifiers in the current statement that name a function of the
+    // program, not yet claimed by a call as its callee. The AST is
+    // post-order, so a callee is checked before its call, and is the last
+    // one here by the time the call is checked. Any left at the end of the
+    // statement are functions used as values.
+    std::pmr::vector<NodeIndex> m_function_names;
+
+    // One handler per node kind. Each one may assume that the node's operands
+    // have already been checked.
+    void checkLet(AST& ast, NodeIndex node);
+    void checkIdentifier(AST& ast, NodeIndex node);
+    void checkUnaryOp(AST& ast, NodeIndex node);
+    void checkBinaryOp(AST& ast, NodeIndex node);
+    void checkCast(AST& ast, NodeIndex node);
+    void checkFunctionCall(AST& ast, NodeIndex node);
+    void checkFunction(AST& ast, NodeIndex node);
+    void checkReturn(AST& ast, NodeIndex node);
+    void checkStatementEnd(AST& ast);
+};
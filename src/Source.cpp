@@ -0,0 +1,103 @@
+#include "Source.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+SourceLocation SourceBuffer::locate(uint32_t offset) const {
+    size_t end = std::min<size_t>(offset, m_text.size());
+    uint32_t line = 1;
+    size_t line_start = 0;
+    for (size_t i = 0; i < end; ++i) {
+        if (m_text[i] == '\n') {
+            line++;
+            line_start = i + 1;
+        }
+    }
+    return {line, (uint32_t)(end - line_start + 1)};
+}
+
+// Token offsets are 32-bit, which bounds the size of a single source file.
+static void check_size(const std::string& path, size_t size) {
+    if (size > UINT32_MAX) {
+        throw std::runtime_error("Input file '" + path + "' is larger than 4 GiB.");
+    }
+}
+
+SourceFile SourceFile::open(const std::string& path) {
+    SourceFile file;
+    file.m_path = path;
+
+    bool from_stdin = (path == "-");
+    int fd = from_stdin ? STDIN_FILENO : ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Could not open input file '" + path + "': " + std::strerror(errno));
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+        size_t size = (size_t)info.st_size;
+        if (size > UINT32_MAX && !from_stdin) ::close(fd);
+        check_size(path, size);
+        void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping != MAP_FAILED) {
+            // The lexer makes one front-to-back pass over the text.
+            madvise(mapping, size, MADV_SEQUENTIAL);
+            file.m_text = std::string_view(static_cast<const char*>(mapping), size);
+            file.m_mapped = true;
+            if (!from_stdin) ::close(fd);
+            return file;
+        }
+    }
+
+    // Fall back to reading everything into a buffer.
+    char chunk[64 * 1024];
+    while (true) {
+        ssize_t count = ::read(fd, chunk, sizeof(chunk));
+        if (count == 0) break;
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            int error = errno;
+            if (!from_stdin) ::close(fd);
+            throw std::runtime_error("Could not read input file '" + path + "': " + std::strerror(error));
+        }
+        file.m_buffer.append(chunk, (size_t)count);
+    }
+    if (!from_stdin) ::close(fd);
+    check_size(path, file.m_buffer.size());
+    file.m_text = file.m_buffer;
+    return file;
+}
+
+SourceFile::SourceFile(SourceFile&& other) noexcept {
+    *this = std::move(other);
+}
+
+SourceFile& SourceFile::operator=(SourceFile&& other) noexcept {
+    if (this != &other) {
+        release();
+        m_path = std::move(other.m_path);
+        m_mapped = other.m_mapped;
+        m_buffer = std::move(other.m_buffer);
+        m_text = m_mapped ? other.m_text : std::string_view(m_buffer);
+        other.m_text = {};
+        other.m_mapped = false;
+    }
+    return *this;
+}
+
+SourceFile::~SourceFile() {
+    release();
+}
+
+void SourceFile::release() {
+    if (m_mapped) {
+        munmap(const_cast<char*>(m_text.data()), m_text.size());
+        m_mapped = false;
+    }
+    m_text = {};
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "Token.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// A line/column pair, both starting at 1.
+struct SourceLocation {
+    uint32_t line;
+    uint32_t column;
+};
+
+// A read-only view of the program text that every token points into.
+// The buffer itself is owned by whoever loaded the source; it must outlive
+// the tokens, the AST and any diagnostics that refer back to it.
+class SourceBuffer {
+public:
+    SourceBuffer() = default;
+    explicit SourceBuffer(std::string_view text) : m_text(text) {}
+
+    std::string_view text() const { return m_text; }
+    size_t size() const { return m_text.size(); }
+
+    // The lexeme of a token, as a view into the buffer.
+    std::string_view lexeme(const Token& token) const {
+        return m_text.substr(token.offset, token.length);
+    }
+
+    // Converts a byte offset to a line and column. Tokens don't store these,
+    // so they are computed on demand by counting newlines, which only
+    // happens when a diagnostic is reported.
+    SourceLocation locate(uint32_t offset) const;
+
+private:
+    std::string_view m_text;
+};
+
+// The contents of an input file, loaded without copying where possible.
+//
+// Regular files are memory-mapped read-only and the lexer reads straight out
+// of the mapping. Anything that can't be mapped (pipes, terminals, stdin) is
+// read into a buffer instead. The text stays valid for the lifetime of the
+// SourceFile.
+class SourceFile {
+public:
+    // Opens `path`, or standard input when `path` is "-".
+    // Throws std::runtime_error if the file can't be read.
+    static SourceFile open(const std::string& path);
+
+    SourceFile(SourceFile&& other) noexcept;
+    SourceFile& operator=(SourceFile&& other) noexcept;
+    SourceFile(const SourceFile&) = delete;
+    SourceFile& operator=(const SourceFile&) = delete;
+    ~SourceFile();
+
+    const std::string& path() const { return m_path; }
+    std::string_view text() const { return m_text; }
+    bool is_mapped() const { return m_mapped; }
+
+private:
+    SourceFile() = default;
+    void release();
+
+    std::string m_path;
+    std::string_view m_text;
+    bool m_mapped = false;  // m_text points into an mmap'd region
+    std::string m_buffer;   // Holds the text when it couldn't be mapped
+};
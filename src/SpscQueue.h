@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <thread>
+#include <utility>
+
+// A bounded, lock-free queue between exactly one producer thread and one
+// consumer thread.
+//
+// The items sit in a ring of `Capacity` slots. The producer only ever writes
+// the tail index and the consumer only the head index, so neither side takes
+// a lock: publishing an item is one release store, and the acquire load on
+// the other side makes the item's contents visible along with it. The two
+// indices keep counting up and are only reduced modulo the capacity to find
+// a slot, so "full" and "empty" are told apart without a spare slot.
+//
+// push() waits while the queue is full and pop() while it is empty, which is
+// what bounds the memory in flight between two pipeline stages.
+template <typename T, size_t Capacity>
+class SpscQueue {
+    static_assert(Capacity != 0 && (Capacity & (Capacity - 1)) == 0, "The capacity must be a power of two");
+
+public:
+    SpscQueue() = default;
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    // Producer side.
+    void push(T item) {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        for (size_t attempt = 0; tail - m_head.load(std::memory_order_acquire) == Capacity; ++attempt) {
+            wait(attempt);
+        }
+        m_slots[tail & MASK] = std::move(item);
+        m_tail.store(tail + 1, std::memory_order_release);
+    }
+
+    // Consumer side.
+    T pop() {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        for (size_t attempt = 0; m_tail.load(std::memory_order_acquire) == head; ++attempt) {
+            wait(attempt);
+        }
+        T item = std::move(m_slots[head & MASK]);
+        m_head.store(head + 1, std::memory_order_release);
+        return item;
+    }
+
+private:
+    static constexpr size_t MASK = Capacity - 1;
+
+    // Gives the other side time to catch up: the CPU first, then, for a wait
+    // that is clearly not about to end (a stage blocked behind a slow one,
+    // or more stages than cores), a short sleep so it isn't burnt spinning.
+    static void wait(size_t attempt) {
+        if (attempt < 64) {
+            std::this_thread::yield();
+        } else {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+    }
+
+    // On separate cache lines, so the two threads don't contend for one.
+    alignas(64) std::atomic<size_t> m_head{0}; // Next slot to pop; written by the consumer
+    alignas(64) std::atomic<size_t> m_tail{0}; // Next slot to push; written by the producer
+    alignas(64) T m_slots[Capacity];
+};
@@ -17,7 +17,21 @@ std::ostream& operator<<(std::ostream& os, const TokenType& type) {
         case TokenType::MINUS:        os << "MINUS";        break;
         case TokenType::STAR:         os << "STAR";         break;
         case TokenType::SLASH:        os << "SLASH";        break;
+        case TokenType::BANG:         os << "BANG";         break;
+        case TokenType::BANG_EQUAL:   os << "BANG_EQUAL";   break;
+        case TokenType::EQUAL_EQUAL:  os << "EQUAL_EQUAL";  break;
+        case TokenType::LESS:         os << "LESS";         break;
+        case TokenType::LESS_EQUAL:   os << "LESS_EQUAL";   break;
+        case TokenType::GREATER:      os << "GREATER";      break;
+        case TokenType::GREATER_EQUAL:os << "GREATER_EQUAL";break;
+        case TokenType::AND_AND:      os << "AND_AND";      break;
+        case TokenType::OR_OR:        os << "OR_OR";        break;
+        case TokenType::CAST:         os << "CAST";         break;
+        case TokenType::PARAM:        os << "PARAM";        break;
+        case TokenType::CALL:         os << "CALL";         break;
         case TokenType::LET:          os << "LET";          break;
+        case TokenType::FN:           os << "FN";           break;
+        case TokenType::RETURN:       os << "RETURN";       break;
         case TokenType::IDENTIFIER:   os << "IDENTIFIER";   break;
         case TokenType::INTEGER_LITERAL: os << "INTEGER_LITERAL"; break;
         case TokenType::FLOAT_LITERAL: os << "FLOAT_LITERAL"; break;
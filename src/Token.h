@@ -1,11 +1,13 @@
 # pragma once
+#include <cstdint>
 #include <string>
+#include <string_view>
 #include <ostream>
 
 using namespace std;
 
 // Represents the type of a token
-enum class TokenType {
+enum class TokenType : uint8_t {
     // Single-character tokens
     LEFT_PAREN, RIGHT_PAREN,
     LEFT_BRACE, RIGHT_BRACE,
@@ -13,12 +15,20 @@ enum class TokenType {
     COMMA, DOT, COLON,
     SEMICOLON, EQUALS,
     PLUS, MINUS, STAR, SLASH,
+
+    // One- or two-character operators
+    BANG, BANG_EQUAL,
+    EQUAL_EQUAL,
+    LESS, LESS_EQUAL,
+    GREATER, GREATER_EQUAL,
+    AND_AND, OR_OR,
+
     CAST,
     PARAM, // Represents passing a parameter to a function
     CALL,
 
     // Keywords
-    LET,
+    LET, FN, RETURN,
 
     // Literals
     IDENTIFIER,
@@ -31,13 +41,23 @@ enum class TokenType {
     END_OF_FILE
 };
 
-// A structure to hold information about a single token
+// A structure to hold information about a single token.
+//
+// Tokens never copy text: they record where their lexeme sits in the single
+// source buffer (see SourceBuffer in Source.h), which also turns the offset
+// into a line and column when a message needs one. Integer and float literals
+// are decoded once by the lexer, so later phases never re-parse digits.
 struct Token {
+    uint32_t offset;    // Byte offset of the first character in the source buffer
+    uint16_t length;    // Number of characters in the lexeme
     TokenType type;
-    std::string lexeme; // The actual text of the token (e.g., "let", "myVar", "42")
-    int line;           // The line number where the token appears
-    int column;         // The column number where the token starts
+    uint8_t reserved;
+    union {
+        long long int_value; // Valid for INTEGER_LITERAL
+        double float_value;  // Valid for FLOAT_LITERAL
+    };
 };
+static_assert(sizeof(Token) == 16, "Tokens are meant to stay packed into 16 bytes");
 
 // A helper function to easily print a token's type (useful for debugging)
 // This lets us do `std::cout << token.type;`
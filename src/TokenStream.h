@@ -0,0 +1,66 @@
+#pragma once
+
+#include "Lexer.h"
+#include "Token.h"
+#include <cstddef>
+
+// The parser's view of the token sequence.
+//
+// A TokenStream is fed in one of two modes:
+//   * batch:     reads from a TokenList that the Lexer produced up front;
+//   * streaming: pulls tokens from the Lexer one at a time, as the parser
+//                consumes them.
+//
+// In streaming mode only a small ring buffer of tokens is ever held: the
+// previous token, the current one and MAX_LOOKAHEAD tokens beyond it. Peak
+// token memory is therefore constant no matter how large the input is.
+class TokenStream {
+public:
+    // How far past the current token the parser may look (the cast check in
+    // Parser::parsePrimary needs one token: "(" IDENTIFIER ")").
+    static constexpr size_t MAX_LOOKAHEAD = 1;
+
+    explicit TokenStream(const TokenList& tokens) : m_tokens(&tokens) {}
+
+    explicit TokenStream(Lexer& lexer) : m_lexer(&lexer) {
+        for (size_t i = 0; i <= MAX_LOOKAHEAD; ++i) {
+            m_ring[i] = lexer.next();
+        }
+    }
+
+    // The token `ahead` positions past the current one (0 = the current token).
+    const Token& peek(size_t ahead = 0) const {
+        if (m_tokens) {
+            size_t index = m_position + ahead;
+            // Looking past the end keeps returning the final END_OF_FILE token.
+            return (*m_tokens)[index < m_tokens->size() ? index : m_tokens->size() - 1];
+        }
+        return m_ring[(m_position + ahead) & RING_MASK];
+    }
+
+    // The most recently consumed token. Only valid after the first advance().
+    const Token& previous() const {
+        if (m_tokens) return (*m_tokens)[m_position - 1];
+        return m_ring[(m_position - 1) & RING_MASK];
+    }
+
+    // Moves on to the next token. In streaming mode this scans one more
+    // token into the slot freed by the oldest one.
+    void advance() {
+        m_position++;
+        if (m_lexer) {
+            m_ring[(m_position + MAX_LOOKAHEAD) & RING_MASK] = m_lexer->next();
+        }
+    }
+
+private:
+    // previous + current + lookahead, rounded up to a power of two.
+    static constexpr size_t RING_SIZE = 4;
+    static constexpr size_t RING_MASK = RING_SIZE - 1;
+    static_assert(MAX_LOOKAHEAD + 2 <= RING_SIZE, "The ring must hold previous, current and lookahead tokens");
+
+    const TokenList* m_tokens = nullptr; // Batch mode
+    Lexer* m_lexer = nullptr;            // Streaming mode
+    Token m_ring[RING_SIZE] = {};
+    size_t m_position = 0;               // Number of tokens consumed so far
+};
@@ -0,0 +1,210 @@
+#include "Optimizer.h"
+#include "Dominators.h"
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// An instruction's value, independent of where its result goes. Operands are
+// compared by their 32-bit handles, so equal constants (which the pool
+// deduplicates) and the same temporary hash alike.
+struct ExpressionKey {
+    IROp op;
+    DataType type;
+    uint32_t arg1;
+    uint32_t arg2;
+
+    bool operator==(const ExpressionKey& other) const {
+        return op == other.op && type == other.type && arg1 == other.arg1 && arg2 == other.arg2;
+    }
+};
+
+struct ExpressionKeyHash {
+    size_t operator()(const ExpressionKey& key) const {
+        uint64_t h = ((uint64_t)key.arg1 << 32 | key.arg2) * 0x9E3779B97F4A7C15ull;
+        return (size_t)(h ^ (h >> 29) ^ ((uint64_t)key.op << 8 | (uint64_t)key.type));
+    }
+};
+
+// True for instructions that compute a value from their operands alone.
+// Calls may have side effects, an ARGUMENT has no operands to tell it from
+// another, and copies are left to copy propagation.
+bool is_pure(IROp op) {
+    return op != IROp::CALL && op != IROp::PARAM && op != IROp::ARGUMENT && op != IROp::COPY;
+}
+
+// Puts equivalent expressions into one canonical form: operands of a
+// commutative operation in handle order, and `a > b` written as `b < a`.
+ExpressionKey make_key(const IRInstruction& instr) {
+    ExpressionKey key{instr.op, instr.type, instr.arg1.bits(), instr.arg2.bits()};
+    switch (instr.op) {
+        case IROp::ADD:
+        case IROp::MUL:
+        case IROp::CMP_EQ:
+        case IROp::CMP_NE:
+            if (key.arg1 > key.arg2) std::swap(key.arg1, key.arg2);
+            break;
+        case IROp::CMP_GT:
+            key.op = IROp::CMP_LT;
+            std::swap(key.arg1, key.arg2);
+            break;
+        case IROp::CMP_GE:
+            key.op = IROp::CMP_LE;
+            std::swap(key.arg1, key.arg2);
+            break;
+        case IROp::CAST:
+            key.arg2 = 0;
+            break;
+        default:
+            break;
+    }
+    return key;
+}
+
+class ValueNumbering {
+public:
+    explicit ValueNumbering(IRProgram& program)
+        : m_program(program), m_dominators(program), m_replacement(program.temp_count) {
+        for (uint32_t t = 0; t < program.temp_count; ++t) m_replacement[t] = IROperand::temp(t);
+    }
+
+    size_t run() {
+        if (m_program.blocks.empty()) return 0;
+        // At most every instruction is inserted; keep the load factor under 1/2.
+        size_t capacity = 16;
+        while (capacity < 2 * m_program.instruction_count()) capacity *= 2;
+        m_available.assign(capacity, Slot{});
+        numberDominatorTree();
+        if (m_eliminated == 0) return 0;
+        rewrite();
+        return m_eliminated;
+    }
+
+private:
+    IRProgram& m_program;
+    DominatorTree m_dominators;
+    std::vector<IROperand> m_replacement; // What each temporary turned out to equal
+    size_t m_eliminated = 0;
+
+    // The expressions available in the current block: computed in it or in
+    // one of its dominators. An open-addressing table with linear probing;
+    // leaving a block in the tree walk clears the slots it filled, newest
+    // first, which never breaks the probe sequence of an older entry.
+    struct Slot {
+        ExpressionKey key;
+        IROperand value; // NONE if the slot is empty
+    };
+    std::vector<Slot> m_available;
+    std::vector<size_t> m_filled;       // Undo log of slot indices
+    std::vector<size_t> m_scope_starts; // m_filled.size() on entering each block of the path
+
+    // Returns the value already available for `key`, or records `value` for
+    // it and returns NONE.
+    IROperand findOrInsert(const ExpressionKey& key, IROperand value) {
+        size_t mask = m_available.size() - 1;
+        for (size_t i = ExpressionKeyHash()(key) & mask;; i = (i + 1) & mask) {
+            Slot& slot = m_available[i];
+            if (slot.value.kind() == IROperand::NONE) {
+                slot = {key, value};
+                m_filled.push_back(i);
+                return {};
+            }
+            if (slot.key == key) return slot.value;
+        }
+    }
+
+    IROperand replaced(IROperand operand) const {
+        while (operand.kind() == IROperand::TEMP && m_replacement[operand.index()] != operand) {
+            operand = m_replacement[operand.index()];
+        }
+        return operand;
+    }
+
+    // A phi whose incoming values are all the same value is that value.
+    void numberPhis(IRBlock& block) {
+        for (IRPhi& phi : block.phis) {
+            IROperand first = replaced(phi.incoming.empty() ? IROperand() : phi.incoming[0]);
+            bool all_same = first.kind() != IROperand::NONE && first != phi.result;
+            for (IROperand incoming : phi.incoming) {
+                all_same = all_same && replaced(incoming) == first;
+            }
+            if (all_same) {
+                m_replacement[phi.result.index()] = first;
+                ++m_eliminated;
+            }
+        }
+    }
+
+    void numberInstructions(IRBlock& block) {
+        for (IRInstruction& instr : block.instructions) {
+            // Operands defined in a dominator were numbered already.
+            instr.arg1 = replaced(instr.arg1);
+            instr.arg2 = replaced(instr.arg2);
+            if (!is_pure(instr.op)) continue;
+
+            IROperand available = findOrInsert(make_key(instr), instr.result);
+            if (available.kind() != IROperand::NONE) {
+                m_replacement[instr.result.index()] = available;
+                ++m_eliminated;
+            }
+        }
+    }
+
+    // Preorder walk of the dominator tree with an explicit stack.
+    void numberDominatorTree() {
+        std::vector<std::pair<BlockIndex, uint32_t>> stack; // Block, next child to visit
+        auto enter = [&](BlockIndex block) {
+            m_scope_starts.push_back(m_filled.size());
+            numberPhis(m_program.blocks[block]);
+            numberInstructions(m_program.blocks[block]);
+            stack.push_back({block, 0});
+        };
+
+        enter(0);
+        while (!stack.empty()) {
+            auto [block, next] = stack.back();
+            if (next < m_dominators.children(block).size()) {
+                ++stack.back().second;
+                enter(m_dominators.children(block)[next]);
+                continue;
+            }
+            while (m_filled.size() > m_scope_starts.back()) {
+                m_available[m_filled.back()].value = {};
+                m_filled.pop_back();
+            }
+            m_scope_starts.pop_back();
+            stack.pop_back();
+        }
+    }
+
+    // Deletes the redundant definitions and points every remaining use (phi
+    // operands and terminators included) at the surviving value.
+    void rewrite() {
+        auto redundant = [&](IROperand result) {
+            return result.kind() == IROperand::TEMP && m_replacement[result.index()] != result;
+        };
+        for (IRBlock& block : m_program.blocks) {
+            block.phis.erase(std::remove_if(block.phis.begin(), block.phis.end(),
+                                            [&](const IRPhi& phi) { return redundant(phi.result); }),
+                             block.phis.end());
+            block.instructions.erase(std::remove_if(block.instructions.begin(), block.instructions.end(),
+                                                    [&](const IRInstruction& instr) { return redundant(instr.result); }),
+                                     block.instructions.end());
+            for (IRPhi& phi : block.phis) {
+                for (IROperand& incoming : phi.incoming) incoming = replaced(incoming);
+            }
+            for (IRInstruction& instr : block.instructions) {
+                instr.arg1 = replaced(instr.arg1);
+                instr.arg2 = replaced(instr.arg2);
+            }
+            block.terminator.value = replaced(block.terminator.value);
+        }
+    }
+};
+
+} // namespace
+
+void number_values(IRProgram& program, OptimizationStats& stats) {
+    stats.redundant_eliminated += ValueNumbering(program).run();
+}
@@ -0,0 +1,126 @@
+#include "WorkStealingPool.h"
+
+static size_t thread_count(size_t threads) {
+    if (threads == 0) threads = std::thread::hardware_concurrency();
+    if (threads == 0) threads = 1; // hardware_concurrency() may not know
+    return threads;
+}
+
+WorkStealingPool::WorkStealingPool(size_t threads) : m_runs(thread_count(threads)) {
+    m_workers.reserve(m_runs.size() - 1);
+    for (size_t i = 1; i < m_runs.size(); ++i) {
+        m_workers.emplace_back([this, i] { work(i); });
+    }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+    for (std::thread& worker : m_workers) {
+        worker.join();
+    }
+}
+
+void WorkStealingPool::parallel_for(size_t count, const std::function<void(size_t)>& body) {
+    if (count == 0) return;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_body = &body;
+        m_error = nullptr;
+        m_error_index = count;
+        m_pending.store(count, std::memory_order_relaxed);
+        for (size_t t = 0; t < m_runs.size(); ++t) {
+            std::lock_guard<std::mutex> run_lock(m_runs[t].mutex);
+            m_runs[t].begin = count * t / m_runs.size();
+            m_runs[t].end = count * (t + 1) / m_runs.size();
+        }
+        ++m_generation;
+    }
+    m_wake.notify_all();
+
+    runTasks(0);
+
+    // Every task has finished once none is pending, and no worker can still
+    // touch this loop's state once none is active.
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done.wait(lock, [this] { return m_pending.load(std::memory_order_acquire) == 0 && m_active == 0; });
+    m_body = nullptr;
+    if (m_error) {
+        std::exception_ptr error = std::move(m_error);
+        m_error = nullptr;
+        std::rethrow_exception(error);
+    }
+}
+
+void WorkStealingPool::work(size_t self) {
+    uint64_t seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [&] { return m_stopping || m_generation != seen; });
+            if (m_stopping) return;
+            seen = m_generation;
+            ++m_active;
+        }
+        runTasks(self);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        --m_active;
+        m_done.notify_all();
+    }
+}
+
+// Runs tasks until there are none left to take anywhere.
+void WorkStealingPool::runTasks(size_t self) {
+    size_t task;
+    while (take(self, task)) {
+        try {
+            (*m_body)(task);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (task < m_error_index) {
+                m_error_index = task;
+                m_error = std::current_exception();
+            }
+        }
+        if (m_pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_done.notify_all();
+        }
+    }
+}
+
+// The next task from the back of this thread's own run, or else the first
+// of the front half of another thread's, trying the others in turn from
+// the next one on. The rest of that half becomes this thread's run.
+bool WorkStealingPool::take(size_t self, size_t& task) {
+    Run& own = m_runs[self];
+    {
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (own.begin != own.end) {
+            task = --own.end;
+            return true;
+        }
+    }
+    for (size_t k = 1; k < m_runs.size(); ++k) {
+        Run& victim = m_runs[(self + k) % m_runs.size()];
+        size_t begin, end;
+        {
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (victim.begin == victim.end) continue;
+            begin = victim.begin;
+            end = begin + (victim.end - victim.begin + 1) / 2;
+            victim.begin = end;
+        }
+        task = begin;
+        if (end - begin > 1) {
+            std::lock_guard<std::mutex> lock(own.mutex);
+            own.begin = begin + 1;
+            own.end = end;
+        }
+        return true;
+    }
+    return false;
+}
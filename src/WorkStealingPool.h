@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A pool of threads for loops of independent tasks of uneven size, such as
+// compiling every function of a program, balanced by work stealing.
+//
+// parallel_for(count, body) runs body(0) ... body(count - 1). Each thread,
+// the caller included, starts with an equal run of consecutive indices and
+// works through it from the back. A thread whose run is used up steals the
+// front half of another thread's, so one thread stuck on a large task
+// doesn't hold up the tasks queued behind it: the others take them over.
+// Owner and thieves work at opposite ends, and neighbouring tasks mostly
+// stay on one thread.
+//
+// A run is just two indices, each pair behind a lock of its own on its own
+// cache line; taking a task holds that lock for a few instructions.
+class WorkStealingPool {
+public:
+    // `threads` counts the calling thread, so 1 runs everything on the
+    // caller without starting any; 0 means one thread per hardware core.
+    explicit WorkStealingPool(size_t threads = 0);
+    ~WorkStealingPool();
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    size_t size() const { return m_runs.size(); }
+
+    // Runs body(i) for every i in [0, count) across the pool and returns once
+    // all of them have finished. The tasks run in no particular order, so
+    // each must only touch what belongs to its index. If any of them throw,
+    // the exception of the lowest index is rethrown, after every task ran.
+    void parallel_for(size_t count, const std::function<void(size_t)>& body);
+
+private:
+    struct alignas(64) Run {
+        std::mutex mutex;
+        size_t begin = 0; // Next task a thief takes
+        size_t end = 0;   // Just past the next task the owner takes
+    };
+    std::vector<Run> m_runs; // One per thread; m_runs[0] is the caller's
+    std::vector<std::thread> m_workers;
+
+    std::mutex m_mutex;
+    std::condition_variable m_wake; // A loop started, or the pool is stopping
+    std::condition_variable m_done; // A loop may have finished
+    uint64_t m_generation = 0;      // Counts loops, so a worker notices a new one
+    size_t m_active = 0;            // Workers inside a loop
+    bool m_stopping = false;
+
+    // The current loop.
+    const std::function<void(size_t)>* m_body = nullptr;
+    std::atomic<size_t> m_pending{0}; // Tasks not finished yet
+    std::exception_ptr m_error;       // Thrown by the lowest index so far
+    size_t m_error_index = 0;
+
+    void work(size_t self);
+    void runTasks(size_t self);
+    bool take(size_t self, size_t& task);
+};
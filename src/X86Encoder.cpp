@@ -0,0 +1,519 @@
+#include "X86Encoder.h"
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+// The low three bits of a register go in ModRM or the opcode, the fourth in
+// a REX (or VEX) prefix. xmm registers are numbered the same way.
+int code(Register reg) {
+    return (int)reg & 15;
+}
+
+bool fits_int8(int64_t value) {
+    return value >= -128 && value <= 127;
+}
+
+bool fits_int32(int64_t value) {
+    return value >= INT32_MIN && value <= INT32_MAX;
+}
+
+uint8_t condition_code(Condition condition) {
+    switch (condition) {
+        case Condition::EQ: return 0x4;
+        case Condition::NE: return 0x5;
+        case Condition::LT: return 0xC;
+        case Condition::LE: return 0xE;
+        case Condition::GT: return 0xF;
+        case Condition::GE: return 0xD;
+        case Condition::A:  return 0x7;
+        case Condition::AE: return 0x3;
+        case Condition::P:  return 0xA;
+        case Condition::NP: return 0xB;
+    }
+    return 0;
+}
+
+// The two-operand integer instructions: the "r/m, reg" and "reg, r/m"
+// opcodes, and the ModRM extension of their immediate forms (0x81, 0x83).
+struct AluEncoding {
+    uint8_t store;
+    uint8_t load;
+    uint8_t extension;
+};
+
+bool alu_encoding(MachineOp op, AluEncoding& encoding) {
+    switch (op) {
+        case MachineOp::ADD: encoding = {0x01, 0x03, 0}; return true;
+        case MachineOp::OR:  encoding = {0x09, 0x0B, 1}; return true;
+        case MachineOp::AND: encoding = {0x21, 0x23, 4}; return true;
+        case MachineOp::SUB: encoding = {0x29, 0x2B, 5}; return true;
+        case MachineOp::XOR: encoding = {0x31, 0x33, 6}; return true;
+        case MachineOp::CMP: encoding = {0x39, 0x3B, 7}; return true;
+        default:             return false;
+    }
+}
+
+// The scalar double instructions, all "xmm, xmm/m64" with a mandatory prefix.
+bool sse_encoding(MachineOp op, uint8_t& prefix, uint8_t& opcode) {
+    switch (op) {
+        case MachineOp::ADDSD:   prefix = 0xF2; opcode = 0x58; return true;
+        case MachineOp::MULSD:   prefix = 0xF2; opcode = 0x59; return true;
+        case MachineOp::SUBSD:   prefix = 0xF2; opcode = 0x5C; return true;
+        case MachineOp::DIVSD:   prefix = 0xF2; opcode = 0x5E; return true;
+        case MachineOp::XORPD:   prefix = 0x66; opcode = 0x57; return true;
+        case MachineOp::UCOMISD: prefix = 0x66; opcode = 0x2E; return true;
+        default:                 return false;
+    }
+}
+
+class Encoder {
+public:
+    explicit Encoder(const MachineCode& code) : m_code(code) {}
+
+    EncodedCode run() {
+        m_body.reserve(4 * m_code.instructions.size());
+        for (const MachineInstr& instr : m_code.instructions) {
+            switch (instr.op) {
+                case MachineOp::NOP:
+                    break;
+                case MachineOp::LABEL: {
+                    auto& labels = instr.dst.kind == MachineOperand::FUNCTION ? m_function_labels : m_labels;
+                    if (labels.size() <= (size_t)instr.dst.value) labels.resize(instr.dst.value + 1);
+                    labels[instr.dst.value] = {m_body.size(), m_jumps.size()};
+                    break;
+                }
+                case MachineOp::JMP:
+                case MachineOp::JCC:
+                    m_jumps.push_back({m_body.size(), (uint32_t)instr.dst.value, instr.op == MachineOp::JCC,
+                                       condition_code(instr.condition), false, false});
+                    break;
+                case MachineOp::CALL:
+                    // A call of one of the program's functions is resolved
+                    // like a jump, but always has the rel32 form.
+                    if (instr.dst.kind == MachineOperand::FUNCTION) {
+                        m_jumps.push_back({m_body.size(), (uint32_t)instr.dst.value, false, 0, true, true});
+                    } else {
+                        encode(instr);
+                    }
+                    break;
+                default:
+                    encode(instr);
+                    break;
+            }
+        }
+        relax();
+        return assemble();
+    }
+
+private:
+    // Jumps are kept out of m_body until their size is known; everything
+    // else is encoded straight into it.
+    struct Jump {
+        size_t position; // In m_body
+        uint32_t target; // Block, or function for a call
+        bool conditional;
+        uint8_t condition;
+        bool is_long;
+        bool is_call;
+    };
+    struct Label {
+        size_t position;     // In m_body
+        size_t jumps_before; // How many jumps come before it
+    };
+
+    const MachineCode& m_code;
+    std::vector<uint8_t> m_body;
+    std::vector<CodeRelocation> m_relocations; // Offsets in m_body until assemble()
+    std::vector<Jump> m_jumps;
+    std::vector<Label> m_labels; // By block
+    std::vector<Label> m_function_labels; // By function
+    std::vector<size_t> m_jump_bytes_before; // Bytes of jumps 0..j-1, by j
+
+    static size_t jumpSize(const Jump& jump) {
+        if (jump.is_call) return 5;
+        if (!jump.is_long) return 2;
+        return jump.conditional ? 6 : 5;
+    }
+
+    // Every jump starts short; any whose target is out of rel8 range grows,
+    // which moves the code after it, so repeat until nothing changes. Jumps
+    // only ever grow, so this ends.
+    void relax() {
+        m_jump_bytes_before.resize(m_jumps.size() + 1);
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            m_jump_bytes_before[0] = 0;
+            for (size_t j = 0; j < m_jumps.size(); ++j) {
+                m_jump_bytes_before[j + 1] = m_jump_bytes_before[j] + jumpSize(m_jumps[j]);
+            }
+            for (size_t j = 0; j < m_jumps.size(); ++j) {
+                Jump& jump = m_jumps[j];
+                if (jump.is_long) continue;
+                int64_t end = (int64_t)(jump.position + m_jump_bytes_before[j] + 2);
+                if (!fits_int8(targetAddress(jump) - end)) {
+                    jump.is_long = true;
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    int64_t address(const Label& label) const {
+        return (int64_t)(label.position + m_jump_bytes_before[label.jumps_before]);
+    }
+
+    int64_t targetAddress(const Jump& jump) const {
+        if (jump.is_call) {
+            if (jump.target >= m_function_labels.size()) {
+                throw std::runtime_error("Encoder Error: call of a function without a label.");
+            }
+            return address(m_function_labels[jump.target]);
+        }
+        if (jump.target >= m_labels.size()) throw std::runtime_error("Encoder Error: jump to a block without a label.");
+        return address(m_labels[jump.target]);
+    }
+
+    EncodedCode assemble() {
+        EncodedCode result;
+        result.text.reserve(m_body.size() + m_jump_bytes_before.back());
+        size_t copied = 0;
+        for (const Jump& jump : m_jumps) {
+            result.text.insert(result.text.end(), m_body.begin() + copied, m_body.begin() + jump.position);
+            copied = jump.position;
+            size_t size = jumpSize(jump);
+            int64_t displacement = targetAddress(jump) - (int64_t)(result.text.size() + size);
+            if (jump.is_call) {
+                result.text.push_back(0xE8);
+                appendLittleEndian(result.text, (uint32_t)(int32_t)displacement, 4);
+            } else if (!jump.is_long) {
+                result.text.push_back(jump.conditional ? (uint8_t)(0x70 + jump.condition) : 0xEB);
+                result.text.push_back((uint8_t)displacement);
+            } else {
+                if (jump.conditional) {
+                    result.text.push_back(0x0F);
+                    result.text.push_back((uint8_t)(0x80 + jump.condition));
+                } else {
+                    result.text.push_back(0xE9);
+                }
+                appendLittleEndian(result.text, (uint32_t)(int32_t)displacement, 4);
+            }
+        }
+        result.text.insert(result.text.end(), m_body.begin() + copied, m_body.end());
+        for (const Label& label : m_function_labels) result.function_offsets.push_back((uint64_t)address(label));
+
+        // Move the relocations by the jump bytes before them.
+        result.relocations = std::move(m_relocations);
+        size_t j = 0;
+        for (CodeRelocation& relocation : result.relocations) {
+            while (j < m_jumps.size() && m_jumps[j].position <= relocation.offset) ++j;
+            relocation.offset += m_jump_bytes_before[j];
+        }
+        return result;
+    }
+
+    static void appendLittleEndian(std::vector<uint8_t>& out, uint64_t value, int bytes) {
+        for (int i = 0; i < bytes; ++i) out.push_back((uint8_t)(value >> (8 * i)));
+    }
+
+    // --- Instruction encoding ---
+
+    void byte(uint8_t value) { m_body.push_back(value); }
+    void imm8(int64_t value) { byte((uint8_t)value); }
+    void imm32(int64_t value) { appendLittleEndian(m_body, (uint32_t)(int32_t)value, 4); }
+    void imm64(int64_t value) { appendLittleEndian(m_body, (uint64_t)value, 8); }
+
+    // A REX prefix, if one is needed: for 64-bit operand size (w), a
+    // register numbered 8 or above, or a byte register (sil, dil, spl, bpl)
+    // that would otherwise mean ah, bh, ch or dh.
+    void rex(bool w, int reg, const MachineOperand& rm, bool byte_registers = false) {
+        uint8_t bits = (w ? 8 : 0) | ((reg & 8) ? 4 : 0);
+        if (rm.kind == MachineOperand::REGISTER) {
+            if (code(rm.reg) & 8) bits |= 1;
+        } else if (rm.kind == MachineOperand::MEMORY) {
+            if (code(rm.reg) & 8) bits |= 1;
+            if (rm.scale != 0 && (code(rm.index) & 8)) bits |= 2;
+        }
+        bool needs_empty = byte_registers && ((reg >= 4 && reg <= 7) ||
+                                              (rm.kind == MachineOperand::REGISTER && code(rm.reg) >= 4 && code(rm.reg) <= 7));
+        if (bits != 0 || needs_empty) byte(0x40 | bits);
+    }
+
+    // ModRM (and SIB and displacement) for a register field `reg` and a
+    // register or memory operand `rm`. A literal is addressed relative to
+    // rip, leaving a relocation; finish() fills in its addend.
+    void modrm(int reg, const MachineOperand& rm) {
+        reg &= 7;
+        switch (rm.kind) {
+            case MachineOperand::REGISTER:
+                byte((uint8_t)(0xC0 | (reg << 3) | (code(rm.reg) & 7)));
+                return;
+            case MachineOperand::LITERAL:
+                byte((uint8_t)(0x05 | (reg << 3)));
+                m_relocations.push_back({CodeRelocation::LITERAL, (uint32_t)rm.value, m_body.size(), 0});
+                m_pending_relocation = true;
+                imm32(0);
+                return;
+            case MachineOperand::MEMORY: {
+                int base = code(rm.reg) & 7;
+                int64_t displacement = rm.value;
+                // [rbp] and [r13] have no disp-less form, their encoding means [rip + disp32].
+                int mod = displacement == 0 && base != 5 ? 0 : fits_int8(displacement) ? 1 : 2;
+                if (rm.scale != 0 || base == 4) { // rsp and r12 need a SIB byte
+                    int scale = rm.scale == 8 ? 3 : rm.scale == 4 ? 2 : rm.scale == 2 ? 1 : 0;
+                    int index = rm.scale != 0 ? code(rm.index) & 7 : 4; // 4: no index
+                    byte((uint8_t)((mod << 6) | (reg << 3) | 4));
+                    byte((uint8_t)((scale << 6) | (index << 3) | base));
+                } else {
+                    byte((uint8_t)((mod << 6) | (reg << 3) | base));
+                }
+                if (mod == 1) imm8(displacement);
+                if (mod == 2) imm32(displacement);
+                return;
+            }
+            default:
+                throw std::runtime_error("Encoder Error: operand is not a register or memory.");
+        }
+    }
+
+    // The whole "prefix REX opcode ModRM" sequence. `opcode` holds one to
+    // three bytes, most significant first.
+    void instruction(uint8_t prefix, bool w, uint32_t opcode, int reg, const MachineOperand& rm,
+                     bool byte_registers = false) {
+        if (prefix != 0) byte(prefix);
+        rex(w, reg, rm, byte_registers);
+        if (opcode > 0xFFFF) byte((uint8_t)(opcode >> 16));
+        if (opcode > 0xFF) byte((uint8_t)(opcode >> 8));
+        byte((uint8_t)opcode);
+        modrm(reg, rm);
+    }
+
+    // Once any immediate has been appended, a rip-relative field knows how
+    // far it is from the end of its instruction.
+    void finish() {
+        if (!m_pending_relocation) return;
+        CodeRelocation& relocation = m_relocations.back();
+        relocation.addend = -(int64_t)(m_body.size() - relocation.offset);
+        m_pending_relocation = false;
+    }
+
+    bool m_pending_relocation = false;
+
+    [[noreturn]] static void unsupported(const MachineInstr& instr) {
+        throw std::runtime_error("Encoder Error: no encoding for instruction " + std::to_string((int)instr.op) + ".");
+    }
+
+    void encode(const MachineInstr& instr) {
+        const MachineOperand& dst = instr.dst;
+        const MachineOperand& src = instr.src;
+        AluEncoding alu;
+        uint8_t prefix = 0;
+        uint8_t opcode = 0;
+
+        if (alu_encoding(instr.op, alu)) {
+            if (src.kind == MachineOperand::REGISTER) {
+                // xor r, r is written (and encoded) in its 32-bit form.
+                bool zeroing = instr.op == MachineOp::XOR && dst == src;
+                instruction(0, !zeroing, alu.store, code(src.reg), dst);
+            } else if (src.kind == MachineOperand::IMMEDIATE) {
+                if (!fits_int32(src.value)) unsupported(instr);
+                if (fits_int8(src.value)) {
+                    instruction(0, true, 0x83, alu.extension, dst);
+                    finishWith8(src.value);
+                    return;
+                }
+                if (dst.is_register(Register::RAX)) { // The short accumulator form
+                    byte(0x48);
+                    byte((uint8_t)(alu.load + 2));
+                } else {
+                    instruction(0, true, 0x81, alu.extension, dst);
+                }
+                imm32(src.value);
+            } else {
+                instruction(0, true, alu.load, code(dst.reg), src);
+            }
+            finish();
+            return;
+        }
+
+        if (sse_encoding(instr.op, prefix, opcode)) {
+            instruction(prefix, false, 0x0F00 | opcode, code(dst.reg), src);
+            finish();
+            return;
+        }
+
+        switch (instr.op) {
+            case MachineOp::MOV:
+                if (dst.kind == MachineOperand::REGISTER && src.kind == MachineOperand::IMMEDIATE) {
+                    // mov r32 zero-extends, so it covers 0 to 2^32 - 1 in 5 or 6 bytes.
+                    int reg = code(dst.reg);
+                    if (src.value >= 0 && src.value <= UINT32_MAX) {
+                        if (reg & 8) byte(0x41);
+                        byte((uint8_t)(0xB8 | (reg & 7)));
+                        imm32(src.value);
+                    } else if (fits_int32(src.value)) {
+                        instruction(0, true, 0xC7, 0, dst);
+                        imm32(src.value);
+                    } else {
+                        byte((reg & 8) ? 0x49 : 0x48);
+                        byte((uint8_t)(0xB8 | (reg & 7)));
+                        imm64(src.value);
+                    }
+                } else if (src.kind == MachineOperand::IMMEDIATE) {
+                    if (!fits_int32(src.value)) unsupported(instr);
+                    instruction(0, true, 0xC7, 0, dst);
+                    imm32(src.value);
+                } else if (src.kind == MachineOperand::REGISTER) {
+                    instruction(0, true, 0x89, code(src.reg), dst);
+                } else {
+                    instruction(0, true, 0x8B, code(dst.reg), src);
+                }
+                break;
+            case MachineOp::MOVZX:
+                instruction(0, true, 0x0FB6, code(dst.reg), src, true);
+                break;
+            case MachineOp::LEA:
+                instruction(0, true, 0x8D, code(dst.reg), src);
+                break;
+            case MachineOp::TEST:
+                if (src.kind != MachineOperand::REGISTER) unsupported(instr);
+                instruction(0, true, 0x85, code(src.reg), dst);
+                break;
+            case MachineOp::IMUL:
+                if (dst.kind == MachineOperand::NONE) {
+                    instruction(0, true, 0xF7, 5, src);
+                } else if (src.kind == MachineOperand::IMMEDIATE) {
+                    if (fits_int8(src.value)) {
+                        instruction(0, true, 0x6B, code(dst.reg), dst);
+                        finishWith8(src.value);
+                        return;
+                    }
+                    instruction(0, true, 0x69, code(dst.reg), dst);
+                    imm32(src.value);
+                } else {
+                    instruction(0, true, 0x0FAF, code(dst.reg), src);
+                }
+                break;
+            case MachineOp::IDIV:
+                instruction(0, true, 0xF7, 7, src);
+                break;
+            case MachineOp::NEG:
+                instruction(0, true, 0xF7, 3, dst);
+                break;
+            case MachineOp::SHL:
+            case MachineOp::SHR:
+            case MachineOp::SAR: {
+                int extension = instr.op == MachineOp::SHL ? 4 : instr.op == MachineOp::SHR ? 5 : 7;
+                if (src.value == 1) {
+                    instruction(0, true, 0xD1, extension, dst);
+                } else {
+                    instruction(0, true, 0xC1, extension, dst);
+                    imm8(src.value);
+                }
+                break;
+            }
+            case MachineOp::CQO:
+                byte(0x48);
+                byte(0x99);
+                break;
+            case MachineOp::MOVSD:
+                if (dst.is_xmm_register()) {
+                    instruction(0xF2, false, 0x0F10, code(dst.reg), src);
+                } else {
+                    instruction(0xF2, false, 0x0F11, code(src.reg), dst);
+                }
+                break;
+            case MachineOp::MOVQ:
+                if (dst.is_xmm_register()) {
+                    instruction(0x66, true, 0x0F6E, code(dst.reg), src);
+                } else {
+                    instruction(0x66, true, 0x0F7E, code(src.reg), dst);
+                }
+                break;
+            case MachineOp::CVTSI2SD:
+                instruction(0xF2, true, 0x0F2A, code(dst.reg), src);
+                break;
+            case MachineOp::CVTTSD2SI:
+                instruction(0xF2, true, 0x0F2C, code(dst.reg), src);
+                break;
+            case MachineOp::VFMADD231SD:
+            case MachineOp::VFMSUB231SD:
+            case MachineOp::VFNMADD231SD:
+                encodeFma(instr);
+                break;
+            case MachineOp::SETCC:
+                instruction(0, false, 0x0F90 | condition_code(instr.condition), 0, dst, true);
+                break;
+            case MachineOp::PUSH:
+                if (src.kind == MachineOperand::REGISTER) {
+                    if (code(src.reg) & 8) byte(0x41);
+                    byte((uint8_t)(0x50 | (code(src.reg) & 7)));
+                } else if (src.kind == MachineOperand::IMMEDIATE) {
+                    if (fits_int8(src.value)) {
+                        byte(0x6A);
+                        imm8(src.value);
+                    } else {
+                        byte(0x68);
+                        imm32(src.value);
+                    }
+                } else {
+                    instruction(0, false, 0xFF, 6, src);
+                }
+                break;
+            case MachineOp::POP:
+                if (dst.kind == MachineOperand::REGISTER) {
+                    if (code(dst.reg) & 8) byte(0x41);
+                    byte((uint8_t)(0x58 | (code(dst.reg) & 7)));
+                } else {
+                    instruction(0, false, 0x8F, 0, dst);
+                }
+                break;
+            case MachineOp::CALL:
+                if (dst.kind == MachineOperand::SYMBOL) {
+                    byte(0xE8);
+                    m_relocations.push_back({CodeRelocation::CALL, (uint32_t)dst.value, m_body.size(), -4});
+                    imm32(0);
+                } else {
+                    instruction(0, false, 0xFF, 2, dst);
+                }
+                break;
+            case MachineOp::SYSCALL:
+                byte(0x0F);
+                byte(0x05);
+                break;
+            case MachineOp::RET:
+                byte(0xC3);
+                break;
+            default:
+                unsupported(instr);
+        }
+        finish();
+    }
+
+    void finishWith8(int64_t value) {
+        imm8(value);
+        finish();
+    }
+
+    // VEX.LIG.66.0F38.W1 with the first source in vvvv: a three-byte VEX
+    // prefix (0xC4), whose R, X, B and vvvv fields are stored inverted.
+    void encodeFma(const MachineInstr& instr) {
+        uint8_t opcode = instr.op == MachineOp::VFMADD231SD ? 0xB9 : instr.op == MachineOp::VFMSUB231SD ? 0xBB : 0xBD;
+        int reg = code(instr.dst.reg);
+        const MachineOperand& rm = instr.src2;
+        bool b = (rm.kind == MachineOperand::REGISTER || rm.kind == MachineOperand::MEMORY) && (code(rm.reg) & 8);
+        bool x = rm.kind == MachineOperand::MEMORY && rm.scale != 0 && (code(rm.index) & 8);
+        byte(0xC4);
+        byte((uint8_t)(((reg & 8) ? 0 : 0x80) | (x ? 0 : 0x40) | (b ? 0 : 0x20) | 0x02));
+        byte((uint8_t)(0x80 | ((~code(instr.src.reg) & 15) << 3) | 0x01));
+        byte(opcode);
+        modrm(reg, rm);
+    }
+};
+
+} // namespace
+
+EncodedCode encode_x86(const MachineCode& code) {
+    return Encoder(code).run();
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "MachineCode.h"
+#include <cstdint>
+#include <vector>
+
+// A 32-bit field in the encoded code that refers to something whose address
+// isn't known yet. Both kinds are relative to the end of the instruction,
+// so the value to store is target + addend - (address of the field).
+struct CodeRelocation {
+    enum Kind : uint8_t {
+        CALL,    // call rel32 to the external MachineCode::symbols[index]
+        LITERAL, // [rip + disp32] of the float constant MachineCode::literals[index]
+    };
+    Kind kind;
+    uint32_t index;
+    uint64_t offset; // Of the field, in EncodedCode::text
+    int64_t addend;  // Minus the distance from the field to the end of its instruction
+};
+
+struct EncodedCode {
+    std::vector<uint8_t> text;
+    std::vector<CodeRelocation> relocations;
+    std::vector<uint64_t> function_offsets; // Where each of MachineCode::functions starts in `text`
+};
+
+// Encodes the instructions as x86-64 machine code, choosing the same
+// encodings an assembler would: the shortest immediate and displacement
+// forms, and the 2-byte rel8 form of every jump whose target is in range
+// (found by growing out-of-range jumps until nothing changes). Jumps to
+// blocks and calls of the program's own functions are resolved here; the
+// relocations are all that's left.
+EncodedCode encode_x86(const MachineCode& code);
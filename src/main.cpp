@@ -1,42 +1,605 @@
+#include "Arena.h"
 #include "Lexer.h"
 #include "Parser.h"
+#include "ASTPrinter.h"
 #include "SemanticAnalyzer.h"
-#include "IRGenerator.h" // <-- INCLUDE
-#include "IR.h"          // <-- INCLUDE for the printer
+#include "IRGenerator.h"
+#include "IR.h"          // For the IR printer
+#include "SSA.h"
+#include "Optimizer.h"
+#include "RegisterAllocator.h"
 #include "CodeGenerator.h"
-// ... includes ...
+#include "Peephole.h"
+#include "Pipeline.h"
+#include "Jit.h"
+#include "Bytecode.h"
+#include "ElfWriter.h"
+#include "Source.h"
+#include "CharScan.h"
+#include "ThreadPool.h"
+#include "WorkStealingPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <unordered_set>
+#include <vector>
 
-int main() {
-    std::string source = "let result = my_func(10.5, 20.5);";
-    std::cout << "--- Source Code ---\n" << source << "\n\n";
+// Everything the command line can ask for.
+struct DriverOptions {
+    std::vector<std::string> inputs; // Source files; "-" reads standard input
+    std::string output;              // Defaults to output.s, or output.o with -c; one input only; "-" is stdout
+    size_t jobs = 0;                 // Files compiled at once with several inputs; 0 = one per core
+    bool emit_object = false;        // -c: write an ELF object instead of assembly
+    bool jit = false;                // Run the program in-process instead of writing anything
+    bool vm = false;                 // Run the program on the bytecode interpreter
+    std::vector<std::string> jit_libraries; // Shared libraries --jit and --vm resolve calls in
+    bool print_ast = false;
+    bool print_ir = false;
+    bool verify_ir = false;
+    bool optimize = true;       // Run the IR and peephole optimizations (-O0 turns them off)
+    bool print_stats = false;
+    bool print_timing = false;
+    bool stream_tokens = false; // Pull tokens on demand instead of tokenizing up front
+    bool pipeline = false;      // Run the front end's phases concurrently on batches of statements
+    size_t lex_threads = 1;     // Threads for batch tokenizing; 0 = one per core
+    size_t function_threads = 1; // Threads compiling the program's functions; 0 = one per core
+    CodeGenOptions codegen;     // -mfma, -fno-omit-frame-pointer
+};
 
-    try {
-        // 1. Lexing
-        Lexer lexer(source);
-        std::vector<Token> tokens = lexer.tokenize();
+// Measures the wall-clock time of each compiler phase for --time.
+class PhaseTimer {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Ends the current phase (if any) and starts timing `name`.
+    void start(const char* name) {
+        stop();
+        m_name = name;
+        m_start = Clock::now();
+    }
+
+    void stop() {
+        if (!m_name) return;
+        double ms = std::chrono::duration<double, std::milli>(Clock::now() - m_start).count();
+        m_phases.push_back({m_name, ms});
+        m_name = nullptr;
+    }
+
+    // Prints one line per phase; `bytes` is used to report throughput.
+    void print(std::ostream& os, size_t bytes) {
+        stop();
+        double total = 0;
+        for (const auto& phase : m_phases) {
+            os << "--- " << phase.name << ": " << phase.ms << " ms";
+            if (phase.ms > 0) os << " (" << (bytes / 1e3) / phase.ms << " MB/s)";
+            os << " ---\n";
+            total += phase.ms;
+        }
+        os << "--- total: " << total << " ms ---\n";
+    }
+
+private:
+    struct Phase {
+        const char* name;
+        double ms;
+    };
+    std::vector<Phase> m_phases;
+    const char* m_name = nullptr;
+    Clock::time_point m_start;
+};
+
+static void print_usage(std::ostream& os) {
+    os << "Usage: mcc [options] <input>...\n"
+       << "\n"
+       << "Compiles <input> (or standard input, given as '-') to x86-64 NASM assembly,\n"
+       << "or with -c straight to an ELF64 object file. Several inputs are compiled\n"
+       << "in parallel, each to its own file: foo.mc to foo.s, or foo.o with -c.\n"
+       << "\n"
+       << "Options:\n"
+       << "  -o <file>      Write the output to <file> (default: output.s, or output.o\n"
+       << "                 with -c); only with a single input. '-o -' writes the\n"
+       << "                 assembly to standard output and reports to standard error\n"
+       << "  -j <n>         Compile up to <n> inputs at once, 0 for one per core\n"
+       << "                 (default: 0)\n"
+       << "  -S             Write NASM assembly (the default)\n"
+       << "  -c             Write an ELF64 object file that `ld` links directly\n"
+       << "  --jit          Run the program in memory and exit with its result, without\n"
+       << "                 writing a file\n"
+       << "  --vm           Run the program on the bytecode interpreter and exit with its\n"
+       << "                 result; runtime.c's functions are built in\n"
+       << "  --jit-lib=<lib.so>\n"
+       << "                 Resolve the program's calls in this shared library (e.g.\n"
+       << "                 runtime.c built with -shared), then in mcc itself\n"
+       << "  --stream       Lex on demand while parsing, keeping only a few tokens\n"
+       << "                 in memory (default: tokenize the whole file first)\n"
+       << "  --pipeline     Lex, parse, type-check and generate IR concurrently, each\n"
+       << "                 on its own thread, passing along a few statements at a time\n"
+       << "  --lex-threads=<n>\n"
+       << "                 Tokenize on <n> threads, 0 for one per core (default: 1)\n"
+       << "  --function-threads=<n>\n"
+       << "                 Optimize and generate code for the program's functions on\n"
+       << "                 <n> threads, 0 for one per core (default: 1)\n"
+       << "  --print-ast    Print the type-annotated AST\n"
+       << "  -O0, -O1       Disable or enable the IR and peephole optimizations\n"
+       << "                 (default: -O1)\n"
+       << "  --print-ir     Print the generated IR (in SSA form, after optimization)\n"
+       << "  --verify-ir    Check the IR's invariants after each IR pass\n"
+       << "  -mfma          Use FMA3 instructions for float a * b + c (the program\n"
+       << "                 then needs a CPU with FMA)\n"
+       << "  -march=native  Use FMA3 if the CPU running mcc supports it\n"
+       << "  -fno-omit-frame-pointer\n"
+       << "                 Keep an rbp frame, for debuggers and profilers\n"
+       << "                 (default: -fomit-frame-pointer)\n"
+       << "  --stats        Print memory statistics for the compilation\n"
+       << "  --time         Print the time and throughput of each phase\n"
+       << "  --lexer-isa=<scalar|sse2|avx2>\n"
+       << "                 Force the lexer's character scanners (default: best available)\n"
+       << "  -h, --help     Show this message\n";
+}
+
+// Parses a thread count for -j, --lex-threads and --function-threads. Returns false (after
+// printing a message) if `text` isn't one.
+static bool parse_thread_count(const char* text, size_t& count) {
+    char* end = nullptr;
+    unsigned long threads = std::strtoul(text, &end, 10);
+    if (end == text || *end != '\0' || threads > 1024) {
+        std::cerr << "mcc: invalid thread count '" << text << "'\n";
+        return false;
+    }
+    count = threads;
+    return true;
+}
+
+// The output file for one of several inputs: the input with its extension
+// replaced, so foo.mc becomes foo.s (or foo.o), next to it.
+static std::string output_name(const std::string& input, bool emit_object) {
+    size_t dot = input.rfind('.');
+    size_t slash = input.rfind('/');
+    bool has_extension = dot != std::string::npos && dot != 0 && (slash == std::string::npos || dot > slash + 1);
+    return input.substr(0, has_extension ? dot : std::string::npos) + (emit_object ? ".o" : ".s");
+}
+
+// Returns false (after printing a message) if the command line is malformed.
+static bool parse_arguments(int argc, char** argv, DriverOptions& options) {
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        if (std::strcmp(arg, "-o") == 0) {
+            if (i + 1 >= argc) {
+                std::cerr << "mcc: '-o' requires a file name\n";
+                return false;
+            }
+            options.output = argv[++i];
+        } else if (std::strncmp(arg, "-j", 2) == 0) {
+            const char* count = arg + 2;
+            if (*count == '\0') {
+                if (i + 1 >= argc) {
+                    std::cerr << "mcc: '-j' requires a thread count\n";
+                    return false;
+                }
+                count = argv[++i];
+            }
+            if (!parse_thread_count(count, options.jobs)) return false;
+        } else if (std::strcmp(arg, "-c") == 0 || std::strcmp(arg, "-S") == 0) {
+            options.emit_object = arg[1] == 'c';
+        } else if (std::strcmp(arg, "--jit") == 0) {
+            options.jit = true;
+        } else if (std::strcmp(arg, "--vm") == 0) {
+            options.vm = true;
+        } else if (std::strncmp(arg, "--jit-lib=", 10) == 0) {
+            options.jit_libraries.push_back(arg + 10);
+        } else if (std::strcmp(arg, "--stream") == 0) {
+            options.stream_tokens = true;
+        } else if (std::strcmp(arg, "--pipeline") == 0) {
+            options.pipeline = true;
+        } else if (std::strcmp(arg, "--print-ast") == 0) {
+            options.print_ast = true;
+        } else if (std::strcmp(arg, "--print-ir") == 0) {
+            options.print_ir = true;
+        } else if (std::strcmp(arg, "-O0") == 0 || std::strcmp(arg, "-O1") == 0) {
+            options.optimize = arg[2] == '1';
+        } else if (std::strcmp(arg, "-mfma") == 0) {
+            options.codegen.use_fma = true;
+        } else if (std::strcmp(arg, "-march=native") == 0) {
+            options.codegen.use_fma = __builtin_cpu_supports("fma");
+        } else if (std::strcmp(arg, "-fomit-frame-pointer") == 0 || std::strcmp(arg, "-fno-omit-frame-pointer") == 0) {
+            options.codegen.omit_frame_pointer = arg[3] != 'n';
+        } else if (std::strcmp(arg, "--verify-ir") == 0) {
+            options.verify_ir = true;
+        } else if (std::strcmp(arg, "--stats") == 0) {
+            options.print_stats = true;
+        } else if (std::strcmp(arg, "--time") == 0) {
+            options.print_timing = true;
+        } else if (std::strncmp(arg, "--lex-threads=", 14) == 0) {
+            if (!parse_thread_count(arg + 14, options.lex_threads)) return false;
+        } else if (std::strncmp(arg, "--function-threads=", 19) == 0) {
+            if (!parse_thread_count(arg + 19, options.function_threads)) return false;
+        } else if (std::strncmp(arg, "--lexer-isa=", 12) == 0) {
+            if (!select_char_scanners(arg + 12)) {
+                std::cerr << "mcc: lexer instruction set '" << (arg + 12) << "' is not available\n";
+                return false;
+            }
+        } else if (std::strcmp(arg, "-h") == 0 || std::strcmp(arg, "--help") == 0) {
+            print_usage(std::cout);
+            std::exit(0);
+        } else if (arg[0] == '-' && arg[1] != '\0') {
+            std::cerr << "mcc: unknown option '" << arg << "'\n";
+            return false;
+        } else {
+            options.inputs.push_back(arg);
+        }
+    }
 
-        // 2. Parsing
-        Parser parser(tokens);
-        std::vector<std::unique_ptr<StatementNode>> ast = parser.parse();
+    if (options.inputs.empty()) {
+        std::cerr << "mcc: no input files\n";
+        return false;
+    }
+    if (options.stream_tokens && options.lex_threads != 1) {
+        std::cerr << "mcc: '--stream' cannot be combined with '--lex-threads'\n";
+        return false;
+    }
+    if (options.pipeline && (options.stream_tokens || options.lex_threads != 1)) {
+        std::cerr << "mcc: '--pipeline' cannot be combined with '--stream' or '--lex-threads'\n";
+        return false;
+    }
+    if (options.output == "-" && options.emit_object) {
+        std::cerr << "mcc: '-o -' only writes assembly; '-c' needs an output file\n";
+        return false;
+    }
+    if (options.jit && options.vm) {
+        std::cerr << "mcc: '--jit' cannot be combined with '--vm'\n";
+        return false;
+    }
+    if (options.inputs.size() > 1) {
+        // Each input gets an output named after it, so none may be unnamed
+        // and no two may share one.
+        if (!options.output.empty()) {
+            std::cerr << "mcc: '-o' cannot be used with several input files\n";
+            return false;
+        }
+        if (options.jit || options.vm) {
+            std::cerr << "mcc: '" << (options.jit ? "--jit" : "--vm") << "' takes a single input file\n";
+            return false;
+        }
+        std::unordered_set<std::string> outputs;
+        for (const std::string& input : options.inputs) {
+            if (input == "-") {
+                std::cerr << "mcc: standard input cannot be one of several input files\n";
+                return false;
+            }
+            if (!outputs.insert(output_name(input, options.emit_object)).second) {
+                std::cerr << "mcc: two inputs would both be compiled to '"
+                          << output_name(input, options.emit_object) << "'\n";
+                return false;
+            }
+        }
+    }
+    if (options.output.empty()) {
+        options.output = options.emit_object ? "output.o" : "output.s";
+    }
+    return true;
+}
+
+// Runs the whole pipeline on one source file, writing the program to
+// `output`. Returns false on a syntax error. With --jit or --vm the program
+// is then run, and `result` is what it returned. Reports, warnings and
+// syntax errors go to `out` and `err` rather than straight to the console,
+// so several files can be compiled at once; nothing else is shared between
+// two calls.
+static bool compile_file(const std::string& input, const std::string& output, const DriverOptions& options,
+                         int64_t& result, std::ostream& out, std::ostream& err) {
+    // The mapping (or buffer) holding the source text outlives every phase,
+    // since tokens and AST names point into it.
+    PhaseTimer timer;
+    timer.start("read");
+    SourceFile file = SourceFile::open(input);
+    SourceBuffer source(file.text());
+
+    // Every phase allocates from this one arena. Tokens, AST nodes and the
+    // top level's IR are all released together when it goes out of scope.
+    // (Each function's IR has an arena of its own, and with --pipeline tokens
+    // and AST nodes are freed batch by batch.)
+    Arena arena;
+
+    IRModule module;
+    size_t token_count = 0;
+    size_t node_count = 0;
+    PipelineStats pipeline_stats;
+    if (options.pipeline) {
+        // 1. to 4. at once, a few statements at a time, each phase on its own thread
+        timer.start("lex+parse+typecheck+irgen");
+        if (!generate_ir_pipelined(source, arena, module, pipeline_stats, options.print_ast, out, err)) {
+            return false;
+        }
+        token_count = pipeline_stats.tokens;
+        node_count = pipeline_stats.nodes;
+    } else {
+        // 1. Lexing and 2. Parsing
+        // In batch mode the whole file is tokenized before parsing starts; in
+        // streaming mode the parser pulls each token from the lexer as it goes.
+        Lexer lexer(source.text(), arena);
+        TokenList tokens(&arena);
+        if (options.lex_threads != 1) {
+            ThreadPool pool(options.lex_threads);
+            timer.start("lex");
+            tokens = tokenize_parallel(source.text(), arena, pool);
+        } else if (!options.stream_tokens) {
+            timer.start("lex");
+            tokens = lexer.tokenize();
+        }
+        timer.start(options.stream_tokens ? "lex+parse" : "parse");
+        Parser parser = options.stream_tokens ? Parser(lexer, source, arena, err)
+                                              : Parser(tokens, source, arena, err);
+        AST ast = parser.parse();
+        if (parser.hadError()) return false;
 
         // 3. Semantic Analysis
-        TypeChecker typeChecker;
+        timer.start("typecheck");
+        TypeChecker typeChecker(arena, out);
         typeChecker.analyze(ast);
-        std::cout << "--- Semantic Analysis Complete ---\n\n";
+        if (options.print_ast) {
+            ASTPrinter(out).print(ast);
+        }
+
+        // 4. Intermediate Representation Generation
+        timer.start("irgen");
+        IRGenerator irGenerator(arena);
+        module = irGenerator.generate(ast);
+        token_count = options.stream_tokens ? lexer.tokenCount() : tokens.size();
+        node_count = ast.size();
+    }
 
-        // 4. NEW: Intermediate Representation Generation
-        IRGenerator irGenerator;
-        IRProgram ir_program = irGenerator.generate(ast);
-        print_ir(ir_program); // Print the generated IR
+    // From here on the top level and each function are compiled apart: every
+    // phase up to the peephole pass is a loop over them on the pool, each
+    // task only touching its own function (and its own slot of any results),
+    // and the results are combined in program order afterwards, so nothing
+    // depends on which thread ran what.
+    std::vector<IRProgram>& functions = module.functions;
+    WorkStealingPool pool(options.function_threads);
+    auto for_each_function = [&](const std::function<void(size_t)>& body) {
+        pool.parallel_for(functions.size(), body);
+    };
 
-        CodeGenerator codeGenerator("output.s"); // Create the assembly file
-        codeGenerator.generate(ir_program);
+    if (options.verify_ir) for_each_function([&](size_t i) { verify_ir(functions[i]); });
+    size_t ir_generated_count = module.instruction_count();
 
-    std::cout << "Assembly code generated in output.s\n";
+    // 5. Optimization, still in SSA form
+    OptimizationStats optimization_stats;
+    if (options.optimize) {
+        timer.start("optimize");
+        std::vector<OptimizationStats> function_stats(functions.size());
+        for_each_function([&](size_t i) {
+            optimize_ir(functions[i], function_stats[i]);
+            if (options.verify_ir) verify_ir(functions[i]);
+        });
+        for (const OptimizationStats& stats : function_stats) optimization_stats += stats;
+    }
+    if (options.print_ir) {
+        for (const IRProgram& function : functions) print_ir(function, out);
+    }
+    size_t ir_instruction_count = module.instruction_count();
+
+    // 6. Leaving SSA form: phis become copies the backend can emit.
+    timer.start("out-of-ssa");
+    for_each_function([&](size_t i) {
+        lower_out_of_ssa(functions[i]);
+        if (options.verify_ir) verify_ir(functions[i]);
+    });
+
+    if (options.vm) {
+        // 7. Bytecode, run on the interpreter instead of the native backend
+        timer.start("bytecode");
+        NativeTable natives;
+        JitSymbols symbols;
+        for (const std::string& library : options.jit_libraries) symbols.open(library);
+        for (const IRProgram& function : functions) {
+            for (std::string_view name : function.symbols) {
+                if (natives.find(name)) continue;
+                if (void* address = symbols.find(name)) natives.add(name, address);
+            }
+        }
+        BytecodeProgram bytecode = compile_bytecode(module, natives);
+        timer.start("run");
+        result = run_bytecode(bytecode);
+        timer.stop();
+        if (options.print_timing) {
+            out << "--- lexer scanners: " << char_scanners().name << " ---\n";
+            timer.print(out, source.size());
+        }
+        return true;
+    }
+
+    // 7. Register allocation and 8. Code Generation, into one part per function
+    timer.start("regalloc");
+    std::vector<RegisterAllocation> allocations(functions.size());
+    for_each_function([&](size_t i) { allocations[i] = allocate_registers(functions[i]); });
+    timer.start("codegen");
+    CodeGenOptions codegen_options = options.codegen;
+    codegen_options.callable = options.jit;
+    std::vector<MachineCode> parts(functions.size());
+    for_each_function([&](size_t i) {
+        CodeGenerator codeGenerator(codegen_options);
+        codeGenerator.generate(functions[i], allocations[i]);
+        parts[i] = std::move(codeGenerator.code());
+    });
+    size_t machine_generated_count = 0;
+    for (const MachineCode& part : parts) machine_generated_count += part.instructions.size();
+
+    // 9. Peephole optimization of the machine instructions
+    PeepholeStats peephole_stats;
+    if (options.optimize) {
+        timer.start("peephole");
+        std::vector<PeepholeStats> function_stats(parts.size());
+        for_each_function([&](size_t i) { run_peephole(parts[i], function_stats[i]); });
+        for (const PeepholeStats& stats : function_stats) peephole_stats += stats;
+    }
+    size_t machine_instruction_count = 0;
+    for (const MachineCode& part : parts) machine_instruction_count += part.instructions.size();
+
+    // 10. The parts joined into one program, the top level first, then output
+    timer.start("link");
+    std::vector<std::string_view> names;
+    names.reserve(functions.size());
+    for (const IRProgram& function : functions) names.push_back(function.name);
+    MachineCode code = link_machine_code(parts, names);
+    if (options.jit) {
+        // Encoding into executable memory, then running in-process
+        timer.start("jit");
+        JitSymbols symbols;
+        for (const std::string& library : options.jit_libraries) symbols.open(library);
+        JitCode jit = JitCode::load(code, symbols);
+        timer.start("run");
+        result = jit.run();
+    } else {
+        timer.start("emit");
+        if (output == "-") {
+            write_nasm(std::cout, code);
+            std::cout.flush();
+        } else {
+            std::ofstream output_file(output, std::ios::binary);
+            if (!output_file.is_open()) {
+                throw std::runtime_error("Could not open output file for code generation.");
+            }
+            if (options.emit_object) {
+                write_elf_object(output_file, code);
+            } else {
+                write_nasm(output_file, code);
+            }
+        }
+    }
+    timer.stop();
+
+    if (options.print_timing) {
+        out << "--- lexer scanners: " << char_scanners().name << " ---\n";
+        timer.print(out, source.size());
+    }
+
+    if (options.print_stats) {
+        out << "--- " << input << ": " << source.size() << " bytes ("
+                  << (file.is_mapped() ? "mapped" : "read") << "), "
+                  << token_count << " tokens, " << node_count << " AST nodes, "
+                  << ir_instruction_count << " IR instructions in " << module.block_count() << " blocks, "
+                  << functions.size() - 1 << " functions ---\n";
+        if (options.pipeline) {
+            out << "--- Pipeline: " << pipeline_stats.batches << " batches, at most "
+                << pipeline_stats.peak_batch_bytes << " bytes of tokens and AST each ---\n";
+        }
+        if (options.optimize) {
+            out << "--- Optimizer: " << ir_generated_count << " -> " << ir_instruction_count << " IR instructions ("
+                      << optimization_stats.constants_folded << " folded, "
+                      << optimization_stats.redundant_eliminated << " redundant, "
+                      << optimization_stats.copies_propagated << " copies, "
+                      << optimization_stats.dead_eliminated << " dead); "
+                      << optimization_stats.branches_folded << " branches folded, "
+                      << optimization_stats.blocks_merged << " blocks merged, "
+                      << optimization_stats.blocks_removed << " blocks removed ---\n";
+            out << "--- Peephole: " << machine_generated_count << " -> " << machine_instruction_count
+                      << " machine instructions (" << peephole_stats.redundant_moves << " redundant moves, "
+                      << peephole_stats.forwarded_loads << " loads forwarded, "
+                      << peephole_stats.zero_idioms << " zero idioms, "
+                      << peephole_stats.push_pop_pairs << " push/pop pairs) ---\n";
+        }
+        uint32_t registers_mask = 0;
+        uint32_t spilled = 0;
+        uint32_t spill_slots = 0;
+        for (const RegisterAllocation& allocation : allocations) {
+            registers_mask |= allocation.registers_used;
+            spilled += allocation.spilled;
+            spill_slots += allocation.spill_slots;
+        }
+        int registers_used = 0;
+        for (uint32_t mask = registers_mask; mask != 0; mask &= mask - 1) ++registers_used;
+        out << "--- Registers: " << registers_used << " registers used, " << spilled
+                  << " temporaries spilled to " << spill_slots << " stack slots ---\n";
+        size_t bytes_used = arena.bytes_used();
+        size_t allocation_count = arena.allocation_count();
+        size_t block_count = arena.block_count();
+        size_t bytes_reserved = arena.bytes_reserved();
+        for (const std::unique_ptr<Arena>& function_arena : module.arenas) {
+            bytes_used += function_arena->bytes_used();
+            allocation_count += function_arena->allocation_count();
+            block_count += function_arena->block_count();
+            bytes_reserved += function_arena->bytes_reserved();
+        }
+        out << "--- Arena: " << bytes_used << " bytes used in " << allocation_count << " allocations, "
+                  << block_count << " blocks (" << bytes_reserved << " bytes reserved) ---\n";
+    }
+    return true;
+}
+
+// compile_file(), reporting any error it throws to `err`. Returns false if
+// the file didn't compile.
+static bool compile(const std::string& input, const std::string& output, const DriverOptions& options,
+                    int64_t& result, std::ostream& out, std::ostream& err) {
+    try {
+        return compile_file(input, output, options, result, out, err);
     } catch (const std::runtime_error& e) {
-        std::cerr << "An error occurred: " << e.what() << std::endl;
-        return 1;
+        err << "An error occurred: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+// Copies each line of `text` to `os`, after `prefix`.
+static void print_prefixed(std::ostream& os, const std::string& prefix, const std::string& text) {
+    std::istringstream lines(text);
+    for (std::string line; std::getline(lines, line);) os << prefix << line << "\n";
+}
+
+// Compiles several files at once on a pool of `options.jobs` threads. Each
+// file's reports are buffered and printed in command-line order once it is
+// done, so the console output doesn't depend on the scheduling any more than
+// the output files do. Returns false if any file didn't compile.
+static bool compile_all(const DriverOptions& options) {
+    struct Job {
+        std::ostringstream out;
+        std::ostringstream err;
+        std::future<bool> compiled;
+    };
+    size_t threads = options.jobs != 0 ? options.jobs : std::thread::hardware_concurrency();
+    ThreadPool pool(std::min(std::max<size_t>(threads, 1), options.inputs.size()));
+
+    std::vector<std::unique_ptr<Job>> jobs;
+    jobs.reserve(options.inputs.size());
+    for (const std::string& input : options.inputs) {
+        Job& job = *jobs.emplace_back(std::make_unique<Job>());
+        job.compiled = pool.submit([&input, &options, &job] {
+            int64_t result = 0;
+            return compile(input, output_name(input, options.emit_object), options, result, job.out, job.err);
+        });
+    }
+
+    bool succeeded = true;
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        Job& job = *jobs[i];
+        succeeded &= job.compiled.get();
+        std::cout << job.out.str() << std::flush;
+        print_prefixed(std::cerr, options.inputs[i] + ": ", job.err.str());
+    }
+    return succeeded;
+}
+
+int main(int argc, char** argv) {
+    DriverOptions options;
+    if (!parse_arguments(argc, argv, options)) {
+        print_usage(std::cerr);
+        return 2;
+    }
+
+    if (options.inputs.size() > 1) {
+        return compile_all(options) ? 0 : 1;
     }
+    // With '-o -' standard output carries the assembly, so the reports go to
+    // standard error instead.
+    std::ostream& reports = options.output == "-" ? std::cerr : std::cout;
+    int64_t result = 0;
+    if (!compile(options.inputs[0], options.output, options, result, reports, std::cerr)) return 1;
 
-    return 0;
-}
\ No newline at end of file
+    // Like the native program's exit code, the low 8 bits of the result.
+    return options.jit || options.vm ? (int)(result & 0xFF) : 0;
+}
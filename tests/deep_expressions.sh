@@ -0,0 +1,35 @@
+#!/bin/bash
+# Compiles and runs the deep-expression stress programs (see
+# gen_deep_expressions.py) in every front-end mode, on a 1 MB stack, and
+# checks their results. A phase that recursed once per nesting level would
+# overflow that stack long before the bottom of these expressions.
+#
+# Usage: tests/deep_expressions.sh [path/to/mcc]   (default: ./mcc)
+set -u
+MCC=${1:-./mcc}
+TESTS=$(cd "$(dirname "$0")" && pwd)
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+python3 "$TESTS/gen_deep_expressions.py" "$WORK" > "$WORK/expected" || exit 1
+
+failures=0
+while read -r program expected; do
+    for mode in "" --stream --pipeline --lex-threads=4 --vm; do
+        run=--jit
+        [ "$mode" = --vm ] && run=
+        (ulimit -s 1024; "$MCC" "$WORK/$program" $run $mode > /dev/null 2> "$WORK/stderr")
+        status=$?
+        if [ "$status" -ne "$expected" ]; then
+            echo "FAIL: $program ${mode:-(default)}: exit status $status, expected $expected"
+            grep -v '^Warning' "$WORK/stderr" | head -3
+            failures=$((failures + 1))
+        fi
+    done
+done < "$WORK/expected"
+
+if [ "$failures" -ne 0 ]; then
+    echo "deep_expressions: $failures failures"
+    exit 1
+fi
+echo "deep_expressions: all passed"
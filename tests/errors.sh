@@ -0,0 +1,32 @@
+#!/bin/bash
+# Checks that each program in tests/errors is rejected, with and without
+# --pipeline: mcc must fail and print the message tests/errors/expected.txt
+# gives for it.
+#
+# Usage: tests/errors.sh [path/to/mcc]   (default: ./mcc)
+set -u
+MCC=${1:-./mcc}
+TESTS=$(cd "$(dirname "$0")" && pwd)
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+failures=0
+while read -r name message; do
+    for mode in "" --pipeline; do
+        label="$name ${mode:-(default)}"
+        if "$MCC" "$TESTS/errors/$name.mc" -o "$WORK/out.s" $mode > /dev/null 2> "$WORK/stderr"; then
+            echo "FAIL: $label: compiled, expected: $message"
+            failures=$((failures + 1))
+        elif ! grep -qF "$message" "$WORK/stderr"; then
+            echo "FAIL: $label: expected: $message"
+            head -3 "$WORK/stderr"
+            failures=$((failures + 1))
+        fi
+    done
+done < "$TESTS/errors/expected.txt"
+
+if [ "$failures" -ne 0 ]; then
+    echo "errors: $failures failures"
+    exit 1
+fi
+echo "errors: all passed"
@@ -0,0 +1,42 @@
+#!/usr/bin/env python3
+"""Writes the deep-expression stress programs into a directory.
+
+Usage: gen_deep_expressions.py <dir>
+
+Each program is one huge expression: a million-term sum, or 100k levels of
+parentheses, calls, unary operators or casts. Prints one line per program,
+"<name>.mc <expected exit status>", the status being the result's low 8 bits.
+"""
+import os
+import sys
+
+TERMS = 1_000_000
+DEPTH = 100_000
+
+PROGRAMS = {
+    # A left-deep chain of a million additions.
+    "sum": ("let a = 1;\nlet r = a" + " + a" * (TERMS - 1) + ";\n", TERMS),
+    # The same, but folded right-deep by the parentheses.
+    "sum_nested": ("let r = " + "1 + (" * (DEPTH - 1) + "1" + ")" * (DEPTH - 1) + ";\n", DEPTH),
+    "parentheses": ("let r = " + "(" * DEPTH + "7" + ")" * DEPTH + ";\n", 7),
+    "calls": ("fn g(a: int): int { return a + 1; }\nlet r = " + "g(" * DEPTH + "0" + ")" * DEPTH + ";\n", DEPTH),
+    # An odd number of negations, and an even number of nots.
+    "negations": ("let r = " + "- " * (DEPTH + 1) + "5;\n", -5),
+    "nots": ("let r = " + "!" * DEPTH + "5;\n", 1),
+    "casts": ("let r = " + "(int)(float)" * (DEPTH // 2) + "3;\n", 3),
+}
+
+
+def main():
+    if len(sys.argv) != 2:
+        sys.exit(__doc__.strip().splitlines()[2])
+    directory = sys.argv[1]
+    os.makedirs(directory, exist_ok=True)
+    for name, (source, result) in PROGRAMS.items():
+        with open(os.path.join(directory, name + ".mc"), "w") as f:
+            f.write(source)
+        print(f"{name}.mc {result & 0xFF}")
+
+
+if __name__ == "__main__":
+    main()
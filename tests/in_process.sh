@@ -0,0 +1,48 @@
+#!/bin/bash
+# Runs each program in tests/programs in-process, with --jit and on the
+# bytecode interpreter with --vm, at -O1 and -O0, and checks its exit status
+# against tests/programs/expected.txt. runtime.c is built as a shared
+# library for --jit; --vm has my_func built in. A program expected to be
+# killed by a signal (such as SIGFPE) kills mcc itself under --jit, while
+# --vm reports a runtime error instead.
+#
+# Usage: tests/in_process.sh [path/to/mcc]   (default: ./mcc)
+set -u
+MCC=${1:-./mcc}
+TESTS=$(cd "$(dirname "$0")" && pwd)
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+cc -shared -fPIC "$TESTS/../runtime.c" -o "$WORK/runtime.so" || exit 1
+
+failures=0
+while read -r name expected; do
+    signal=
+    case $expected in
+        SIG*) signal=$expected; expected=$((128 + $(kill -l "${expected#SIG}"))) ;;
+    esac
+    for mode in --jit --vm; do
+        for flags in "" -O0; do
+            label="$name $mode ${flags:-(default)}"
+            { "$MCC" "$TESTS/programs/$name.mc" $mode --jit-lib="$WORK/runtime.so" $flags > /dev/null \
+                2> "$WORK/stderr"; } 2> /dev/null
+            status=$?
+            if [ "$mode" = --vm ] && [ -n "$signal" ]; then
+                if ! grep -q "Runtime Error" "$WORK/stderr"; then
+                    echo "FAIL: $label: no runtime error for $signal"
+                    failures=$((failures + 1))
+                fi
+            elif [ "$status" -ne "$expected" ]; then
+                echo "FAIL: $label: exit status $status, expected $expected"
+                grep -v '^Warning' "$WORK/stderr" | head -3
+                failures=$((failures + 1))
+            fi
+        done
+    done
+done < "$TESTS/programs/expected.txt"
+
+if [ "$failures" -ne 0 ]; then
+    echo "in_process: $failures failures"
+    exit 1
+fi
+echo "in_process: all passed"
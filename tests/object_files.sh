@@ -0,0 +1,114 @@
+#!/bin/bash
+# Checks the built-in x86-64 encoder and ELF writer (-c) by running their
+# output. Each program in tests/programs is compiled to an object, linked
+# with `ld` and runtime.c, and run, and its exit status must match
+# tests/programs/expected.txt, with and without optimization and with a
+# frame pointer. An expected status may also name a signal that must kill
+# the program, such as SIGFPE.
+#
+# The objects must also contain what the programs are there to exercise: a
+# PLT32 relocation for a call to my_func, a PC32 relocation into .rodata for
+# a float literal, and jumps too long for rel8 (checked with readelf and
+# objdump, when installed). When nasm is installed, each program's -S
+# output is assembled and linked too. It must run the same, and the two
+# executables' .text and .rodata must be identical byte for byte. (The
+# executables are compared rather than the objects, since an assembler may
+# leave a call to a global function for the linker where mcc resolves it.)
+#
+# Usage: tests/object_files.sh [path/to/mcc]   (default: ./mcc)
+set -u
+MCC=${1:-./mcc}
+TESTS=$(cd "$(dirname "$0")" && pwd)
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+failures=0
+fail() {
+    echo "FAIL: $*"
+    failures=$((failures + 1))
+}
+
+has() {
+    command -v "$1" > /dev/null
+}
+
+# The named section's contents, for comparing two executables.
+section() {
+    objcopy -O binary --only-section="$2" "$1" "$3" 2> /dev/null || : > "$3"
+}
+
+# The exit status expected for a status or a signal name from expected.txt:
+# a program killed by a signal exits with 128 plus its number.
+status_of() {
+    case $1 in
+        SIG*) echo $((128 + $(kill -l "${1#SIG}"))) ;;
+        *) echo "$1" ;;
+    esac
+}
+
+cc -c "$TESTS/../runtime.c" -o "$WORK/runtime.o" || exit 1
+
+while read -r name expected; do
+    expected=$(status_of "$expected")
+    source="$TESTS/programs/$name.mc"
+    for flags in "" -O0 -fno-omit-frame-pointer; do
+        label="$name ${flags:-(default)}"
+        object="$WORK/$name.o"
+        if ! "$MCC" "$source" -c -o "$object" $flags > /dev/null 2> "$WORK/stderr"; then
+            fail "$label: mcc -c failed"
+            grep -v '^Warning' "$WORK/stderr" | head -3
+            continue
+        fi
+        if ! ld "$object" "$WORK/runtime.o" -o "$WORK/$name" 2> "$WORK/stderr"; then
+            fail "$label: ld failed"
+            head -3 "$WORK/stderr"
+            continue
+        fi
+        { "$WORK/$name"; } 2> /dev/null
+        status=$?
+        [ "$status" -eq "$expected" ] || fail "$label: exit status $status, expected $expected"
+
+        if has nasm; then
+            "$MCC" "$source" -S -o "$WORK/$name.s" $flags > /dev/null 2>&1
+            if ! nasm -f elf64 "$WORK/$name.s" -o "$WORK/$name.nasm.o" 2> "$WORK/stderr" ||
+               ! ld "$WORK/$name.nasm.o" "$WORK/runtime.o" -o "$WORK/$name.nasm" 2>> "$WORK/stderr"; then
+                fail "$label: the -S output didn't assemble and link"
+                head -3 "$WORK/stderr"
+                continue
+            fi
+            { "$WORK/$name.nasm"; } 2> /dev/null
+            status=$?
+            [ "$status" -eq "$expected" ] || fail "$label: exit status $status with nasm, expected $expected"
+            for part in .text .rodata; do
+                section "$WORK/$name" "$part" "$WORK/mcc$part"
+                section "$WORK/$name.nasm" "$part" "$WORK/nasm$part"
+                cmp -s "$WORK/mcc$part" "$WORK/nasm$part" || fail "$label: $part differs from nasm's"
+            done
+        fi
+    done
+done < "$TESTS/programs/expected.txt"
+
+# What the default build of a program must contain: a relocation type (via
+# readelf), or "rel32-jump" for a jmp or jcc with a 32-bit displacement (via
+# objdump).
+expect_in_object() {
+    local name=$1 feature=$2
+    "$MCC" "$TESTS/programs/$name.mc" -c -o "$WORK/$name.o" > /dev/null 2>&1 || return
+    if [ "$feature" = rel32-jump ]; then
+        has objdump || return
+        objdump -d "$WORK/$name.o" | grep -qE $'\t(0f 8[0-9a-f]|e9)( [0-9a-f]{2}){4} +\t' ||
+            fail "$name: no jump with a 32-bit displacement"
+    else
+        has readelf || return
+        readelf -rW "$WORK/$name.o" | grep -q "$feature" || fail "$name: no $feature relocation"
+    fi
+}
+expect_in_object external_call R_X86_64_PLT32
+expect_in_object float_literals R_X86_64_PC32
+expect_in_object long_jumps rel32-jump
+
+if [ "$failures" -ne 0 ]; then
+    echo "object_files: $failures failures"
+    exit 1
+fi
+echo "object_files: all passed$(has nasm || echo ' (nasm not installed: not compared with its output)')"
@@ -0,0 +1,12 @@
+#!/bin/bash
+# Runs every test script in this directory against a built mcc.
+#
+# Usage: tests/run_tests.sh [path/to/mcc]   (default: ./mcc)
+MCC=$(realpath "${1:-./mcc}")
+TESTS=$(cd "$(dirname "$0")" && pwd)
+
+status=0
+for test in deep_expressions object_files in_process errors; do
+    "$TESTS/$test.sh" "$MCC" || status=1
+done
+exit $status